@@ -0,0 +1,86 @@
+function [data, names] = read_ulc(fileName, t0, t1)
+% Read a columnar log (.ulc) from teensy_interface ([logger] columnar=true)
+% data is a matrix with a column for each log column (time is column 1),
+% as if loaded from the text log, e.g.
+%   [imu, names] = read_ulc('log_t0_imu.ulc');
+%   imu = read_ulc('log_t0_imu.ulc', 1740927700, 1740927710); % time window
+% Only chunks within the time window are read.
+% The file format is described in teensy_interface/src/ucolumnlog.h
+if nargin < 2
+  t0 = -inf;
+end
+if nargin < 3
+  t1 = inf;
+end
+f = fopen(fileName, 'r', 'ieee-le');
+if f < 0
+  error('read_ulc: failed to open %s', fileName);
+end
+if ~strcmp(fread(f, [1 4], '*char'), 'ULC1')
+  fclose(f);
+  error('read_ulc: %s is not a columnar log', fileName);
+end
+hdr = fread(f, 3, 'uint32'); % version, columns, header length
+columns = hdr(2);
+fread(f, hdr(3), '*char'); % text header
+types = zeros(1, columns);
+names = cell(1, columns);
+for c = 1:columns
+  types(c) = fread(f, 1, 'uint8');
+  n = fread(f, 1, 'uint8');
+  names{c} = fread(f, [1 n], '*char');
+end
+dataStart = ftell(f);
+% index at end of file: offset, rows, tmin, tmax for each chunk
+chunks = zeros(0, 4);
+fseek(f, -12, 'eof');
+indexPos = fread(f, 1, 'uint64');
+if strcmp(fread(f, [1 4], '*char'), 'ULCE')
+  fseek(f, indexPos, 'bof');
+  fread(f, [1 4], '*char'); % CIDX
+  n = fread(f, 1, 'uint32');
+  for i = 1:n
+    offset = fread(f, 1, 'uint64');
+    rows = fread(f, 1, 'uint32');
+    tt = fread(f, 2, 'double');
+    chunks(i,:) = [offset rows tt'];
+  end
+else
+  % no index (not closed), find the chunks
+  p = dataStart;
+  while fseek(f, p, 'bof') == 0
+    magic = fread(f, [1 4], '*char');
+    if ~strcmp(magic, 'CHNK')
+      break;
+    end
+    rows = fread(f, 1, 'uint32');
+    nbytes = fread(f, 1, 'uint64');
+    mn = fread(f, columns, 'double');
+    mx = fread(f, columns, 'double');
+    if numel(mx) < columns
+      break;
+    end
+    chunks(end+1,:) = [p rows mn(1) mx(1)];
+    p = p + 16 + nbytes;
+  end
+end
+data = zeros(0, columns);
+for i = 1:size(chunks, 1)
+  if chunks(i,3) > t1 || chunks(i,4) < t0
+    continue;
+  end
+  rows = chunks(i,2);
+  fseek(f, chunks(i,1) + 16 + columns * 16, 'bof');
+  d = zeros(rows, columns);
+  for c = 1:columns
+    if types(c) == 0
+      d(:,c) = double(fread(f, rows, '*int64'));
+    else
+      d(:,c) = fread(f, rows, 'double');
+    end
+  end
+  use = d(:,1) >= t0 & d(:,1) <= t1;
+  data = [data; d(use,:)];
+end
+fclose(f);
+end
@@ -66,10 +66,38 @@ bool UService::setup(int argc,char **argv)
   // add reply to version request
   bool version{false};
   cli.add_flag("-v,--version", version, "Latest SVN version (for uservice.cpp)");
+  std::string robotNamespace;
+  cli.add_option("-r,--robot", robotNamespace, "Robot namespace on a shared MQTT broker, e.g. 'r17' gives robobot/r17/cmd/shutdown (default none)");
+  cli.add_flag("-f,--fleet", fleet, "Use also fleet-wide shutdown (robobot/fleet/cmd/shutdown)");
   bool api_list{false};
   cli.add_flag("-a,--api-list", api_list, "List available modules");
   cli.allow_windows_style_options();
   CLI11_PARSE(cli, argc, argv);
+  // MQTT topics for this robot
+  std::string root = "robobot/";
+  if (not robotNamespace.empty())
+  {
+    root += robotNamespace;
+    if (root.back() != '/')
+      root += "/";
+  }
+  topicShutdown = root + "cmd/shutdown";
+  topicFleetShutdown = "robobot/fleet/cmd/shutdown";
+  // MQTT client ID must be unique on a shared broker,
+  // so add namespace and host name, e.g. ip_display_r17_pi17
+  mqttClientId = "ip_display";
+  std::string ns = robotNamespace;
+  while (not ns.empty() and ns.back() == '/')
+    ns.pop_back();
+  if (not ns.empty())
+    mqttClientId += "_" + ns;
+  const int MSL = 65;
+  char hn[MSL];
+  if (gethostname(hn, MSL) == 0)
+  {
+    hn[MSL - 1] = '\0';
+    mqttClientId += "_" + std::string(hn);
+  }
   std::string fn = "log_ip_disp.txt";
   // open logfile and write legend
   logfile = fopen(fn.c_str(), "w");
@@ -133,7 +161,7 @@ bool UService::decode(const char* msg, UTime&)
 bool UService::mqttDecode(const char* topic, const char *, UTime&)
 { // decode messages from Teensy
   bool used = true;
-  if (strcmp(topic, "robobot/cmd/shutdown") == 0)
+  if (topicShutdown == topic or (fleet and topicFleetShutdown == topic))
   {
     toLog(topic);
     printf("# UService::mqttDecode: got shutdown topic: %s\n", topic);
@@ -453,5 +481,5 @@ void UService::saveRobotName(const char * newName)
 void UService::shutdownRequest()
 {
   UTime t("now");
-  mqtt.publish("robobot/cmd/shutdown","GPIO button", t, 1);
+  mqtt.publish(topicShutdown.c_str(),"GPIO button", t, 1);
 }
@@ -41,7 +41,7 @@ public:
     bool decode(const char* msg, UTime&);
     /**
      * Decode messages from MQTT
-     * especially topic 'robobot/cmd/shutdown'
+     * especially topic 'robobot/cmd/shutdown' (or robobot/<robot>/cmd/shutdown)
      * \param message is ignored,
      * \param time is ignored
      * \returns true if message is used. */
@@ -65,6 +65,13 @@ public:
 public:
     // stop all processing
     bool stop = false;
+    /// MQTT shutdown topic for this robot (robot namespace from command line)
+    std::string topicShutdown = "robobot/cmd/shutdown";
+    /// shutdown topic for all robots on the broker (used if fleet is true)
+    std::string topicFleetShutdown = "robobot/fleet/cmd/shutdown";
+    /// MQTT client ID (with robot namespace and host name)
+    std::string mqttClientId = "ip_display";
+    bool fleet = false;
     bool mission_app_running = false;
     /**
      * Check is a file exist */
@@ -101,7 +101,7 @@ def loop():
         
         elif state == 12:
             if pose.tripBtimePassed() > 5:
-                service.send("robobot/cmd/T0/servo", "1 200 200")
+                service.send(service.topicCmd + "T0/servo", "1 200 200")
                 print("Moving servo")
                 pose.tripBreset()
                 state = 14
@@ -110,7 +110,7 @@ def loop():
         elif state == 14:
             if pose.tripBtimePassed() > 5:
                 turns += 1
-                service.send("robobot/cmd/T0/servo", "1 1000 200")
+                service.send(service.topicCmd + "T0/servo", "1 1000 200")
                 print("Moving servo")
                 pose.tripBreset()
                 if turns < 3:
@@ -119,7 +119,7 @@ def loop():
                     state = 20  # Change state to image analysis
         
         elif state == 20:
-            service.send("robobot/cmd/T0/servo", "1 5000 200")
+            service.send(service.topicCmd + "T0/servo", "1 5000 200")
             imageAnalysis(images == 2)
             images += 1
             
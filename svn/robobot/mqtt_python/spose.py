@@ -81,19 +81,19 @@ class SPose:
         # wheel configuration info
         if self.infoCnt == 0 and False:
           # get configuration (once)
-          service.send("robobot/cmd/T0/confi","")
+          service.send(service.topicCmd + "T0/confi","")
           pass
         elif not configured:
           # reset pose
-          service.send("robobot/cmd/T0/enc0","")
+          service.send(service.topicCmd + "T0/enc0","")
           ## send robot configuration
           # confw rl rr g t wb Set configuration 
           #     radius (left,right (m)), gear, encTick, wheelbase (m)
-          service.send("robobot/cmd/T0/confw","0.074 0.074 19 68 0.23")
+          service.send(service.topicCmd + "T0/confw","0.074 0.074 19 68 0.23")
           # encoder reversed (motortest only)
-          # service.send("robobot/cmd/T0/encrev","1")
+          # service.send(service.topicCmd + "T0/encrev","1")
           # request new configuration from Teensy
-          service.send("robobot/cmd/T0/confi","")
+          service.send(service.topicCmd + "T0/confi","")
           # wait for new config message
           # self.infoCnt = 0
           configured = True
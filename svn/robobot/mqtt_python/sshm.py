@@ -0,0 +1,177 @@
+#/***************************************************************************
+#*   Copyright (C) 2024 by DTU
+#*   jcan@dtu.dk
+#*
+#*
+#* The MIT License (MIT)  https://mit-license.org/
+#*
+#* Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+#* and associated documentation files (the “Software”), to deal in the Software without restriction,
+#* including without limitation the rights to use, copy, modify, merge, publish, distribute,
+#* sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+#* is furnished to do so, subject to the following conditions:
+#*
+#* The above copyright notice and this permission notice shall be included in all copies
+#* or substantial portions of the Software.
+#*
+#* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+#* INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+#* PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+#* FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+#* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#* THE SOFTWARE. */
+
+
+# Reader for the robot state table in shared memory,
+# written by teensy_interface (see teensy_interface/src/ushmstate.h).
+# Reading a record takes a few microseconds,
+# where the same data over MQTT takes broker routing and a string parse.
+
+import mmap
+import struct
+import time as t
+
+USHM_NAME = "/robobot_state"
+USHM_MAGIC = 0x52425354
+USHM_VERSION = 1
+USHM_MAX_VALUES = 16
+# record IDs (same order as ushm_record_id in ushmstate.h)
+USHM_POSE = 0     # x (m), y (m), h (rad), tilt (rad)
+USHM_VEL = 1      # motor velocity left, right (m/s)
+USHM_ENC = 2      # encoder ticks left, right
+USHM_ACC = 3      # IMU acceleration x, y, z
+USHM_GYRO = 4     # IMU gyro x, y, z
+USHM_EDGE = 5     # line sensor raw (8)
+USHM_EDGEN = 6    # line sensor normalized (8)
+USHM_CURRENT = 7  # motor currents (4), system current, supply current
+USHM_DIST = 8     # IR distance 1, 2 (m)
+USHM_RECORDS = 9
+
+class SShm:
+    # table header: magic, version, records, recordSize, pid, alive, startTime
+    header = struct.Struct("<IIIIiid")
+    headerSize = 64 # records are cache line aligned
+    # record: seq, cnt, time, n, spare, values
+    record = struct.Struct(f"<IIdii{USHM_MAX_VALUES}d")
+    recordSize = 192
+    mm = None
+
+    def setup(self, name = USHM_NAME):
+      # map the table, returns False if teensy_interface has not made it
+      try:
+        with open("/dev/shm" + name, "rb") as f:
+          self.mm = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+      except OSError:
+        print(f"% SShm:: no shared memory state table '{name}'")
+        return False
+      magic, version, records, size, pid, alive, startTime = self.header.unpack_from(self.mm, 0)
+      if magic != USHM_MAGIC or version != USHM_VERSION or size != self.recordSize:
+        print(f"% SShm:: state table '{name}' has unknown version ({version})")
+        self.terminate()
+        return False
+      return True
+
+    def alive(self):
+      # true if the writer is running
+      return self.mm is not None and self.header.unpack_from(self.mm, 0)[5] == 1
+
+    def read(self, id):
+      # get a consistent copy of a record
+      # returns (update count, time (sec since 1970), [values]) or None
+      if self.mm is None:
+        return None
+      offset = self.headerSize + id * self.recordSize
+      for i in range(1000):
+        s1 = struct.unpack_from("<I", self.mm, offset)[0]
+        if s1 & 1:
+          continue # being written
+        data = self.mm[offset:offset + self.record.size]
+        s2 = struct.unpack_from("<I", self.mm, offset)[0]
+        if s1 == s2:
+          r = self.record.unpack(data)
+          n = r[3]
+          return (r[1], r[2], list(r[5:5 + n]))
+      return None
+
+    def pose(self):
+      # x, y, h, tilt and time
+      r = self.read(USHM_POSE)
+      if r is None:
+        return None
+      return r[2], r[1]
+
+    def snapshot(self, names = "all", path = "/tmp/teensy_interface.sock"):
+      # ask teensy_interface for the latest state (also works without shared memory)
+      # returns dict name: (update count, time, [values])
+      import socket
+      result = {}
+      try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+          s.settimeout(1.0)
+          s.connect(path)
+          s.sendall((names + "\n").encode())
+          reply = ""
+          while not reply.endswith("end\n"):
+            data = s.recv(4096)
+            if not data:
+              break
+            reply += data.decode()
+      except OSError as e:
+        print(f"% SShm:: snapshot query failed: {e}")
+        return result
+      for line in reply.splitlines():
+        gg = line.split(" ")
+        if len(gg) > 2 and gg[0] != "err":
+          result[gg[0]] = (int(gg[2]), float(gg[1]), [float(x) for x in gg[3:]])
+      return result
+
+    def terminate(self):
+      if self.mm is not None:
+        self.mm.close()
+        self.mm = None
+
+# create the data object
+shm = SShm()
+
+if __name__ == "__main__":
+    # benchmark: shared memory read versus the same pose over MQTT
+    # usage: python3 sshm.py [mqtt host] [robot namespace, e.g. r17]
+    import sys
+    if not shm.setup():
+      sys.exit(1)
+    n = 100000
+    t0 = t.perf_counter()
+    for i in range(n):
+      r = shm.read(USHM_POSE)
+    dt = (t.perf_counter() - t0) / n
+    age = t.time() - r[1]
+    print(f"% shm: pose {r[2]} (cnt {r[0]}), read {dt*1e6:.2f} us, data age {age*1000:.1f} ms")
+    if len(sys.argv) > 1:
+      from paho.mqtt import client as mqtt_client
+      ns = ""
+      if len(sys.argv) > 2:
+        ns = sys.argv[2].strip("/") + "/"
+      topic = "robobot/" + ns + "drive/T0/pose"
+      stat = {"cnt": 0, "parse": 0.0, "age": 0.0, "shmAge": 0.0}
+      def on_message(client, userdata, msg):
+        t1 = t.perf_counter()
+        gg = msg.payload.decode().split(" ")
+        if len(gg) > 4:
+          tm = float(gg[0])
+          p = [float(gg[2]), float(gg[3]), float(gg[4])]
+          stat["parse"] += t.perf_counter() - t1
+          now = t.time()
+          stat["age"] += now - tm
+          stat["shmAge"] += now - shm.read(USHM_POSE)[1]
+          stat["cnt"] += 1
+      client = mqtt_client.Client()
+      client.on_message = on_message
+      client.connect(sys.argv[1])
+      client.subscribe(topic)
+      client.loop_start()
+      t.sleep(5)
+      client.loop_stop()
+      c = max(1, stat["cnt"])
+      print(f"% mqtt: {stat['cnt']} pose messages on {topic}, parse {stat['parse']/c*1e6:.2f} us, " +
+            f"data age at arrival {stat['age']/c*1000:.2f} ms (shm {stat['shmAge']/c*1000:.2f} ms)")
+    shm.terminate()
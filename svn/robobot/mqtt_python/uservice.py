@@ -27,6 +27,7 @@ def signal_handler(sig, frame):
     service.terminate()
 
 import signal
+import socket
 import argparse
 import time as t
 import random
@@ -67,6 +68,15 @@ class UService:
   terminating = False
   confirmedMaster = False
   confirmedNotMaster = False
+  # trajectory progress from teensy_interface (ti/traj)
+  trajId = 0
+  trajState = "none" # start, seg, run, done or aborted
+  trajSeg = 0
+  trajDist = 0.0
+  # commands sent with the sender time ('ts:<sec>'), so teensy_interface
+  # discards them if too old, e.g. a backlog after a Wi-Fi dropout
+  # (this computer and the robot must have the same time, e.g. NTP)
+  stampedCmds = ("ti/rc", "ti/traj", "/servo", "/batch")
   parser = argparse.ArgumentParser(description='Robobot app 2024')
 
   def setup(self, mqtt_host):
@@ -88,7 +98,21 @@ class UService:
                 help='Drive 1 m and stop')
     self.parser.add_argument('-p', '--pi', action='store_true',
                 help='Turn 180 degrees (Pi) and stop')
+    self.parser.add_argument('-r', '--robot', default='',
+                help='Robot namespace on a shared MQTT broker, e.g. r17 (must match robot.ini [mqtt] robot)')
     self.args = self.parser.parse_args()
+    if len(self.args.robot) > 0:
+      # topics for this robot only, e.g. robobot/r17/drive/
+      ns = self.args.robot.strip("/") + "/"
+      self.topic = "robobot/" + ns + "drive/"
+      self.topicCmd = "robobot/" + ns + "cmd/"
+    # client IDs must be unique on a shared broker, else the broker
+    # closes the other session, so add namespace and host name
+    idTail = "_" + socket.gethostname()
+    if len(self.args.robot) > 0:
+      idTail = "_" + self.args.robot.strip("/") + idTail
+    self.client_id += idTail
+    self.clientOut_id += idTail
     
     
     # print(f"% command line arguments: white {self.args.white}, gyro={self.args.gyro}, level={self.args.level}")
@@ -105,7 +129,7 @@ class UService:
     self.wait4mqttConnection()
     # do the setup and check of data streams
     # enable interface logging (into teensy_interface/build/log_2025...)
-    service.send("robobot/cmd/ti/log", "1")
+    service.send(service.topicCmd + "ti/log", "1")
      
     gpio.setup()
     
@@ -223,6 +247,14 @@ class UService:
       elif subtopic == "T0/info":
         if not self.args.silent:
           print(f"% Teensy info {msg}", end="")
+      elif subtopic == "traj":
+        # progress: time id state segment segments distance elapsed
+        gg = msg.split(" ")
+        if len(gg) >= 6:
+          self.trajId = int(gg[1])
+          self.trajState = gg[2]
+          self.trajSeg = int(gg[3])
+          self.trajDist = float(gg[5])
       elif subtopic == "master":
         # skip timestamp to get real masters starttime
         realMasterTime = msg[msg.find(" ")+1:]
@@ -241,6 +273,22 @@ class UService:
       print("% Service:: message not used " + topic + " " + msg)
     return used
 
+  def sendTraj(self, segments, id = 0):
+    # send a trajectory to be driven by teensy_interface, e.g.
+    # service.sendTraj("v=0.2 t=1.5; v=0.2 cu=2 d=0.5", 3)
+    # each segment: v=m/s [tr=rad/s | cu=rad/m] (t=sec | d=m)
+    # (d= needs v != 0, e.g. a turn on the spot is 'v=0 tr=1 t=1.5')
+    # progress is in service.trajState ('done' when finished)
+    self.trajId = id
+    self.trajState = "sent"
+    return self.send(self.topicCmd + "ti/traj", f"id={id}; {segments}")
+
+  def sendBatch(self, cmds):
+    # send more Teensy commands to be handled together, e.g.
+    # service.sendBatch(["servo 1 200 200", "leds 16 0 0 100"])
+    # all or nothing: if one command is invalid, none is send
+    return self.send(self.topicCmd + "T0/batch", "; ".join(cmds))
+
   def send(self, topic, param):
     # print(f"% sending: '{topic}' with '{param}' len(param)={len(param)}")
     if self.confirmedNotMaster:
@@ -248,6 +296,8 @@ class UService:
       return False
     if len(param) == 0:
       param = " "
+    if topic.endswith(self.stampedCmds):
+      param = f"ts:{t.time():.3f} {param}"
     r = self.clientOut.publish(topic, param)
     flog.writeRemark(f"{topic} {param}")
     if r[0] == 0:
@@ -280,7 +330,7 @@ class UService:
       service.send(service.topicCmd + "T0/leds","16 0 0 0")
       t.sleep(0.01)
       # stop interface logging
-      service.send("robobot/cmd/ti/log", "0")
+      service.send(service.topicCmd + "ti/log", "0")
     self.terminating = True
     self.stop = True
     try:
@@ -0,0 +1,422 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+// Record and replay MQTT sessions (see umqttsession.h for the file format)
+//   mqtt_recorder record <file.mqs> [-b host] [-t filter]... [-d seconds]
+//   mqtt_recorder play <file.mqs> [-b host] [-s speed] [-t filter]... [-m from=to]...
+//   mqtt_recorder info <file.mqs>
+//   mqtt_recorder dump <file.mqs> [-t filter]... [-m from=to]...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <MQTTClient.h>
+
+#include "umqttsession.h"
+
+/// options
+std::string host = "localhost";
+int port = 1883;
+std::vector<std::string> filters;
+std::vector<std::pair<std::string, std::string>> remaps;
+float speed = 1.0;
+float fromSec = 0;
+float toSec = 0;
+float duration = 0;
+int loops = 1;
+bool retain = false;
+int qos = 0;
+/// recording
+volatile bool stop = false;
+volatile bool connected = false;
+std::mutex fileLock;
+UMqttSessionWriter writer;
+
+void help()
+{
+  printf("Usage:\n");
+  printf("  mqtt_recorder record <file.mqs> [options]   Record from broker until ctrl-C\n");
+  printf("  mqtt_recorder play <file.mqs> [options]     Publish recorded messages with the recorded timing\n");
+  printf("  mqtt_recorder info <file.mqs>               Time range and topics\n");
+  printf("  mqtt_recorder dump <file.mqs> [options]     Print messages as text (time topic payload)\n");
+  printf("Options:\n");
+  printf("  -b, --broker HOST    MQTT broker (default %s)\n", host.c_str());
+  printf("  -p, --port PORT      MQTT port (default %d)\n", port);
+  printf("  -t, --topic FILTER   Topics to record or play, e.g. 'robobot/drive/#' (more allowed,\n");
+  printf("                       default is 'robobot/#' for record and all for play)\n");
+  printf("  -q, --qos QOS        Subscribe with this QoS (record, default %d)\n", qos);
+  printf("  -d, --duration SEC   Stop recording after this time (default until ctrl-C)\n");
+  printf("  -s, --speed FACTOR   Replay speed, 2 is twice as fast, 0 is as fast as possible (default 1)\n");
+  printf("  -f, --from SEC       Start at this time after first message\n");
+  printf("  -e, --to SEC         Stop at this time after first message\n");
+  printf("  -m, --remap FROM=TO  Replace topic prefix, e.g. 'robobot/=sim/' (more allowed)\n");
+  printf("  -l, --loop N         Play N times (0 is until ctrl-C)\n");
+  printf("  -r, --retain         Keep the retained flag on replay (default off)\n");
+}
+
+void signalHandler(int /*sig*/)
+{
+  stop = true;
+}
+
+int64_t timeUsec()
+{
+  timespec t;
+  clock_gettime(CLOCK_REALTIME, &t);
+  return (int64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+/**
+ * Get topic to use on replay
+ * \returns topic after remap, empty if not in filters */
+std::string replayTopic(const std::string & topic)
+{
+  bool use = filters.empty();
+  for (auto & f : filters)
+  {
+    use = topicMatch(f.c_str(), topic.c_str());
+    if (use)
+      break;
+  }
+  if (not use)
+    return "";
+  for (auto & r : remaps)
+  {
+    if (topic.compare(0, r.first.size(), r.first) == 0)
+      return r.second + topic.substr(r.first.size());
+  }
+  return topic;
+}
+
+bool connectMqtt(MQTTClient & client, const char * name, MQTTClient_messageArrived * msgarrvd)
+{
+  if (client == nullptr)
+  {
+    std::string address = "tcp://" + host + ":" + std::to_string(port);
+    std::string clientId = std::string(name) + "_" + std::to_string(getpid());
+    int rc = MQTTClient_create(&client, address.c_str(), clientId.c_str(), MQTTCLIENT_PERSISTENCE_NONE, NULL);
+    if (rc != MQTTCLIENT_SUCCESS)
+    {
+      printf("# mqtt_recorder:: failed to create MQTT client (%d)\n", rc);
+      client = nullptr;
+      return false;
+    }
+    MQTTClient_setCallbacks(client, nullptr, [](void *, char *) { connected = false; }, msgarrvd, nullptr);
+  }
+  MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
+  conn_opts.keepAliveInterval = 20;
+  conn_opts.cleansession = 1;
+  connected = MQTTClient_connect(client, &conn_opts) == MQTTCLIENT_SUCCESS;
+  return connected;
+}
+
+int msgarrvd(void * /*context*/, char * topicName, int /*topicLen*/, MQTTClient_message * message)
+{ // receive time first
+  int64_t t = timeUsec();
+  {
+    std::lock_guard<std::mutex> lock(fileLock);
+    writer.add(t, topicName, message->payload, message->payloadlen, message->qos, message->retained != 0);
+  }
+  MQTTClient_freeMessage(&message);
+  MQTTClient_free(topicName);
+  return 1;
+}
+
+/** only for replay, incoming messages are not used */
+int msgIgnore(void * /*context*/, char * topicName, int /*topicLen*/, MQTTClient_message * message)
+{
+  MQTTClient_freeMessage(&message);
+  MQTTClient_free(topicName);
+  return 1;
+}
+
+int record(const char * fn)
+{
+  if (filters.empty())
+    filters.push_back("robobot/#");
+  if (not writer.open(fn, timeUsec()))
+  {
+    printf("# mqtt_recorder:: failed to create %s\n", fn);
+    return 1;
+  }
+  MQTTClient client = nullptr;
+  bool subscribed = false;
+  int64_t startTime = timeUsec();
+  int loop = 0;
+  while (not stop)
+  {
+    if (not connected)
+    { // (re)connect and subscribe
+      subscribed = false;
+      if (connectMqtt(client, "mqtt_recorder", msgarrvd))
+      {
+        for (auto & f : filters)
+          MQTTClient_subscribe(client, f.c_str(), qos);
+        subscribed = true;
+        printf("# mqtt_recorder:: recording from %s:%d to %s\n", host.c_str(), port, fn);
+      }
+      else if (loop % 50 == 0)
+        printf("# mqtt_recorder:: no connection to %s:%d (retrying)\n", host.c_str(), port);
+    }
+    usleep(100000);
+    loop++;
+    if (loop % 10 == 0)
+    { // save to disk every second
+      std::lock_guard<std::mutex> lock(fileLock);
+      writer.flush();
+      if (subscribed and loop % 100 == 0)
+        printf("# mqtt_recorder:: %lu messages, %lu bytes\n", (unsigned long)writer.messages, (unsigned long)writer.bytes);
+    }
+    if (duration > 0 and timeUsec() - startTime > duration * 1e6)
+      break;
+  }
+  if (client != nullptr)
+  {
+    if (connected)
+      MQTTClient_disconnect(client, 1000);
+    MQTTClient_destroy(&client);
+  }
+  std::lock_guard<std::mutex> lock(fileLock);
+  printf("# mqtt_recorder:: recorded %lu messages (%lu bytes payload) in %.1f s\n",
+         (unsigned long)writer.messages, (unsigned long)writer.bytes, (timeUsec() - startTime) * 1e-6);
+  writer.close();
+  return 0;
+}
+
+int play(const char * fn, bool toConsole)
+{
+  UMqttSessionReader rd;
+  if (not rd.open(fn))
+  {
+    printf("# mqtt_recorder:: %s is not a session file\n", fn);
+    return 1;
+  }
+  // topic to publish for each topic number
+  std::vector<std::string> topic;
+  for (auto & t : rd.topics)
+    topic.push_back(replayTopic(t));
+  int64_t t0 = rd.first + int64_t(fromSec * 1e6);
+  int64_t t1 = rd.last;
+  if (toSec > 0)
+    t1 = rd.first + int64_t(toSec * 1e6);
+  MQTTClient client = nullptr;
+  if (not toConsole and not connectMqtt(client, "mqtt_replay", msgIgnore))
+  {
+    printf("# mqtt_recorder:: no connection to %s:%d\n", host.c_str(), port);
+    if (client != nullptr)
+      MQTTClient_destroy(&client);
+    return 1;
+  }
+  UMqttSessionMsg msg;
+  uint64_t played = 0;
+  uint64_t skipped = 0;
+  uint64_t failed = 0;
+  double lateMax = 0;
+  double lateSum = 0;
+  timespec begin;
+  clock_gettime(CLOCK_MONOTONIC, &begin);
+  for (int n = 0; (loops == 0 or n < loops) and not stop; n++)
+  {
+    // time of this pass (monotonic, ns)
+    timespec base;
+    clock_gettime(CLOCK_MONOTONIC, &base);
+    int64_t baseNs = (int64_t)base.tv_sec * 1000000000 + base.tv_nsec;
+    if (not rd.seek(t0))
+      break;
+    while (not stop and rd.next(msg) and msg.usec <= t1)
+    {
+      if (msg.topic >= (int)topic.size())
+      { // topic defined after open (should not happen)
+        for (int i = topic.size(); i < (int)rd.topics.size(); i++)
+          topic.push_back(replayTopic(rd.topics[i]));
+      }
+      const std::string & tp = topic[msg.topic];
+      if (tp.empty())
+      {
+        skipped++;
+        continue;
+      }
+      if (toConsole)
+      {
+        printf("%.6f %s %s\n", msg.usec * 1e-6, tp.c_str(), msg.payload.c_str());
+        played++;
+        continue;
+      }
+      if (speed > 0)
+      { // wait until it is time (as recorded)
+        int64_t target = baseNs + int64_t((msg.usec - t0) * 1000.0 / speed);
+        timespec ts = {time_t(target / 1000000000), long(target % 1000000000)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double late = ((int64_t)now.tv_sec * 1000000000 + now.tv_nsec - target) * 1e-6;
+        lateSum += late;
+        if (late > lateMax)
+          lateMax = late;
+      }
+      if (not connected)
+      {
+        connectMqtt(client, "mqtt_replay", msgIgnore);
+        if (not connected)
+        {
+          failed++;
+          continue;
+        }
+      }
+      int rc = MQTTClient_publish(client, tp.c_str(), msg.payload.size(), msg.payload.data(),
+                                  msg.qos, retain and msg.retained, nullptr);
+      if (rc == MQTTCLIENT_SUCCESS)
+        played++;
+      else
+        failed++;
+    }
+  }
+  timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double dt = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+  if (client != nullptr)
+  {
+    if (connected)
+      MQTTClient_disconnect(client, 1000);
+    MQTTClient_destroy(&client);
+  }
+  if (not toConsole)
+  {
+    printf("# mqtt_recorder:: played %lu messages in %.3f s (%.0f msg/s), %lu filtered, %lu failed\n",
+           (unsigned long)played, dt, played / (dt + 1e-9), (unsigned long)skipped, (unsigned long)failed);
+    if (speed > 0 and played > 0)
+      printf("# mqtt_recorder:: late max %.3f ms, mean %.3f ms\n", lateMax, lateSum / played);
+  }
+  return 0;
+}
+
+int info(const char * fn)
+{
+  UMqttSessionReader rd;
+  if (not rd.open(fn))
+  {
+    printf("# %s is not a session file\n", fn);
+    return 1;
+  }
+  time_t st = rd.start / 1000000;
+  char s[32];
+  strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", localtime(&st));
+  printf("# %s: recorded %s, %lu messages, %d topics, %d index entries (index %s)\n", fn, s,
+         (unsigned long)rd.messages, (int)rd.topics.size(), (int)rd.index.size(),
+         rd.hadIndex ? "in file" : "from records");
+  printf("# time %.6f to %.6f (%.3f s)\n", rd.first * 1e-6, rd.last * 1e-6, (rd.last - rd.first) * 1e-6);
+  // messages and bytes for each topic
+  std::vector<uint64_t> cnt, bytes;
+  UMqttSessionMsg msg;
+  while (rd.next(msg))
+  {
+    if (msg.topic >= (int)cnt.size())
+    {
+      cnt.resize(msg.topic + 1);
+      bytes.resize(msg.topic + 1);
+    }
+    cnt[msg.topic]++;
+    bytes[msg.topic] += msg.payload.size();
+  }
+  double dt = (rd.last - rd.first) * 1e-6 + 1e-9;
+  for (int i = 0; i < (int)cnt.size() and i < (int)rd.topics.size(); i++)
+    printf("%8lu msgs %10lu bytes %8.1f msg/s  %s\n", (unsigned long)cnt[i], (unsigned long)bytes[i],
+           cnt[i] / dt, rd.topics[i].c_str());
+  return 0;
+}
+
+int main(int argc, char ** argv)
+{
+  static struct option opts[] = {
+    {"broker", required_argument, nullptr, 'b'},
+    {"port", required_argument, nullptr, 'p'},
+    {"topic", required_argument, nullptr, 't'},
+    {"qos", required_argument, nullptr, 'q'},
+    {"duration", required_argument, nullptr, 'd'},
+    {"speed", required_argument, nullptr, 's'},
+    {"from", required_argument, nullptr, 'f'},
+    {"to", required_argument, nullptr, 'e'},
+    {"remap", required_argument, nullptr, 'm'},
+    {"loop", required_argument, nullptr, 'l'},
+    {"retain", no_argument, nullptr, 'r'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}};
+  int c;
+  while ((c = getopt_long(argc, argv, "b:p:t:q:d:s:f:e:m:l:rh", opts, nullptr)) != -1)
+  {
+    switch (c)
+    {
+      case 'b': host = optarg; break;
+      case 'p': port = strtol(optarg, nullptr, 10); break;
+      case 't': filters.push_back(optarg); break;
+      case 'q': qos = strtol(optarg, nullptr, 10); break;
+      case 'd': duration = strtof(optarg, nullptr); break;
+      case 's': speed = strtof(optarg, nullptr); break;
+      case 'f': fromSec = strtof(optarg, nullptr); break;
+      case 'e': toSec = strtof(optarg, nullptr); break;
+      case 'l': loops = strtol(optarg, nullptr, 10); break;
+      case 'r': retain = true; break;
+      case 'm':
+      {
+        const char * p1 = strchr(optarg, '=');
+        if (p1 == nullptr)
+        {
+          printf("# mqtt_recorder:: remap must be 'from=to', not '%s'\n", optarg);
+          return 1;
+        }
+        remaps.push_back({std::string(optarg, p1 - optarg), std::string(p1 + 1)});
+        break;
+      }
+      default:
+        help();
+        return 1;
+    }
+  }
+  if (argc - optind < 2)
+  {
+    help();
+    return 1;
+  }
+  const char * cmd = argv[optind];
+  const char * fn = argv[optind + 1];
+  signal(SIGINT, signalHandler);
+  signal(SIGTERM, signalHandler);
+  if (strcmp(cmd, "record") == 0)
+    return record(fn);
+  if (strcmp(cmd, "play") == 0)
+    return play(fn, false);
+  if (strcmp(cmd, "dump") == 0)
+    return play(fn, true);
+  if (strcmp(cmd, "info") == 0)
+    return info(fn);
+  help();
+  return 1;
+}
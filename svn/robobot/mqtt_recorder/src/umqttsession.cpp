@@ -0,0 +1,348 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+
+#include "umqttsession.h"
+
+UMqttSessionWriter::~UMqttSessionWriter()
+{
+  close();
+}
+
+bool UMqttSessionWriter::open(std::string fileName, int64_t usec)
+{
+  file = fopen(fileName.c_str(), "w");
+  if (file == nullptr)
+    return false;
+  const uint32_t version = 1;
+  fwrite("MQS1", 1, 4, file);
+  fwrite(&version, 4, 1, file);
+  fwrite(&usec, 8, 1, file);
+  pos = 16;
+  topicNumber.clear();
+  topics.clear();
+  index.clear();
+  messages = 0;
+  bytes = 0;
+  return true;
+}
+
+void UMqttSessionWriter::add(int64_t usec, const char * topic, const void * payload, int len, int qos, bool retained)
+{
+  if (file == nullptr)
+    return;
+  if (index.empty() or messages - index.back().message >= 1000 or usec - index.back().usec >= 1000000)
+    index.push_back({usec, pos, messages});
+  int tn;
+  auto it = topicNumber.find(topic);
+  if (it == topicNumber.end())
+  { // new topic
+    tn = topics.size();
+    if (tn > 0xffff)
+      return; // no more topic numbers
+    topicNumber[topic] = tn;
+    topics.push_back(topic);
+    uint16_t h[2] = {(uint16_t)tn, (uint16_t)strnlen(topic, 0xffff)};
+    fputc('T', file);
+    fwrite(h, 2, 2, file);
+    fwrite(topic, 1, h[1], file);
+    pos += 5 + h[1];
+  }
+  else
+    tn = it->second;
+  uint16_t t16 = tn;
+  uint8_t flags = (qos & 0x3) | (retained ? 0x4 : 0);
+  uint32_t n = len;
+  fputc('M', file);
+  fwrite(&t16, 2, 1, file);
+  fwrite(&flags, 1, 1, file);
+  fwrite(&usec, 8, 1, file);
+  fwrite(&n, 4, 1, file);
+  fwrite(payload, 1, n, file);
+  pos += 16 + n;
+  messages++;
+  bytes += n;
+}
+
+void UMqttSessionWriter::flush()
+{
+  if (file != nullptr)
+    fflush(file);
+}
+
+void UMqttSessionWriter::close()
+{
+  if (file == nullptr)
+    return;
+  uint64_t indexPos = pos;
+  uint32_t n = topics.size();
+  fwrite("MIDX", 1, 4, file);
+  fwrite(&n, 4, 1, file);
+  for (auto & t : topics)
+  {
+    uint16_t tl = t.size();
+    fwrite(&tl, 2, 1, file);
+    fwrite(t.data(), 1, tl, file);
+  }
+  n = index.size();
+  fwrite(&n, 4, 1, file);
+  for (auto & ix : index)
+  {
+    fwrite(&ix.usec, 8, 1, file);
+    fwrite(&ix.offset, 8, 1, file);
+    fwrite(&ix.message, 8, 1, file);
+  }
+  fwrite(&messages, 8, 1, file);
+  fwrite(&indexPos, 8, 1, file);
+  fwrite("MQSE", 1, 4, file);
+  fclose(file);
+  file = nullptr;
+}
+
+///////////////////////////////////////////////////
+
+UMqttSessionReader::~UMqttSessionReader()
+{
+  close();
+}
+
+void UMqttSessionReader::close()
+{
+  if (file != nullptr)
+    fclose(file);
+  file = nullptr;
+}
+
+bool UMqttSessionReader::open(std::string fileName)
+{
+  close();
+  file = fopen(fileName.c_str(), "r");
+  if (file == nullptr)
+    return false;
+  char magic[4];
+  uint32_t version = 0;
+  bool isOK = fread(magic, 1, 4, file) == 4 and strncmp(magic, "MQS1", 4) == 0;
+  isOK = isOK and fread(&version, 4, 1, file) == 1 and version == 1;
+  isOK = isOK and fread(&start, 8, 1, file) == 1;
+  if (not isOK)
+  {
+    close();
+    return false;
+  }
+  dataStart = 16;
+  topics.clear();
+  index.clear();
+  messages = 0;
+  first = 0;
+  last = 0;
+  // index is at the end
+  hadIndex = false;
+  fseek(file, 0, SEEK_END);
+  uint64_t size = ftell(file);
+  dataEnd = size;
+  uint64_t indexPos = 0;
+  if (size >= dataStart + 12)
+  {
+    char end[4];
+    fseek(file, size - 12, SEEK_SET);
+    if (fread(&indexPos, 8, 1, file) == 1 and fread(end, 1, 4, file) == 4 and
+        strncmp(end, "MQSE", 4) == 0 and indexPos >= dataStart and indexPos < size)
+    {
+      fseek(file, indexPos, SEEK_SET);
+      uint32_t n = 0;
+      isOK = fread(magic, 1, 4, file) == 4 and strncmp(magic, "MIDX", 4) == 0;
+      isOK = isOK and fread(&n, 4, 1, file) == 1;
+      for (uint32_t i = 0; i < n and isOK; i++)
+      {
+        uint16_t tl;
+        isOK = fread(&tl, 2, 1, file) == 1;
+        std::string t(tl, '\0');
+        isOK = isOK and fread(t.data(), 1, tl, file) == tl;
+        topics.push_back(t);
+      }
+      isOK = isOK and fread(&n, 4, 1, file) == 1;
+      for (uint32_t i = 0; i < n and isOK; i++)
+      {
+        UMqttSessionIndex ix;
+        isOK = fread(&ix.usec, 8, 1, file) == 1 and fread(&ix.offset, 8, 1, file) == 1 and
+               fread(&ix.message, 8, 1, file) == 1;
+        index.push_back(ix);
+      }
+      isOK = isOK and fread(&messages, 8, 1, file) == 1;
+      hadIndex = isOK;
+      if (isOK)
+        dataEnd = indexPos;
+    }
+  }
+  if (hadIndex)
+  { // time of first and last message
+    UMqttSessionMsg msg;
+    if (not index.empty())
+      first = index.front().usec;
+    // last message is after the last index entry
+    last = first;
+    if (not index.empty())
+    {
+      fseek(file, index.back().offset, SEEK_SET);
+      while (readRecord(msg) > 0)
+        last = msg.usec;
+    }
+  }
+  else
+  { // no index, make it from the records
+    topics.clear();
+    index.clear();
+    scanRecords();
+  }
+  fseek(file, dataStart, SEEK_SET);
+  return true;
+}
+
+bool UMqttSessionReader::scanRecords()
+{
+  UMqttSessionMsg msg;
+  fseek(file, dataStart, SEEK_SET);
+  uint64_t pos = dataStart;
+  int r = readRecord(msg);
+  while (r > 0)
+  {
+    if (r == 'M')
+    {
+      if (messages == 0)
+        first = msg.usec;
+      if (index.empty() or messages - index.back().message >= 1000 or msg.usec - index.back().usec >= 1000000)
+        index.push_back({msg.usec, pos, messages});
+      last = msg.usec;
+      messages++;
+    }
+    pos = ftell(file);
+    r = readRecord(msg);
+  }
+  // a partly written record at the end is ignored
+  dataEnd = pos;
+  return messages > 0;
+}
+
+int UMqttSessionReader::readRecord(UMqttSessionMsg & msg)
+{
+  if (file == nullptr or (uint64_t)ftell(file) >= dataEnd)
+    return 0;
+  int r = fgetc(file);
+  if (r == 'T')
+  {
+    uint16_t h[2];
+    if (fread(h, 2, 2, file) != 2)
+      return 0;
+    std::string t(h[1], '\0');
+    if (fread(t.data(), 1, h[1], file) != h[1])
+      return 0;
+    if (h[0] >= topics.size())
+      topics.resize(h[0] + 1);
+    topics[h[0]] = t;
+  }
+  else if (r == 'M')
+  {
+    uint16_t t16;
+    uint8_t flags;
+    uint32_t n;
+    if (fread(&t16, 2, 1, file) != 1 or fread(&flags, 1, 1, file) != 1 or
+        fread(&msg.usec, 8, 1, file) != 1 or fread(&n, 4, 1, file) != 1)
+      return 0;
+    msg.payload.resize(n);
+    if (fread(msg.payload.data(), 1, n, file) != n)
+      return 0;
+    msg.topic = t16;
+    msg.qos = flags & 0x3;
+    msg.retained = (flags & 0x4) != 0;
+  }
+  else
+    r = 0;
+  return r;
+}
+
+bool UMqttSessionReader::seek(int64_t usec)
+{
+  if (file == nullptr)
+    return false;
+  // last index entry not after this time
+  uint64_t offset = dataStart;
+  for (auto & ix : index)
+  {
+    if (ix.usec > usec)
+      break;
+    offset = ix.offset;
+  }
+  fseek(file, offset, SEEK_SET);
+  UMqttSessionMsg msg;
+  uint64_t pos = offset;
+  int r = readRecord(msg);
+  while (r > 0)
+  {
+    if (r == 'M' and msg.usec >= usec)
+    { // back to start of this message
+      fseek(file, pos, SEEK_SET);
+      return true;
+    }
+    pos = ftell(file);
+    r = readRecord(msg);
+  }
+  return false;
+}
+
+bool UMqttSessionReader::next(UMqttSessionMsg & msg)
+{
+  int r = readRecord(msg);
+  while (r == 'T')
+    r = readRecord(msg);
+  return r == 'M';
+}
+
+///////////////////////////////////////////////////
+
+bool topicMatch(const char * filter, const char * topic)
+{
+  const char * f = filter;
+  const char * t = topic;
+  while (*f != '\0')
+  {
+    if (*f == '#')
+      return true; // the rest match
+    if (*f == '+')
+    { // one level
+      while (*t != '\0' and *t != '/')
+        t++;
+      f++;
+    }
+    else if (*f == *t)
+    {
+      f++;
+      t++;
+    }
+    else if (*f == '/' and *t == '\0' and f[1] == '#')
+      return true; // 'a/#' match 'a' too
+    else
+      return false;
+  }
+  return *t == '\0';
+}
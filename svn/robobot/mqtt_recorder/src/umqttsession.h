@@ -0,0 +1,161 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+/**
+ * Recorded MQTT session file (.mqs).
+ * Messages are stored in the order received, each with the receive time.
+ * A topic is written once (when first seen) and then referenced by number.
+ * All numbers are little endian.
+ *
+ * File header
+ *   char[4] "MQS1", uint32 version, int64 start time (usec since epoch)
+ * Records (repeated)
+ *   'T' topic:   uint16 topic number, uint16 n, char[n] topic
+ *   'M' message: uint16 topic number, uint8 flags (bit 0-1 qos, bit 2 retained),
+ *                int64 receive time (usec since epoch), uint32 n, char[n] payload
+ * Index (when closed)
+ *   char[4] "MIDX", uint32 topics, for each topic: uint16 n, char[n] topic,
+ *   uint32 entries, for each: int64 time (usec), uint64 offset, uint64 message number,
+ *   uint64 messages, uint64 index offset, char[4] "MQSE"
+ * An index entry is added every second (or 1000 messages), so replay can start
+ * anywhere without reading from the start.
+ * A file without index (e.g. recording was killed) is read record by record. */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+/** one recorded message */
+class UMqttSessionMsg
+{
+public:
+  /// receive time (usec since epoch)
+  int64_t usec = 0;
+  /// topic number in the file (see topics)
+  int topic = 0;
+  int qos = 0;
+  bool retained = false;
+  std::string payload;
+};
+
+/** index entry */
+class UMqttSessionIndex
+{
+public:
+  int64_t usec;
+  uint64_t offset;
+  uint64_t message;
+};
+
+/**
+ * Write a session file */
+class UMqttSessionWriter
+{
+public:
+  ~UMqttSessionWriter();
+  /**
+   * Create the file
+   * \param fileName is the file to create (e.g. session.mqs)
+   * \param usec is start time (usec since epoch)
+   * \returns true if created */
+  bool open(std::string fileName, int64_t usec);
+  /**
+   * Add a message
+   * \param usec is receive time (usec since epoch)
+   * \param topic is the MQTT topic
+   * \param payload is the message payload
+   * \param len is the payload length
+   * \param qos and retained as received */
+  void add(int64_t usec, const char * topic, const void * payload, int len, int qos, bool retained);
+  /** write index and close */
+  void close();
+  /** flush buffered records to disk */
+  void flush();
+  bool isOpen()
+  {
+    return file != nullptr;
+  }
+  uint64_t messages = 0;
+  uint64_t bytes = 0;
+
+private:
+  FILE * file = nullptr;
+  uint64_t pos = 0;
+  std::map<std::string, int> topicNumber;
+  std::vector<std::string> topics;
+  std::vector<UMqttSessionIndex> index;
+};
+
+/**
+ * Read a session file */
+class UMqttSessionReader
+{
+public:
+  ~UMqttSessionReader();
+  /**
+   * Open and read header and index
+   * \returns true if the file is a session file */
+  bool open(std::string fileName);
+  void close();
+  /**
+   * Move to the first message received at or after this time
+   * \param usec is time (usec since epoch)
+   * \returns false if no such message */
+  bool seek(int64_t usec);
+  /**
+   * Get next message
+   * \param msg is set to the message
+   * \returns false at end of file */
+  bool next(UMqttSessionMsg & msg);
+  /// start time of recording (usec since epoch)
+  int64_t start = 0;
+  /// time of first and last message (usec since epoch)
+  int64_t first = 0;
+  int64_t last = 0;
+  uint64_t messages = 0;
+  /// topics in the file, the topic number is the index
+  std::vector<std::string> topics;
+  std::vector<UMqttSessionIndex> index;
+  /// the file had an index (else it was made by reading all records)
+  bool hadIndex = false;
+
+private:
+  /** read one record, topic records are added to topics
+   * \returns 'M' for a message, 'T' for a topic, 0 at end or error */
+  int readRecord(UMqttSessionMsg & msg);
+  bool scanRecords();
+  FILE * file = nullptr;
+  uint64_t dataStart = 0;
+  uint64_t dataEnd = 0;
+};
+
+/**
+ * Test MQTT topic against a subscription filter
+ * with wildcards '+' (one level) and '#' (rest)
+ * \returns true if topic match the filter */
+bool topicMatch(const char * filter, const char * topic);
@@ -54,7 +54,7 @@ void UMqtt::setup()
     bool isOK = false;
     rc = MQTTClient_create(&client,
                             "tcp://localhost:1883",
-                            "off_by_mqtt",
+                            service.mqttClientId.c_str(),
                             MQTTCLIENT_PERSISTENCE_NONE,
                             NULL);
     isOK = rc == MQTTCLIENT_SUCCESS;
@@ -97,7 +97,10 @@ void UMqtt::setup()
     {
       printf("# UMqtt:: connection to MQTT broker on broker (127.0.0.1) established\n");
       // subscribe
-      subscribe("robobot/cmd/shutdown", 1);
+      subscribe(service.topicShutdown.c_str(), 1);
+      if (service.fleet)
+        // shutdown of all robots is opt-in
+        subscribe(service.topicFleetShutdown.c_str(), 1);
       // subscribe("robobot/drive/T0/#", 0);
     }
     //end MQTT
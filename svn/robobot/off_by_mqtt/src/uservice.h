@@ -37,7 +37,7 @@ public:
     bool setup(int argc,char **argv);
     /**
      * Decode messages from MQTT
-     * especially topic 'robobot/cmd/shutdown'
+     * especially topic 'robobot/cmd/shutdown' (or robobot/<robot>/cmd/shutdown)
      * \param message is ignored,
      * \param time is ignored
      * \returns true if message is used. */
@@ -61,6 +61,13 @@ public:
 public:
     // stop all processing
     bool stop = false;
+    /// MQTT shutdown topic for this robot (robot namespace from command line)
+    std::string topicShutdown = "robobot/cmd/shutdown";
+    /// shutdown topic for all robots on the broker (used if fleet is true)
+    std::string topicFleetShutdown = "robobot/fleet/cmd/shutdown";
+    /// MQTT client ID (with robot namespace and host name)
+    std::string mqttClientId = "off_by_mqtt";
+    bool fleet = false;
     /**
      * Check is a file exist */
     inline bool file_exists(const std::string& name) {
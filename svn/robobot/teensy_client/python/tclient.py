@@ -0,0 +1,129 @@
+#/***************************************************************************
+#*   Copyright (C) 2024 by DTU
+#*   jcan@dtu.dk
+#*
+#*
+#* The MIT License (MIT)  https://mit-license.org/
+#*
+#* Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+#* and associated documentation files (the “Software”), to deal in the Software without restriction,
+#* including without limitation the rights to use, copy, modify, merge, publish, distribute,
+#* sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+#* is furnished to do so, subject to the following conditions:
+#*
+#* The above copyright notice and this permission notice shall be included in all copies
+#* or substantial portions of the Software.
+#*
+#* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+#* INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+#* PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+#* FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+#* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#* THE SOFTWARE. */
+
+
+# Python binding (ctypes) to the teensy_interface client library
+# (libteensy_client.so, build in teensy_client/build).
+#
+# Example:
+#   from tclient import TClient, POSE
+#   tc = TClient("localhost")
+#   tc.on_update(POSE, lambda id, t, v: print(f"x={v[0]:.3f}"))
+#   print(tc.pose())
+#   tc.rc(0.2, 0)
+#   tc.close()
+
+import ctypes
+import os
+
+# record IDs (see teensy_interface/src/ushmstate.h)
+POSE = 0     # x, y, h, tilt
+VEL = 1      # left, right (m/s)
+ENC = 2      # left, right (ticks)
+ACC = 3      # x, y, z
+GYRO = 4     # x, y, z
+EDGE = 5     # raw line sensor (8)
+EDGEN = 6    # normalized line sensor (8)
+CURRENT = 7  # motor currents (4), system, supply
+DIST = 8     # IR distance 1, 2
+MAX_VALUES = 16
+
+CALLBACK = ctypes.CFUNCTYPE(None, ctypes.c_int, ctypes.c_double, ctypes.c_int,
+                            ctypes.POINTER(ctypes.c_double), ctypes.c_void_p)
+
+def loadLibrary(path = None):
+    if path is None:
+      here = os.path.dirname(os.path.abspath(__file__))
+      path = os.path.join(here, "..", "build", "libteensy_client.so")
+      if not os.path.exists(path):
+        path = "libteensy_client.so" # from library path
+    lib = ctypes.CDLL(path)
+    lib.tclient_create.restype = ctypes.c_void_p
+    lib.tclient_create.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_int]
+    lib.tclient_destroy.argtypes = [ctypes.c_void_p]
+    lib.tclient_get.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_double),
+                                ctypes.POINTER(ctypes.c_double), ctypes.c_int]
+    lib.tclient_on_update.argtypes = [ctypes.c_void_p, ctypes.c_int, CALLBACK, ctypes.c_void_p]
+    lib.tclient_is_local.argtypes = [ctypes.c_void_p]
+    lib.tclient_is_connected.argtypes = [ctypes.c_void_p]
+    lib.tclient_rc.argtypes = [ctypes.c_void_p, ctypes.c_float, ctypes.c_float, ctypes.c_int]
+    lib.tclient_traj.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    lib.tclient_send.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+    lib.tclient_command.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int]
+    return lib
+
+class TClient:
+    lib = None
+    tc = None
+
+    def __init__(self, host = "localhost", robot = "", port = 1883, useShm = True, libPath = None):
+      if TClient.lib is None:
+        TClient.lib = loadLibrary(libPath)
+      # callbacks must be kept, else they are garbage collected
+      self.callbacks = []
+      self.tc = self.lib.tclient_create(host.encode(), robot.encode(), port, 1 if useShm else 0)
+
+    def get(self, id):
+      # newest values of a record as (time, [values]) or None
+      t = ctypes.c_double(0)
+      v = (ctypes.c_double * MAX_VALUES)()
+      n = self.lib.tclient_get(self.tc, id, ctypes.byref(t), v, MAX_VALUES)
+      if n <= 0:
+        return None
+      return t.value, list(v[:n])
+
+    def pose(self):
+      return self.get(POSE)
+
+    def on_update(self, id, fn):
+      # fn(id, time, values) is called from the client thread
+      def cb(id, t, n, values, user):
+        fn(id, t, values[:n])
+      c = CALLBACK(cb)
+      self.callbacks.append(c)
+      return self.lib.tclient_on_update(self.tc, id, c, None) == 1
+
+    def isLocal(self):
+      return self.lib.tclient_is_local(self.tc) == 1
+
+    def isConnected(self):
+      return self.lib.tclient_is_connected(self.tc) == 1
+
+    def rc(self, vel, turnrate, traceId = 0):
+      return self.lib.tclient_rc(self.tc, vel, turnrate, traceId) == 1
+
+    def traj(self, segments, id = 0):
+      return self.lib.tclient_traj(self.tc, segments.encode(), id) == 1
+
+    def send(self, cmd, params = ""):
+      # Teensy command, e.g. send("leds", "14 0 50 0")
+      return self.lib.tclient_send(self.tc, cmd.encode(), params.encode()) == 1
+
+    def command(self, tail, payload, senderTime = False):
+      # any command topic, e.g. command("ti/log", "1")
+      return self.lib.tclient_command(self.tc, tail.encode(), payload.encode(), 1 if senderTime else 0) == 1
+
+    def close(self):
+      if self.tc is not None:
+        self.lib.tclient_destroy(self.tc)
+        self.tc = None
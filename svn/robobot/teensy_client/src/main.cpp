@@ -0,0 +1,47 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+// Small example: print the pose for 5 seconds
+#include <stdio.h>
+#include <unistd.h>
+#include "tclient.h"
+
+int main(int argc, char ** argv)
+{
+  const char * host = "localhost";
+  const char * robot = "";
+  if (argc > 1)
+    host = argv[1];
+  if (argc > 2)
+    robot = argv[2];
+  TClient tc;
+  if (not tc.setup(host, robot))
+    printf("# tclient_demo:: no connection yet (will retry)\n");
+  tc.onPose([](const TPose & p)
+    { printf("%.4f pose x=%.3f y=%.3f h=%.3f\n", p.time, p.x, p.y, p.h); });
+  sleep(5);
+  TPose p = tc.pose();
+  printf("# tclient_demo:: local=%d, last pose %.4f x=%.3f y=%.3f\n", tc.isLocal(), p.time, p.x, p.y);
+  tc.terminate();
+  return 0;
+}
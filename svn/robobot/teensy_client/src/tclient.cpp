@@ -0,0 +1,456 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "tclient.h"
+
+/**
+ * MQTT messages with state from the Teensy, published by teensy_interface
+ * as <root>drive/T0/<key> with payload '<time> <Teensy message parameters>' */
+static const struct
+{
+  const char * key;
+  int id;     // record
+  int skip;   // parameters to skip (Teensy time)
+  int first;  // first value index in record
+  int n;      // values to use
+} stateTopic[] =
+{
+  {"pose", USHM_POSE, 1, 0, 4},
+  {"mvel", USHM_VEL, 0, 0, 2},
+  {"enc", USHM_ENC, 1, 0, 2},
+  {"acc", USHM_ACC, 0, 0, 3},
+  {"gyro", USHM_GYRO, 0, 0, 3},
+  {"liv", USHM_EDGE, 0, 0, 8},
+  {"livn", USHM_EDGEN, 0, 0, 8},
+  {"mca", USHM_CURRENT, 0, 0, 5},
+  {"sca", USHM_CURRENT, 0, 5, 1},
+  {"ir", USHM_DIST, 0, 0, 2},
+};
+
+/// names used in snapshot replies (same order as records)
+static const char * recordName[USHM_RECORDS] =
+    {"pose", "vel", "enc", "acc", "gyro", "edge", "edgen", "current", "dist"};
+
+static double timeNow()
+{
+  return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+bool TClient::setup(const char * host, const char * robot, int port, bool useShm)
+{
+  this->host = host;
+  this->port = port;
+  this->useShm = useShm;
+  root = "robobot/";
+  if (robot != nullptr and strlen(robot) > 0)
+    root += std::string(robot) + "/";
+  clientId = "tclient_" + std::to_string(getpid());
+  if (useShm)
+    openShm();
+  connectMqtt();
+  stop = false;
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+  return local or connected;
+}
+
+void TClient::terminate()
+{
+  stop = true;
+  if (th1 != nullptr)
+  {
+    th1->join();
+    delete th1;
+    th1 = nullptr;
+  }
+  if (client != nullptr)
+  {
+    if (connected)
+      MQTTClient_disconnect(client, 1000);
+    MQTTClient_destroy(&client);
+    client = nullptr;
+    connected = false;
+  }
+  closeShm();
+}
+
+bool TClient::openShm()
+{
+  shmTable = ushm_open(USHM_NAME);
+  if (shmTable == nullptr)
+    return false;
+  if (shmTable->alive == 0)
+  { // left by a stopped teensy_interface
+    closeShm();
+    return false;
+  }
+  shmPid = shmTable->pid;
+  for (int i = 0; i < USHM_RECORDS; i++)
+    shmCnt[i] = 0;
+  local = true;
+  return true;
+}
+
+void TClient::closeShm()
+{
+  local = false;
+  if (shmTable != nullptr)
+  {
+    ushm_close(shmTable);
+    shmTable = nullptr;
+  }
+}
+
+bool TClient::connectMqtt()
+{
+  if (client == nullptr)
+  {
+    std::string address = "tcp://" + host + ":" + std::to_string(port);
+    int rc = MQTTClient_create(&client, address.c_str(), clientId.c_str(), MQTTCLIENT_PERSISTENCE_NONE, NULL);
+    if (rc != MQTTCLIENT_SUCCESS)
+    {
+      printf("# TClient:: failed to create MQTT client (%d)\n", rc);
+      client = nullptr;
+      return false;
+    }
+    MQTTClient_setCallbacks(client, this, connlost, msgarrvd, nullptr);
+  }
+  MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
+  conn_opts.keepAliveInterval = 20;
+  conn_opts.cleansession = 1;
+  int rc = MQTTClient_connect(client, &conn_opts);
+  connected = rc == MQTTCLIENT_SUCCESS;
+  if (connected)
+  { // state only from MQTT if not local
+    subscribed = not local;
+    if (subscribed)
+      MQTTClient_subscribe(client, (root + "drive/T0/#").c_str(), 0);
+    // get all state now, rather than wait for updates
+    std::string replyTopic = root + "drive/snapshot/" + clientId;
+    MQTTClient_subscribe(client, replyTopic.c_str(), 0);
+    command("ti/snapshot", (clientId + " all").c_str());
+  }
+  return connected;
+}
+
+void TClient::connlost(void * context, char * /*cause*/)
+{ // reconnect is done by the client thread
+  TClient * tc = (TClient *)context;
+  tc->connected = false;
+}
+
+int TClient::msgarrvd(void * context, char * topicName, int /*topicLen*/, MQTTClient_message * message)
+{
+  TClient * tc = (TClient *)context;
+  std::string payload((char*)message->payload, message->payloadlen);
+  tc->decode(topicName, payload.c_str());
+  MQTTClient_freeMessage(&message);
+  MQTTClient_free(topicName);
+  return 1;
+}
+
+void TClient::decode(const char * topic, const char * payload)
+{
+  if (strncmp(topic, root.c_str(), root.size()) != 0)
+    return;
+  const char * tail = topic + root.size();
+  if (strncmp(tail, "drive/snapshot/", 15) == 0)
+  {
+    decodeSnapshot(payload);
+    return;
+  }
+  if (strncmp(tail, "drive/T0/", 9) != 0 or local)
+    return;
+  const char * key = tail + 9;
+  for (const auto & st : stateTopic)
+  {
+    if (strcmp(key, st.key) == 0)
+    {
+      TState s;
+      {
+        std::lock_guard<std::mutex> lock(stateLock);
+        s = state[st.id];
+      }
+      const char * p1 = payload;
+      s.id = st.id;
+      s.time = strtod(p1, (char**)&p1);
+      for (int i = 0; i < st.skip; i++)
+        strtod(p1, (char**)&p1);
+      for (int i = 0; i < st.n; i++)
+        s.value[st.first + i] = strtod(p1, (char**)&p1);
+      s.n = std::max(s.n, st.first + st.n);
+      s.cnt++;
+      update(s);
+      break;
+    }
+  }
+}
+
+void TClient::decodeSnapshot(const char * payload)
+{ // lines of '<name> <time> <cnt> <values>', after the MQTT time
+  const char * p1 = strchr(payload, ' ');
+  while (p1 != nullptr and *p1 != '\0')
+  {
+    while (*p1 == ' ' or *p1 == '\n')
+      p1++;
+    const char * p2 = p1;
+    while (*p2 > ' ')
+      p2++;
+    std::string name(p1, p2 - p1);
+    const char * eol = strchrnul(p2, '\n');
+    for (int id = 0; id < USHM_RECORDS; id++)
+    {
+      if (name == recordName[id])
+      {
+        TState s;
+        s.id = id;
+        s.time = strtod(p2, (char**)&p2);
+        s.cnt = strtoul(p2, (char**)&p2, 10);
+        while (p2 < eol and s.n < USHM_MAX_VALUES)
+        {
+          const char * p3 = p2;
+          double v = strtod(p2, (char**)&p2);
+          if (p3 == p2)
+            break;
+          s.value[s.n++] = v;
+        }
+        if (s.cnt > 0)
+        {
+          std::lock_guard<std::mutex> lock(stateLock);
+          if (state[id].cnt == 0)
+            state[id] = s;
+        }
+        break;
+      }
+    }
+    p1 = eol;
+  }
+}
+
+void TClient::update(const TState & s)
+{
+  {
+    std::lock_guard<std::mutex> lock(stateLock);
+    state[s.id] = s;
+  }
+  std::lock_guard<std::mutex> lock(callbackLock);
+  for (auto & cb : callback[s.id])
+    cb(s);
+}
+
+void TClient::pollShm()
+{
+  for (int id = 0; id < USHM_RECORDS; id++)
+  {
+    uint32_t cnt = __atomic_load_n(&shmTable->record[id].cnt, __ATOMIC_RELAXED);
+    if (cnt != shmCnt[id])
+    {
+      ushm_record r;
+      if (ushm_read(shmTable, id, &r))
+      {
+        TState s;
+        s.id = id;
+        s.cnt = r.cnt;
+        s.time = r.time;
+        s.n = r.n;
+        memcpy(s.value, r.value, sizeof(s.value));
+        shmCnt[id] = r.cnt;
+        update(s);
+      }
+    }
+  }
+}
+
+void TClient::run()
+{
+  int loop = 0;
+  while (not stop)
+  {
+    if (local)
+    { // teensy_interface may have been restarted
+      if (shmTable->alive == 0 or shmTable->magic != USHM_MAGIC)
+        closeShm();
+      else
+        pollShm();
+    }
+    if (loop % 1000 == 0)
+    { // check connections every second
+      if (not local and useShm and openShm())
+        printf("# TClient:: using shared memory state\n");
+      if (not connected)
+      {
+        if (connectMqtt())
+          printf("# TClient:: connected to MQTT broker %s:%d\n", host.c_str(), port);
+      }
+      else if (not local and not subscribed)
+      { // lost the shared memory, so get state from MQTT
+        MQTTClient_subscribe(client, (root + "drive/T0/#").c_str(), 0);
+        subscribed = true;
+      }
+    }
+    loop++;
+    usleep(1000);
+  }
+}
+
+bool TClient::get(int id, TState & s)
+{
+  if (id < 0 or id >= USHM_RECORDS)
+    return false;
+  std::lock_guard<std::mutex> lock(stateLock);
+  s = state[id];
+  return s.cnt > 0;
+}
+
+TPose TClient::pose()
+{
+  TState s;
+  get(USHM_POSE, s);
+  return TPose(s);
+}
+
+TVelocity TClient::velocity()
+{
+  TState s;
+  get(USHM_VEL, s);
+  return TVelocity(s);
+}
+
+TVector3 TClient::acc()
+{
+  TState s;
+  get(USHM_ACC, s);
+  return TVector3(s);
+}
+
+TVector3 TClient::gyro()
+{
+  TState s;
+  get(USHM_GYRO, s);
+  return TVector3(s);
+}
+
+TEdge TClient::edge(bool normalized)
+{
+  TState s;
+  get(normalized ? USHM_EDGEN : USHM_EDGE, s);
+  return TEdge(s);
+}
+
+TDistance TClient::distance()
+{
+  TState s;
+  get(USHM_DIST, s);
+  return TDistance(s);
+}
+
+void TClient::onUpdate(int id, TStateCallback cb)
+{
+  if (id < 0 or id >= USHM_RECORDS)
+    return;
+  std::lock_guard<std::mutex> lock(callbackLock);
+  callback[id].push_back(cb);
+}
+
+void TClient::onPose(std::function<void(const TPose &)> cb)
+{
+  onUpdate(USHM_POSE, [cb](const TState & s) { cb(TPose(s)); });
+}
+
+void TClient::onVelocity(std::function<void(const TVelocity &)> cb)
+{
+  onUpdate(USHM_VEL, [cb](const TState & s) { cb(TVelocity(s)); });
+}
+
+void TClient::onGyro(std::function<void(const TVector3 &)> cb)
+{
+  onUpdate(USHM_GYRO, [cb](const TState & s) { cb(TVector3(s)); });
+}
+
+void TClient::onEdge(std::function<void(const TEdge &)> cb, bool normalized)
+{
+  onUpdate(normalized ? USHM_EDGEN : USHM_EDGE, [cb](const TState & s) { cb(TEdge(s)); });
+}
+
+void TClient::onDistance(std::function<void(const TDistance &)> cb)
+{
+  onUpdate(USHM_DIST, [cb](const TState & s) { cb(TDistance(s)); });
+}
+
+bool TClient::command(const char * tail, const char * payload, bool senderTime)
+{
+  if (not connected)
+    return false;
+  std::string topic = root + "cmd/" + tail;
+  const int MSL = 2000;
+  char s[MSL];
+  if (senderTime)
+    snprintf(s, MSL, "ts:%.4f %s", timeNow(), payload);
+  else
+    snprintf(s, MSL, "%s", payload);
+  std::lock_guard<std::mutex> lock(sendLock);
+  MQTTClient_deliveryToken token;
+  int rc = MQTTClient_publish(client, topic.c_str(), strlen(s), s, 0, 0, &token);
+  return rc == MQTTCLIENT_SUCCESS;
+}
+
+bool TClient::rc(float vel, float turnrate, int traceId)
+{
+  const int MSL = 100;
+  char s[MSL];
+  if (traceId != 0)
+    snprintf(s, MSL, "tr:%d %g %g", traceId, vel, turnrate);
+  else
+    snprintf(s, MSL, "%g %g", vel, turnrate);
+  return command("ti/rc", s, true);
+}
+
+bool TClient::traj(const char * segments, int id)
+{
+  std::string s = "id=" + std::to_string(id) + "; " + segments;
+  return command("ti/traj", s.c_str(), true);
+}
+
+bool TClient::send(const char * cmd, const char * params)
+{
+  std::string tail = std::string("T0/") + cmd;
+  return command(tail.c_str(), params, true);
+}
+
+bool TClient::batch(const std::vector<std::string> & cmds)
+{
+  std::string s;
+  for (const auto & c : cmds)
+  {
+    if (not s.empty())
+      s += "; ";
+    s += c;
+  }
+  return command("T0/batch", s.c_str(), true);
+}
@@ -0,0 +1,233 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+#include <MQTTClient.h>
+
+#include "ushmstate.h"
+
+/**
+ * One state record, e.g. the pose, as read from shared memory
+ * or decoded from MQTT. Values are as in ushmstate.h. */
+class TState
+{
+public:
+  /// record (USHM_POSE, USHM_VEL, ...)
+  int id = -1;
+  /// update count (shared memory) or messages received (MQTT)
+  uint32_t cnt = 0;
+  /// time of data (seconds since 1970)
+  double time = 0;
+  /// number of values
+  int n = 0;
+  double value[USHM_MAX_VALUES] = {0};
+};
+
+/// robot pose from odometry
+class TPose
+{
+public:
+  double time = 0;
+  float x = 0, y = 0, h = 0, tilt = 0;
+  TPose() {}
+  TPose(const TState & s) : time(s.time), x(s.value[0]), y(s.value[1]), h(s.value[2]), tilt(s.value[3]) {}
+};
+
+/// left and right wheel velocity (m/s)
+class TVelocity
+{
+public:
+  double time = 0;
+  float left = 0, right = 0;
+  TVelocity() {}
+  TVelocity(const TState & s) : time(s.time), left(s.value[0]), right(s.value[1]) {}
+};
+
+/// x, y, z values (acc or gyro)
+class TVector3
+{
+public:
+  double time = 0;
+  float x = 0, y = 0, z = 0;
+  TVector3() {}
+  TVector3(const TState & s) : time(s.time), x(s.value[0]), y(s.value[1]), z(s.value[2]) {}
+};
+
+/// line sensor values (raw or normalized)
+class TEdge
+{
+public:
+  double time = 0;
+  int value[8] = {0};
+  TEdge() {}
+  TEdge(const TState & s) : time(s.time)
+  {
+    for (int i = 0; i < 8; i++)
+      value[i] = s.value[i];
+  }
+};
+
+/// IR distance (m)
+class TDistance
+{
+public:
+  double time = 0;
+  float d[2] = {0};
+  TDistance() {}
+  TDistance(const TState & s) : time(s.time) { d[0] = s.value[0]; d[1] = s.value[1]; }
+};
+
+typedef std::function<void(const TState &)> TStateCallback;
+
+/**
+ * Client for teensy_interface.
+ * State is read from the shared memory table when teensy_interface
+ * runs on this computer, else it is decoded from MQTT.
+ * Commands are always sent over MQTT.
+ * Lost connections (MQTT broker or teensy_interface restart) are
+ * re-established by a background thread.
+ *
+ * Example:
+ *   TClient tc;
+ *   tc.setup("localhost");
+ *   tc.onPose([](const TPose & p) { printf("x=%g\n", p.x); });
+ *   tc.rc(0.2, 0.0);
+ *
+ * Callbacks are called from the client thread (shared memory)
+ * or the MQTT library thread, so they should return fast. */
+class TClient
+{
+public:
+  /**
+   * Connect to teensy_interface
+   * \param host is the MQTT broker
+   * \param robot is the robot name space (empty or as [mqtt] robot in robot.ini)
+   * \param port is the MQTT port
+   * \param useShm use the shared memory table, if available
+   * \returns true if connected to MQTT or shared memory */
+  bool setup(const char * host = "localhost", const char * robot = "", int port = 1883, bool useShm = true);
+  /**
+   * Disconnect and stop client thread */
+  void terminate();
+  /**
+   * Newest value of a state record
+   * \param id is e.g. USHM_POSE
+   * \returns false if no data (yet) */
+  bool get(int id, TState & state);
+  /// typed versions
+  TPose pose();
+  TVelocity velocity();
+  TVector3 acc();
+  TVector3 gyro();
+  TEdge edge(bool normalized = false);
+  TDistance distance();
+  /**
+   * Call this function on every update of a record */
+  void onUpdate(int id, TStateCallback cb);
+  /// typed versions
+  void onPose(std::function<void(const TPose &)> cb);
+  void onVelocity(std::function<void(const TVelocity &)> cb);
+  void onGyro(std::function<void(const TVector3 &)> cb);
+  void onEdge(std::function<void(const TEdge &)> cb, bool normalized = false);
+  void onDistance(std::function<void(const TDistance &)> cb);
+  /**
+   * Drive command
+   * \param vel is linear velocity (m/s)
+   * \param turnrate (rad/s)
+   * \param traceId is an optional latency trace ID
+   * \returns true if send */
+  bool rc(float vel, float turnrate, int traceId = 0);
+  /**
+   * Drive a trajectory, e.g. 'v=0.2 t=1.5; v=0.2 cu=2 d=0.5' */
+  bool traj(const char * segments, int id = 0);
+  /**
+   * Send a command to the Teensy, e.g. send("leds", "14 0 50 0") */
+  bool send(const char * cmd, const char * params);
+  /**
+   * Send more Teensy commands in one write (all or none is used) */
+  bool batch(const std::vector<std::string> & cmds);
+  /**
+   * Publish a command to teensy_interface
+   * \param tail is the topic after <root>cmd/, e.g. 'ti/log'
+   * \param payload is the parameters
+   * \param senderTime add 'ts:<time>', so an old command can be discarded
+   *        (accepted by ti/rc, ti/traj and T0/ commands) */
+  bool command(const char * tail, const char * payload, bool senderTime = false);
+  /// is data from shared memory
+  bool isLocal() { return local; }
+  /// is connected to MQTT broker
+  bool isConnected() { return connected; }
+  /**
+   * client thread */
+  void run();
+
+private:
+  static void runObj(TClient * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /// MQTT library callbacks
+  static void connlost(void * context, char * cause);
+  static int msgarrvd(void * context, char * topicName, int topicLen, MQTTClient_message * message);
+  bool connectMqtt();
+  bool openShm();
+  void closeShm();
+  /// poll shared memory for updates
+  void pollShm();
+  /// decode state message from MQTT
+  void decode(const char * topic, const char * payload);
+  /// decode snapshot reply
+  void decodeSnapshot(const char * payload);
+  /// store and call callbacks
+  void update(const TState & s);
+  //
+  std::string host;
+  std::string root;
+  std::string clientId;
+  int port = 1883;
+  bool useShm = true;
+  MQTTClient client = nullptr;
+  std::atomic<bool> connected{false};
+  bool subscribed = false;
+  ushm_table * shmTable = nullptr;
+  std::atomic<bool> local{false};
+  int shmPid = 0;
+  uint32_t shmCnt[USHM_RECORDS] = {0};
+  TState state[USHM_RECORDS];
+  std::mutex stateLock;
+  std::vector<TStateCallback> callback[USHM_RECORDS];
+  std::mutex callbackLock;
+  std::mutex sendLock;
+  std::thread * th1 = nullptr;
+  std::atomic<bool> stop{false};
+};
+
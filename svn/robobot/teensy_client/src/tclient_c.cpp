@@ -0,0 +1,92 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include "tclient.h"
+#include "tclient_c.h"
+
+tclient_t tclient_create(const char * host, const char * robot, int port, int use_shm)
+{
+  TClient * tc = new TClient();
+  tc->setup(host, robot, port, use_shm != 0);
+  return tc;
+}
+
+void tclient_destroy(tclient_t tc)
+{
+  TClient * c = (TClient *)tc;
+  c->terminate();
+  delete c;
+}
+
+int tclient_get(tclient_t tc, int id, double * time, double * values, int max)
+{
+  if (id < 0 or id >= USHM_RECORDS)
+    return -1;
+  TState s;
+  if (not ((TClient *)tc)->get(id, s))
+    return 0;
+  *time = s.time;
+  int n = std::min(s.n, max);
+  for (int i = 0; i < n; i++)
+    values[i] = s.value[i];
+  return n;
+}
+
+int tclient_on_update(tclient_t tc, int id, tclient_callback cb, void * user)
+{
+  if (id < 0 or id >= USHM_RECORDS or cb == nullptr)
+    return 0;
+  ((TClient *)tc)->onUpdate(id, [cb, user](const TState & s)
+    { cb(s.id, s.time, s.n, s.value, user); });
+  return 1;
+}
+
+int tclient_is_local(tclient_t tc)
+{
+  return ((TClient *)tc)->isLocal();
+}
+
+int tclient_is_connected(tclient_t tc)
+{
+  return ((TClient *)tc)->isConnected();
+}
+
+int tclient_rc(tclient_t tc, float vel, float turnrate, int trace_id)
+{
+  return ((TClient *)tc)->rc(vel, turnrate, trace_id);
+}
+
+int tclient_traj(tclient_t tc, const char * segments, int id)
+{
+  return ((TClient *)tc)->traj(segments, id);
+}
+
+int tclient_send(tclient_t tc, const char * cmd, const char * params)
+{
+  return ((TClient *)tc)->send(cmd, params);
+}
+
+int tclient_command(tclient_t tc, const char * tail, const char * payload, int sender_time)
+{
+  return ((TClient *)tc)->command(tail, payload, sender_time != 0);
+}
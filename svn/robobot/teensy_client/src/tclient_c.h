@@ -0,0 +1,77 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+/**
+ * C interface to the teensy_interface client,
+ * used by the Python binding (python/tclient.py, ctypes).
+ * Record IDs are as in ushmstate.h (0 = pose, 1 = velocity, ...). */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void * tclient_t;
+/**
+ * Update callback
+ * \param id is the record
+ * \param time is data time (sec since 1970)
+ * \param n is number of values
+ * \param values is the data
+ * \param user is the pointer given to tclient_on_update() */
+typedef void (*tclient_callback)(int id, double time, int n, const double * values, void * user);
+
+/**
+ * Create a client and connect
+ * \param host is the MQTT broker
+ * \param robot is the robot name space (or empty)
+ * \param port is the MQTT port (1883)
+ * \param use_shm is 1 to use shared memory, when available
+ * \returns the client (to be destroyed by tclient_destroy()) */
+tclient_t tclient_create(const char * host, const char * robot, int port, int use_shm);
+void tclient_destroy(tclient_t tc);
+/**
+ * Get newest values of a record
+ * \param time is set to the data time
+ * \param values gets up to max values
+ * \returns number of values, 0 if no data yet, -1 if bad ID */
+int tclient_get(tclient_t tc, int id, double * time, double * values, int max);
+/**
+ * Call cb on each update of record id */
+int tclient_on_update(tclient_t tc, int id, tclient_callback cb, void * user);
+/** 1 if data is from shared memory */
+int tclient_is_local(tclient_t tc);
+/** 1 if connected to MQTT broker */
+int tclient_is_connected(tclient_t tc);
+/** commands, return 1 if send */
+int tclient_rc(tclient_t tc, float vel, float turnrate, int trace_id);
+int tclient_traj(tclient_t tc, const char * segments, int id);
+int tclient_send(tclient_t tc, const char * cmd, const char * params);
+int tclient_command(tclient_t tc, const char * tail, const char * payload, int sender_time);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+#
+# The MIT License (MIT)  https://mit-license.org/
+#
+# Round trip from the client library (through the Python binding)
+# to teensy_interface without robot hardware and back:
+# commands (trajectory and rc) must be used by teensy_interface,
+# state from a replayed log must get to the client, and the client
+# must stop.
+#
+# usage: test_roundtrip.py <teensy_interface binary> <libteensy_client.so>
+
+import os
+import sys
+import time
+here = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(here, "..", "..", "teensy_interface", "test"))
+sys.path.insert(0, os.path.join(here, "..", "python"))
+import tiftest
+import tclient
+
+replayLog = os.path.join(here, "..", "..", "doc", "matlab", "log_20250131_145940.242",
+                         "log_t0_teensy_io.txt")
+
+def metric(listen, root, name, since):
+  """ newest value of a counter, or -1 """
+  m = listen.messages(root + "metrics/" + name, since)
+  if len(m) == 0:
+    return -1
+  return int(m[-1][2].split()[1])
+
+def closeClient(test, tc):
+  t0 = time.time()
+  tc.close()
+  test.check(time.time() - t0 < 2, "client stopped in %.2f s" % (time.time() - t0))
+
+def testCommands(test, binary, lib, port, listen):
+  root = "robobot/cA/"
+  fast = {"metrics": {"interval_ms": "200"}}
+  daemon = tiftest.Daemon(binary, os.path.join(test.dir, "cA"), port, "cA", fast)
+  tc = None
+  try:
+    test.check(listen.waitFor(root + "metrics/", 10), "daemon is running")
+    tc = tclient.TClient("localhost", "cA", port, False, lib)
+    end = time.time() + 5
+    while not tc.isConnected() and time.time() < end:
+      time.sleep(0.05)
+    test.check(tc.isConnected(), "client connected")
+    # trajectory
+    t0 = time.time()
+    test.check(tc.traj("v=0 t=0.1", 17), "trajectory send")
+    test.check(listen.waitFor(root + "drive/traj", 3, t0), "trajectory response")
+    states = [m[2].split()[1:3] for m in listen.messages(root + "drive/traj", t0)]
+    end = time.time() + 2
+    while ["17", "done"] not in states and time.time() < end:
+      time.sleep(0.05)
+      states = [m[2].split()[1:3] for m in listen.messages(root + "drive/traj", t0)]
+    test.check(["17", "start"] in states and ["17", "done"] in states,
+               "trajectory 17 started and done %s" % states)
+    # rc (with sender time)
+    t0 = time.time()
+    listen.waitFor(root + "metrics/mailbox_put_total/rc", 2, t0)
+    n0 = metric(listen, root, "mailbox_put_total/rc", t0)
+    for i in range(5):
+      tc.rc(0.0, 0.0)
+      time.sleep(0.02)
+    t1 = time.time() + 0.3
+    listen.waitFor(root + "metrics/mailbox_put_total/rc", 2, t1)
+    n1 = metric(listen, root, "mailbox_put_total/rc", t1)
+    test.check(n0 >= 0 and n1 - n0 == 5, "5 rc commands used (%d -> %d)" % (n0, n1))
+    test.check(metric(listen, root, "mailbox_expired_total/rc", t1) == 0, "no rc command too old")
+  finally:
+    if tc is not None:
+      closeClient(test, tc)
+    daemon.stop()
+
+def testState(test, binary, lib, port, listen):
+  if not os.path.exists(replayLog):
+    print("# no replay log (%s), state part skipped" % replayLog)
+    return
+  root = "robobot/cR/"
+  daemon = tiftest.Daemon(binary, os.path.join(test.dir, "cR"), port, "cR", {},
+                          ["--replay", replayLog, "--replay-speed", "1"])
+  tc = None
+  try:
+    # the log has line sensor data (livn), but no pose
+    topic = root + "drive/T0/livn"
+    test.check(listen.waitFor(topic, 10), "replay publishes line sensor data")
+    tc = tclient.TClient("localhost", "cR", port, False, lib)
+    edges = []
+    tc.on_update(tclient.EDGEN, lambda id, t, v: edges.append((t, v)))
+    time.sleep(2)
+    test.check(len(edges) > 10, "client got %d line sensor updates" % len(edges))
+    e = tc.get(tclient.EDGEN)
+    test.check(e is not None and len(e[1]) == 8, "client has line sensor values %s" % str(e))
+    if e is not None:
+      # the same values as published by teensy_interface
+      sent = [m[2].split() for m in listen.messages(topic)]
+      match = [s for s in sent if abs(float(s[0]) - e[0]) < 1e-4]
+      test.check(len(match) > 0 and [float(v) for v in match[-1][1:9]] == e[1],
+                 "line sensor time and values as published")
+  finally:
+    if tc is not None:
+      closeClient(test, tc)
+    daemon.stop()
+
+def main(binary, lib):
+  if not os.path.exists(binary):
+    print("# skipped: no teensy_interface (%s)" % binary)
+    return tiftest.SKIP
+  tiftest.skipIfMissing()
+  test = tiftest.Test("roundtrip")
+  broker = tiftest.Broker(test.dir)
+  listen = tiftest.Listener(broker.port)
+  try:
+    testCommands(test, binary, lib, broker.port, listen)
+    testState(test, binary, lib, broker.port, listen)
+  finally:
+    listen.stop()
+    broker.stop()
+  return test.finish()
+
+if __name__ == "__main__":
+  if len(sys.argv) < 3:
+    print("usage: %s <teensy_interface binary> <libteensy_client.so>" % sys.argv[0])
+    sys.exit(1)
+  sys.exit(main(sys.argv[1], os.path.abspath(sys.argv[2])))
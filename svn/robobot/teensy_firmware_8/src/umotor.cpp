@@ -31,6 +31,7 @@
 #include "usubss.h"
 #include "ulog.h"
 #include "uencoder.h"
+#include "uservice.h"
 
 UMotor motor;
 
@@ -175,7 +176,7 @@ void UMotor::sendHelp()
   usb.send("# Motor -------\r\n");
   snprintf(reply, MRL, "# -- \tmotr V \tSet motor reversed; V=0 for small motors, V=1 for some big motors\r\n");
   usb.send(reply);
-  snprintf(reply, MRL, "# -- \tmotv m1 m2 \tSet motor voltage -24.0..24.0 - and enable motors\r\n");
+  snprintf(reply, MRL, "# -- \tmotv m1 m2 [id] \tSet motor voltage -24.0..24.0 - and enable motors (echo 'trace id t' if id)\r\n");
   usb.send(reply);
   snprintf(reply, MRL, "# -- \tmotfrq \tSet motor PWM frequency [100..50000], is %d\r\n", PWMfrq);
   usb.send(reply);
@@ -215,6 +216,16 @@ bool UMotor::decode(const char* buf)
     motorSetAnchorVoltage();
 //     usb.send("# setting motor voltage\n");
     // debug end 
+    // optional trace ID - echo when used
+    const char * p2 = p1;
+    int traceId = strtol(p1, (char**)&p2, 10);
+    if (p2 != p1 and traceId != 0)
+    {
+      const int MSL = 50;
+      char s[MSL];
+      snprintf(s, MSL, "trace %d %.4f\r\n", traceId, service.time_sec());
+      usb.send(s);
+    }
   }
   else if (strncmp(buf, "motfrq ", 7) == 0)
   {
@@ -0,0 +1,237 @@
+#/***************************************************************************
+#*   Copyright (C) 2024 by DTU
+#*   jcan@dtu.dk
+#*
+#*
+#* The MIT License (MIT)  https://mit-license.org/
+#*
+#* Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+#* and associated documentation files (the “Software”), to deal in the Software without restriction,
+#* including without limitation the rights to use, copy, modify, merge, publish, distribute,
+#* sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+#* is furnished to do so, subject to the following conditions:
+#*
+#* The above copyright notice and this permission notice shall be included in all copies
+#* or substantial portions of the Software.
+#*
+#* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+#* INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+#* PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+#* FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+#* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#* THE SOFTWARE. */
+
+# Reader (and converter) for columnar logs (.ulc) from teensy_interface
+# (made with [logger] columnar=true, format is described in src/ucolumnlog.h).
+# Usage as module:
+#   from log_columns import ColumnLog
+#   log = ColumnLog("log_t0_imu.ulc")
+#   print(log.names)
+#   data = log.read(t0 = 1740927700, t1 = 1740927710, columns = [0, 2])
+#   # data is a list of columns (numpy arrays if numpy is installed)
+# Usage from command line:
+#   python3 log_columns.py info <file.ulc>
+#   python3 log_columns.py dump <file.ulc> [t0 t1]
+#   python3 log_columns.py convert <log.txt> [file.ulc]
+
+import struct
+import sys
+
+try:
+  import numpy as np
+except ImportError:
+  np = None
+
+TYPE_INT = 0
+TYPE_DOUBLE = 1
+
+class ColumnLog:
+  def __init__(self, fileName):
+    self.f = open(fileName, "rb")
+    f = self.f
+    if f.read(4) != b"ULC1":
+      raise ValueError(f"{fileName} is not a columnar log")
+    version, columns, hl = struct.unpack("<III", f.read(12))
+    self.header = f.read(hl).decode(errors = "replace")
+    self.names = []
+    self.types = []
+    for c in range(columns):
+      t, n = struct.unpack("<BB", f.read(2))
+      self.types.append(t)
+      self.names.append(f.read(n).decode(errors = "replace"))
+    dataStart = f.tell()
+    # chunks: (offset, rows, tmin, tmax)
+    self.chunks = []
+    self.hadIndex = self.readIndex()
+    if not self.hadIndex:
+      self.scanChunks(dataStart)
+
+  def readIndex(self):
+    f = self.f
+    f.seek(0, 2)
+    if f.tell() < 12:
+      return False
+    f.seek(-12, 2)
+    indexPos, magic = struct.unpack("<Q4s", f.read(12))
+    if magic != b"ULCE":
+      return False
+    f.seek(indexPos)
+    if f.read(4) != b"CIDX":
+      return False
+    n, = struct.unpack("<I", f.read(4))
+    for i in range(n):
+      self.chunks.append(struct.unpack("<QIdd", f.read(28)))
+    return True
+
+  def scanChunks(self, p):
+    # file was not closed (no index), so find the chunks
+    f = self.f
+    columns = len(self.names)
+    f.seek(0, 2)
+    size = f.tell()
+    while p + 16 <= size:
+      f.seek(p)
+      magic, rows, nbytes = struct.unpack("<4sIQ", f.read(16))
+      if magic != b"CHNK" or p + 16 + nbytes > size:
+        break
+      mn = struct.unpack(f"<{columns}d", f.read(8 * columns))
+      mx = struct.unpack(f"<{columns}d", f.read(8 * columns))
+      self.chunks.append((p, rows, mn[0], mx[0]))
+      p += 16 + nbytes
+
+  def readColumn(self, dataPos, rows, c):
+    self.f.seek(dataPos + c * rows * 8)
+    raw = self.f.read(rows * 8)
+    fmt = "q" if self.types[c] == TYPE_INT else "d"
+    if np is not None:
+      return np.frombuffer(raw, dtype = "<i8" if fmt == "q" else "<f8")
+    return list(struct.unpack(f"<{rows}{fmt}", raw))
+
+  def read(self, t0 = None, t1 = None, columns = None):
+    # get columns (list of index or name) within time window
+    if columns is None:
+      columns = list(range(len(self.names)))
+    columns = [self.names.index(c) if isinstance(c, str) else c for c in columns]
+    ncol = len(self.names)
+    parts = [[] for c in columns]
+    for offset, rows, tmin, tmax in self.chunks:
+      if (t1 is not None and tmin > t1) or (t0 is not None and tmax < t0):
+        continue
+      dataPos = offset + 16 + ncol * 16
+      t = self.readColumn(dataPos, rows, 0)
+      use = [(t0 is None or x >= t0) and (t1 is None or x <= t1) for x in t]
+      for k, c in enumerate(columns):
+        v = t if c == 0 else self.readColumn(dataPos, rows, c)
+        if np is not None:
+          parts[k].append(v[np.array(use, dtype = bool)])
+        else:
+          parts[k].append([x for x, u in zip(v, use) if u])
+    if np is not None:
+      return [np.concatenate(p) if len(p) > 0 else np.array([]) for p in parts]
+    return [[x for p in ps for x in p] for ps in parts]
+
+  def close(self):
+    self.f.close()
+
+def namesFromHeader(header, columns):
+  # as UColumnLog::namesFromHeader(), lines like '% 2-4 \tGyro (x,y,z)'
+  names = [""] * columns
+  for line in header.splitlines():
+    s = line[1:].strip() if line.startswith("%") else ""
+    if len(s) == 0 or not s[0].isdigit():
+      continue
+    i = 0
+    while i < len(s) and (s[i].isdigit() or s[i] in "-,"):
+      i += 1
+    nums = [int(x) for x in s[:i].replace(",", "-").split("-") if x != ""]
+    a, b = nums[0], nums[-1]
+    desc = s[i:].strip()
+    for c in range(a, b + 1):
+      v = c - 2
+      if 0 <= v < columns and names[v] == "":
+        names[v] = desc + (f" {c - a + 1}" if b > a else "")
+  return [n if n != "" else f"c{v + 2}" for v, n in enumerate(names)]
+
+def convert(txtName, ulcName = None, chunkRows = 4096):
+  # convert a text log to a columnar log
+  if ulcName is None:
+    ulcName = (txtName[:-4] if txtName.endswith(".txt") else txtName) + ".ulc"
+  header = ""
+  types = None
+  out = None
+  rows = []
+  index = []
+  cnt = 0
+  def flush():
+    ncol = len(types) + 1
+    n = len(rows)
+    cols = list(zip(*rows))
+    mn = [min(c) for c in cols]
+    mx = [max(c) for c in cols]
+    offset = out.tell()
+    out.write(struct.pack("<4sIQ", b"CHNK", n, ncol * 16 + ncol * n * 8))
+    out.write(struct.pack(f"<{ncol}d", *mn))
+    out.write(struct.pack(f"<{ncol}d", *mx))
+    for k, c in enumerate(cols):
+      fmt = "d" if k == 0 or types[k - 1] == TYPE_DOUBLE else "q"
+      out.write(struct.pack(f"<{n}{fmt}", *c))
+    index.append((offset, n, mn[0], mx[0]))
+    rows.clear()
+  with open(txtName) as f:
+    for line in f:
+      if line.startswith("%"):
+        if out is None:
+          header += line
+        continue
+      tok = line.split()
+      if len(tok) < 2:
+        continue
+      if out is None:
+        types = [TYPE_DOUBLE if any(ch in t for ch in ".eEna") else TYPE_INT for t in tok[1:]]
+        names = namesFromHeader(header, len(types))
+        out = open(ulcName, "wb")
+        hb = header.encode()
+        out.write(struct.pack("<4sIII", b"ULC1", 1, len(types) + 1, len(hb)))
+        out.write(hb)
+        for t, n in zip([TYPE_DOUBLE] + types, ["time"] + names):
+          nb = n.encode()[:255]
+          out.write(struct.pack("<BB", t, len(nb)))
+          out.write(nb)
+      tok = (tok + ["0"] * len(types))[:len(types) + 1]
+      rows.append([float(tok[0])] + [int(float(x)) if t == TYPE_INT else float(x) for x, t in zip(tok[1:], types)])
+      cnt += 1
+      if len(rows) >= chunkRows:
+        flush()
+  if out is None:
+    print(f"% no data in {txtName}")
+    return 0
+  if len(rows) > 0:
+    flush()
+  indexPos = out.tell()
+  out.write(struct.pack("<4sI", b"CIDX", len(index)))
+  for e in index:
+    out.write(struct.pack("<QIdd", *e))
+  out.write(struct.pack("<Q4s", indexPos, b"ULCE"))
+  out.close()
+  print(f"% converted {cnt} lines from {txtName} to {ulcName}")
+  return cnt
+
+if __name__ == "__main__":
+  if len(sys.argv) < 3:
+    print("usage: python3 log_columns.py info|dump|convert <file> [...]")
+  elif sys.argv[1] == "info":
+    log = ColumnLog(sys.argv[2])
+    rows = sum(c[1] for c in log.chunks)
+    print(log.header, end = "")
+    print(f"% {len(log.names)} columns, {rows} rows in {len(log.chunks)} chunks")
+    for c, (n, t) in enumerate(zip(log.names, log.types)):
+      print(f"% column {c} {n} ({'int' if t == TYPE_INT else 'double'})")
+  elif sys.argv[1] == "dump":
+    log = ColumnLog(sys.argv[2])
+    t0 = float(sys.argv[3]) if len(sys.argv) > 3 else None
+    t1 = float(sys.argv[4]) if len(sys.argv) > 4 else None
+    data = log.read(t0, t1)
+    for row in zip(*data):
+      print(f"{row[0]:.4f} " + " ".join(str(x) for x in row[1:]))
+  elif sys.argv[1] == "convert":
+    convert(sys.argv[2], sys.argv[3] if len(sys.argv) > 3 else None)
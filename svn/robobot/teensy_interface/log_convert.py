@@ -0,0 +1,155 @@
+#/***************************************************************************
+#*   Copyright (C) 2024 by DTU
+#*   jcan@dtu.dk
+#*
+#*
+#* The MIT License (MIT)  https://mit-license.org/
+#*
+#* Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+#* and associated documentation files (the “Software”), to deal in the Software without restriction,
+#* including without limitation the rights to use, copy, modify, merge, publish, distribute,
+#* sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+#* is furnished to do so, subject to the following conditions:
+#*
+#* The above copyright notice and this permission notice shall be included in all copies
+#* or substantial portions of the Software.
+#*
+#* THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+#* INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+#* PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+#* FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+#* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#* THE SOFTWARE. */
+
+# Convert data logs from teensy_interface to the usual text logfiles.
+# - binary logs (log_binary.bin, made with [logger] binary=true) are
+#   appended to the logfiles named in the binary log,
+#   these files hold the column description already.
+# - compressed and/or rotated logs (e.g. log_enc_000.txt.gz, log_enc_001.txt.gz)
+#   are joined to one text file (log_enc.txt).
+# usage: python3 log_convert.py [log directory or files ...]
+
+import glob
+import gzip
+import os
+import re
+import struct
+import sys
+
+KIND_INT = 0
+KIND_DOUBLE = 1
+KIND_TEXT = 2
+
+def openLog(name, mode):
+  if name.endswith(".gz"):
+    return gzip.open(name, mode)
+  return open(name, mode)
+
+def convert(binName, destDir = None):
+  streams = {} # id: (file, timeDecimals, format)
+  cnt = 0
+  with openLog(binName, "rb") as f:
+    magic = f.read(4)
+    if magic != b"ULOG":
+      print(f"% {binName} is not a binary log")
+      return 0
+    version, = struct.unpack("<I", f.read(4))
+    while True:
+      hdr = f.read(4)
+      if len(hdr) < 4:
+        break
+      a, b = struct.unpack("<HH", hdr)
+      if a == 0xffff:
+        # stream definition 'id\tfilename\ttimeDecimals\tformat'
+        id, fn, dec, fmt = f.read(b).decode().split("\t", 3)
+        if destDir is not None:
+          fn = os.path.join(destDir, os.path.basename(fn))
+        streams[int(id)] = (open(fn, "a"), int(dec), fmt)
+        continue
+      # a record
+      rest = f.read(12)
+      if len(rest) < 12:
+        break
+      n = b & 0xff
+      textLen = b >> 8
+      kinds, sec, usec = struct.unpack("<III", rest)
+      raw = f.read(8 * n)
+      text = f.read(textLen).decode(errors = "replace").rstrip("\0")
+      values = []
+      for k in range(n):
+        kind = (kinds >> (2 * k)) & 3
+        if kind == KIND_DOUBLE:
+          values.append(struct.unpack_from("<d", raw, 8 * k)[0])
+        elif kind == KIND_TEXT:
+          values.append(text)
+        else:
+          values.append(struct.unpack_from("<q", raw, 8 * k)[0])
+      if a not in streams:
+        continue
+      out, dec, fmt = streams[a]
+      if dec == 3:
+        t = f"{sec}.{usec // 1000:03d} "
+      else:
+        t = f"{sec}.{usec // 100:04d} "
+      out.write(t + (fmt % tuple(values)))
+      cnt += 1
+  for s in streams.values():
+    s[0].close()
+  return cnt
+
+def join(name, segments):
+  # join segments to one text file, header from first segment only
+  if os.path.exists(name):
+    print(f"% {name} exists already, not joined")
+    return 0
+  cnt = 0
+  with open(name, "w") as out:
+    for i, seg in enumerate(segments):
+      with openLog(seg, "rt") as f:
+        for line in f:
+          if i > 0 and line.startswith("%"):
+            continue
+          out.write(line)
+          cnt += 1
+  return cnt
+
+def segmentKey(name):
+  # e.g. 'log_enc_003.txt.gz' gives ('log_enc.txt', 3)
+  m = re.match(r"(.*)_(\d{3})(\.[^/]*?)(\.gz)?$", name)
+  if m:
+    return (m.group(1) + m.group(3), int(m.group(2)))
+  if name.endswith(".gz"):
+    return (name[:-3], 0)
+  return (name, 0)
+
+def convertFiles(files):
+  binaries = {}
+  texts = {}
+  for fn in files:
+    base, seg = segmentKey(fn)
+    if base.endswith(".bin"):
+      binaries.setdefault(base, []).append((seg, fn))
+    elif fn != base:
+      # compressed or rotated text log
+      texts.setdefault(base, []).append((seg, fn))
+  for base, segs in sorted(binaries.items()):
+    for seg, fn in sorted(segs):
+      n = convert(fn, os.path.dirname(fn))
+      print(f"% converted {n} log lines from {fn}")
+  for base, segs in sorted(texts.items()):
+    n = join(base, [fn for seg, fn in sorted(segs)])
+    print(f"% joined {len(segs)} segments to {base} ({n} lines)")
+
+if __name__ == "__main__":
+  args = sys.argv[1:]
+  if len(args) == 0:
+    args = ["."]
+  files = []
+  for a in args:
+    if os.path.isdir(a):
+      files += glob.glob(os.path.join(a, "log_*.bin*"))
+      files += glob.glob(os.path.join(a, "log_*.txt.gz"))
+      files += glob.glob(os.path.join(a, "log_*_[0-9][0-9][0-9].txt"))
+    else:
+      files.append(a)
+  convertFiles(files)
@@ -34,10 +34,17 @@
 // #include "csteering.h"
 #include "mjoy.h"
 #include "mvelocity.h"
+#include "umqttrouter.h"
+#include "utrace.h"
+#include "uflightrec.h"
+#include "utimeline.h"
+#include "udiag.h"
 #include <stdlib.h>
 
 // create value
 CMixer mixer;
+// diagnostics level for this module
+static UDiagModule dg("mixer");
 
 
 /// mixer class combines drive orders to desired wheel velocity
@@ -60,6 +67,28 @@ void CMixer::setup()
     ini["mixer"]["drive_gear"] = "1"; // any gear after the motor gear
     ini["mixer"]["wheel_radius"] = "0.075";       // wheel radius (m)
   }
+  if (not ini["mixer"].has("rc_max_age_ms"))
+  { // rc commands older than this are not used (0 = no limit)
+    ini["mixer"]["rc_max_age_ms"] = "300";
+  }
+  rcBox.setup("rc", strtof(ini["mixer"]["rc_max_age_ms"].c_str(), nullptr) / 1000.0);
+  if (not ini["mixer"].has("traj_max_age_ms"))
+  { // trajectories (ti/traj) older than this are not used,
+    // and progress is published with this interval
+    ini["mixer"]["traj_max_age_ms"] = "1000";
+    ini["mixer"]["traj_progress_ms"] = "100";
+  }
+  trajBox.setup("traj", strtof(ini["mixer"]["traj_max_age_ms"].c_str(), nullptr) / 1000.0);
+  trajPublishInterval = strtof(ini["mixer"]["traj_progress_ms"].c_str(), nullptr) / 1000.0;
+  trajLoop.setup("mixer_traj", 0.001);
+  topicTraj.setup(mqtt.root + ini["mqtt"]["function"] + "traj");
+  // commands from MQTT
+  router.add(mqtt.root + "cmd/ti/rc", "mixer_rc",
+    [this](const char *, const char * tail, const char * payload, UTime & msgTime)
+    { return decode(tail, payload, msgTime); });
+  router.add(mqtt.root + "cmd/ti/traj", "mixer_traj",
+    [this](const char *, const char * tail, const char * payload, UTime & msgTime)
+    { return decode(tail, payload, msgTime); });
   // get values from ini-file
   //
   wheelbase = strtof(ini["mixer"]["wheelbase"].c_str(), nullptr);
@@ -118,6 +147,7 @@ void CMixer::setup()
       fprintf(logfile, "%% 5 \tCurvature (rad/m)\n");
       fprintf(logfile, "%% 6 \tDesired left wheel velocity (rad/s)\n");
       fprintf(logfile, "%% 7 \tDesired right wheel velocity (rad/s)\n");
+      log = logger.stream(logfile, fn, "%d %d %.3f %.3f %.3f %.3f %d\n");
       // fprintf(logfile, "%% 7 \tDesired left turn-motor velocity (rad/s)\n");
       // fprintf(logfile, "%% 8 \tDesired right turn-motor velocity (rad/s)\n");
     }
@@ -131,25 +161,46 @@ bool CMixer::decode(const char* msg, const char * params, UTime & msgTime)
   bool used = true;
   const char * p1 = msg;
   if (strncmp(msg, "rc", 2) == 0)
-  {
-    p1 = params;
+  { // drive command: [ts:<sender time>] [tr:<trace id>] velocity turnrate
+    // the command time is the sender time, if available
+    UTime cmdTime = msgTime;
+    p1 = getSenderTime(params, cmdTime);
+    int traceId;
+    p1 = getTraceId(p1, traceId);
     // printf("# CMixer::decode: %lu.%04ld topic=%s, params %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, msg, p1);
     if (strlen(p1) < 3)
       return false;
     rcTime = msgTime;
     // rcSource = strtol(p1, (char**)&p1, 10);
     rcSource = 2;
-    float vel = strtof(p1, (char**)&p1);
-    float rot = strtof(p1, (char**)&p1);
-    if (rcSource > 1)
+    CMixerCmd cmd;
+    cmd.vel = strtof(p1, (char**)&p1);
+    cmd.turnrate = strtof(p1, (char**)&p1);
+    cmd.traceId = traceId;
+    if (traceId != 0)
+    { // time at sender (if known), arrival and here
+      if (cmdTime != msgTime)
+        tracer.stamp(traceId, UTrace::SENDER, cmdTime);
+      tracer.stamp(traceId, UTrace::MQTT_RX, msgTime);
+      UTime t("now");
+      tracer.stamp(traceId, UTrace::ROUTED, t);
+    }
+    // used by run() - if not too old
+    rcBox.put(cmd, cmdTime);
+    wake.notify();
+  }
+  else if (strncmp(msg, "traj", 4) == 0)
+  { // trajectory: [ts:<sender time>] [id=N;] segment; segment; ...
+    UTime cmdTime = msgTime;
+    p1 = getSenderTime(params, cmdTime);
+    CMixerTraj tr;
+    if (decodeTraj(p1, tr))
     {
-      setVelocity(vel, rot);
-      // notify users of a new update
-      updateCnt++;
-      // save to log - saved by run() loop
-      // if (updateCnt > 2)
-      //   toLog();
+      trajBox.put(tr, cmdTime);
+      wake.notify();
     }
+    else
+      DIAG(dg, UDiag::WARN, "# CMixer::decode: invalid trajectory '%s'\n", params);
   }
   else
     used = false;
@@ -162,9 +213,39 @@ void CMixer::run()
   bool upd;
   // bool updTurnMotors;
   int loop = 0;
+  uint32_t wakeSeen = 0;
+  timeline.threadName("mixer");
   while (not service.stop)
   {
     loop++;
+    CMixerCmd cmd;
+    UTime cmdTime;
+    if (rcBox.take(cmd, cmdTime))
+    { // newest valid rc command
+      UTimelineScope ts("mixer_rc");
+      if (trajActive)
+        trajEnd("aborted");
+      applyVelocity(cmd.vel, cmd.turnrate);
+      // notify users of a new update
+      updateCnt++;
+      if (cmd.traceId != 0)
+      { // pass the trace on to the motor controller
+        UTime t("now");
+        tracer.stamp(cmd.traceId, UTrace::MIXER, t);
+        traceId = cmd.traceId;
+      }
+    }
+    if (trajBox.take(trajNew, cmdTime))
+    { // new trajectory
+      trajStart(trajNew);
+    }
+    if (trajActive)
+    {
+      if (joy.manualMode())
+        trajEnd("aborted");
+      else
+        trajStep();
+    }
     upd = autoUpdate;
     autoUpdate = false;
     // updTurnMotors = false;
@@ -176,14 +257,14 @@ void CMixer::run()
     }
     if (upd or updateTime.getTimePassed() > 0.5)
     { // use the new data
+      UTimelineScope ts("mixer_update");
       updateTime.now();
       if (manualOverride)
       {  // source is manual control
         linVel = joy.velocity;
         turnrate = joy.turnValue;
         rcSource = 0;
-        // if (loop % 50 == 0)
-        printf("# CMixer, manualOverride, vel=%f (rad/s), curvature=%f (rad/m)\n", linVel, turnrate);
+        DIAG(dg, UDiag::DEBUG, "# CMixer, manualOverride, vel=%f (rad/s), curvature=%f (rad/m)\n", linVel, turnrate);
       }
       else
       { // source is MQTT
@@ -217,14 +298,14 @@ void CMixer::run()
       if (shouldWheelsBeRunning())
       {
         if (motor[0].inRelax() and updateTime.getSec() > 0)
-          printf("# CMixer:: %lu.%04ld got out of relax (linvel=%g, turnrate=%g)\n",
+          DIAG(dg, UDiag::INFO, "# CMixer:: %lu.%04ld got out of relax (linvel=%g, turnrate=%g)\n",
                  updateTime.getSec(), updateTime.getMicrosec()/100, linVel, turnrate);
         motor[0].setRelax(false);
       }
       else if (not mvel[0].areMotorsRunning())
       { // motors has stopped, so relax
         if (not motor[0].inRelax())
-          printf("# CMixer:: %lu.%04ld got into relax (linvel=%g, turnrate=%g)\n",
+          DIAG(dg, UDiag::INFO, "# CMixer:: %lu.%04ld got into relax (linvel=%g, turnrate=%g)\n",
                  updateTime.getSec(), updateTime.getMicrosec()/100, linVel, turnrate);
         motor[0].setRelax(true);
       }
@@ -236,28 +317,214 @@ void CMixer::run()
       motor[driveMotorRight[0]].desiredVelocity[driveMotorRight[1]] = v1; // m3
       if (driveMotorRight[2] >= 0)
         motor[driveMotorRight[0]].desiredVelocity[driveMotorRight[2]] = v1; // m4
+      if (traceId != 0)
+      { // trace follows the new desired velocity
+        motor[driveMotorLeft[0]].traceId = traceId;
+        traceId = 0;
+      }
+      flightrec.values("mixer", updateTime, {linVel, turnrate, v0, v1});
       //
       if (updateCnt > 0)
         toLog();
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (trajActive)
+    { // a trajectory is stepped every 1ms (new commands are used at the next step)
+      UTimelineScope ts("wait");
+      trajLoop.wait();
+    }
+    else
+    { // wait for new input, else refresh every 0.5 sec
+      UTimelineScope ts("wait");
+      float timeout = std::max(0.001, 0.5 - updateTime.getTimePassed());
+      wake.wait(wakeSeen, timeout, 0.001);
+    }
   }
 }
 
 
 void CMixer::setVelocity(float refLinearVelocity, float refCurvature)
+{ // direct order, so skip any waiting command
+  rcBox.clear();
+  trajBox.clear();
+  // the trajectory is stopped by the run() thread
+  trajStopRequest = trajActive;
+  applyVelocity(refLinearVelocity, refCurvature);
+  wake.notify();
+  DIAG(dg, UDiag::INFO, "# CMixer::setVelocity: vel=%.3f (m/s), turnrate=%.3f (rad/sec)\n", refLinearVelocity, refCurvature);
+}
+
+void CMixer::applyVelocity(float refLinearVelocity, float refCurvature)
 {
   desiredLinVel = refLinearVelocity;
   desiredCurvature = refCurvature;
   autoUpdate = true;
-  printf("# CMixer::setVelocity: vel=%.3f (m/s), turnrate=%.3f (rad/sec)\n", refLinearVelocity, refCurvature);
+  DIAG(dg, UDiag::DEBUG, "# CMixer::applyVelocity: vel=%.3f (m/s), turnrate=%.3f (rad/sec)\n", refLinearVelocity, refCurvature);
+}
+
+
+bool CMixer::decodeTraj(const char * params, CMixerTraj & tr)
+{ // format: [id=N;] segment; segment; ...
+  // segment: v=<m/s> [tr=<rad/s> | cu=<rad/m>] (t=<sec> | d=<m>)
+  // d=<m> needs a velocity (distance is along the path), so a turn on the spot must use t=<sec>
+  tr.segCnt = 0;
+  tr.id = 0;
+  const char * p1 = params;
+  while (*p1 != '\0' and tr.segCnt < CMixerTraj::MAX_SEGMENTS)
+  {
+    CMixerSegment & sg = tr.seg[tr.segCnt];
+    sg = CMixerSegment();
+    bool isSegment = false;
+    // one segment (or the ID)
+    while (*p1 != '\0' and *p1 != ';')
+    {
+      while (isspace(*p1))
+        p1++;
+      if (*p1 == ';' or *p1 == '\0')
+        break;
+      const char * eq = strchr(p1, '=');
+      if (eq == nullptr)
+        return false;
+      char * p2;
+      float v = strtof(eq + 1, &p2);
+      if (p2 == eq + 1)
+        // not a number
+        return false;
+      int n = eq - p1;
+      if (n == 2 and strncmp(p1, "id", 2) == 0)
+        tr.id = int(v);
+      else if (n == 1 and *p1 == 'v')
+      {
+        sg.vel = v;
+        isSegment = true;
+      }
+      else if (n == 2 and strncmp(p1, "tr", 2) == 0)
+        sg.turnrate = v;
+      else if (n == 2 and strncmp(p1, "cu", 2) == 0)
+      {
+        sg.curvature = v;
+        sg.useCurvature = true;
+      }
+      else if (n == 1 and *p1 == 't')
+        sg.duration = v;
+      else if (n == 1 and *p1 == 'd')
+        sg.distance = v;
+      else
+        return false;
+      p1 = p2;
+    }
+    if (isSegment)
+    { // must have an end condition
+      if (sg.duration <= 0 and sg.distance <= 0)
+        return false;
+      if (sg.distance > 0 and sg.duration <= 0 and fabsf(sg.vel) < 1e-4)
+      { // driven distance stays 0, so the segment would never end
+        DIAG(dg, UDiag::WARN, "# CMixer::decodeTraj: segment %d has d=%g, but v=0 (use t=)\n",
+             tr.segCnt + 1, sg.distance);
+        return false;
+      }
+      tr.segCnt++;
+    }
+    if (*p1 == ';')
+      p1++;
+  }
+  while (isspace(*p1) or *p1 == ';')
+    p1++;
+  if (*p1 != '\0')
+  { // more segments than can be used, the robot would stop early
+    DIAG(dg, UDiag::WARN, "# CMixer::decodeTraj: more than %d segments, trajectory rejected\n", CMixerTraj::MAX_SEGMENTS);
+    return false;
+  }
+  return tr.segCnt > 0;
+}
+
+void CMixer::trajStart(CMixerTraj & tr)
+{
+  if (trajActive)
+    trajEnd("aborted");
+  traj = tr;
+  trajActive = true;
+  trajStopRequest = false;
+  trajSeg = -1;
+  trajDist = 0;
+  trajStartTime.now();
+  trajLastStep = trajStartTime;
+  // first step period from now
+  trajLoop.restart();
+  trajPublish("start");
+  trajStep();
 }
 
+void CMixer::trajStep()
+{
+  if (trajStopRequest)
+  { // stopped by a direct order
+    trajEnd("aborted");
+    return;
+  }
+  UTime t("now");
+  // driven distance since last step (from wheel velocity)
+  float dt = t - trajLastStep;
+  trajLastStep = t;
+  float ds = fabsf(mvel[0].motorVel[0] + mvel[0].motorVel[1]) / 2.0 * dt;
+  trajSegDist += ds;
+  trajDist += ds;
+  bool next = trajSeg < 0;
+  if (not next)
+  { // test end condition for this segment
+    CMixerSegment & sg = traj.seg[trajSeg];
+    if (sg.duration > 0 and trajSegStart.getTimePassed() >= sg.duration)
+      next = true;
+    if (sg.distance > 0 and trajSegDist >= sg.distance)
+      next = true;
+  }
+  if (next)
+  {
+    trajSeg++;
+    if (trajSeg >= traj.segCnt)
+    { // finished
+      trajEnd("done");
+      return;
+    }
+    CMixerSegment & sg = traj.seg[trajSeg];
+    trajSegStart = t;
+    trajSegDist = 0;
+    float tr = sg.turnrate;
+    if (sg.useCurvature)
+      tr = sg.curvature * sg.vel;
+    applyVelocity(sg.vel, tr);
+    updateCnt++;
+    trajPublish("seg");
+  }
+  else if (trajLastPublish.getTimePassed() >= trajPublishInterval)
+    trajPublish("run");
+}
+
+void CMixer::trajEnd(const char* state)
+{ // stop the robot at the end of the trajectory
+  trajActive = false;
+  trajStopRequest = false;
+  applyVelocity(0, 0);
+  updateCnt++;
+  trajPublish(state);
+}
+
+void CMixer::trajPublish(const char * state)
+{ // progress: id state segment segments distance time
+  const int MSL = 100;
+  char s[MSL];
+  snprintf(s, MSL, "%d %s %d %d %.3f %.3f", traj.id, state, trajSeg, traj.segCnt,
+           trajDist, trajStartTime.getTimePassed());
+  trajLastPublish.now();
+  mqtt.publish(topicTraj, s, trajLastPublish);
+  if (toConsole)
+    printf("# CMixer::traj %s\n", s);
+}
 
 void CMixer::terminate()
 {
   if (th1 != nullptr)
   {
+    wake.notify();
     th1->join();
   }
   if (logfile != nullptr)
@@ -279,12 +546,9 @@ void CMixer::toLog()
 {
   if (service.stop)
     return;
-  if (logfile != nullptr and not service.stop_logging)
+  if (log != nullptr and not service.stop_logging)
   { // add to log after update
-    fprintf(logfile, "%lu.%04ld %d %d %.3f %.3f %.3f %.3f %d\n",
-            updateTime.getSec(), updateTime.getMicrosec()/100,
-            rcSource, manualOverride, linVel, turnrate, v0, v1, updateCnt
-            );
+    log->log(updateTime, rcSource, manualOverride, linVel, turnrate, v0, v1, updateCnt);
   }
   if (toConsole)
   {
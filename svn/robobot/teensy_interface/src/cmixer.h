@@ -26,11 +26,59 @@
 
 #include "cmotor.h"
 #include "utime.h"
+#include "ulogger.h"
+#include "umailbox.h"
+#include "unotify.h"
+#include "umqtt.h"
+#include "ulooptimer.h"
 // #include "cheading.h"
 //#include "mvelocity.h"
 
 using namespace std;
 
+/**
+ * A drive command (rc) as received from MQTT */
+class CMixerCmd
+{
+public:
+  /// linear velocity (m/s)
+  float vel = 0;
+  /// turnrate (rad/s)
+  float turnrate = 0;
+  /// trace ID (0 = not traced)
+  int traceId = 0;
+};
+
+/**
+ * One segment of a trajectory */
+class CMixerSegment
+{
+public:
+  /// linear velocity (m/s)
+  float vel = 0;
+  /// turnrate (rad/s), used if curvature is not given
+  float turnrate = 0;
+  /// curvature (rad/m), turnrate is then vel * curvature
+  float curvature = 0;
+  bool useCurvature = false;
+  /// segment ends after this time (sec), if > 0
+  float duration = 0;
+  /// segment ends after this driven distance (m), if > 0
+  float distance = 0;
+};
+
+/**
+ * A trajectory (list of segments) as received from MQTT */
+class CMixerTraj
+{
+public:
+  /// ID from client (returned in progress messages)
+  int id = 0;
+  static const int MAX_SEGMENTS = 50;
+  CMixerSegment seg[MAX_SEGMENTS];
+  int segCnt = 0;
+};
+
 /**
  * The mixer translates linear and rotation reference
  * values to velocity for each motor.
@@ -50,7 +98,8 @@ public:
    * close down */
   void terminate();
   /**
-   * Velocity control in automnomous mode
+   * Velocity control in automnomous mode.
+   * Any unused rc command from MQTT is discarded.
    * \param refLinearVelocity in meter per second
    * \param refCurvature in rad/m
    * */
@@ -67,6 +116,8 @@ public:
 public:
   /// Mixer update cnt
   int updateCnt = 0;
+  /// notify the mixer thread of new input (e.g. from the joypad)
+  UNotify wake;
   UTime rcTime;
   int rcSource = 0;
   UTime updateTime;
@@ -86,6 +137,55 @@ private:
    * third index [2] two must be within -1..motors, -1 means no second motor
    * \retruns true if all is OK */
   bool limitMotorValues(int (&idx)[3], int teensys, int motors);
+  /**
+   * Set new desired velocity (from run thread) */
+  void applyVelocity(float refLinearVelocity, float refCurvature);
+  /**
+   * Newest rc command from MQTT (latest wins, old commands are discarded) */
+  UMailbox<CMixerCmd> rcBox;
+  /**
+   * Decode a trajectory, e.g. 'id=3; v=0.2 t=1.5; v=0.2 cu=2 d=0.5'
+   * \param params is the segment list
+   * \param traj is where the result is saved
+   * \returns true if at least one valid segment, and no more than MAX_SEGMENTS,
+   * a segment must end on t= or d=, and d= needs a velocity (v != 0) */
+  bool decodeTraj(const char * params, CMixerTraj & traj);
+  /**
+   * Start this trajectory (aborts any running trajectory) */
+  void trajStart(CMixerTraj & traj);
+  /**
+   * Called every control period while a trajectory is active */
+  void trajStep();
+  /**
+   * Stop a running trajectory
+   * \param state is the reason, e.g. 'done' or 'aborted' */
+  void trajEnd(const char * state);
+  /**
+   * Publish trajectory progress
+   * \param state is 'start', 'seg', 'run', 'done' or 'aborted' */
+  void trajPublish(const char * state);
+  /// Newest trajectory from MQTT
+  UMailbox<CMixerTraj> trajBox;
+  /// trajectory being executed
+  CMixerTraj traj;
+  /// buffer for a new trajectory
+  CMixerTraj trajNew;
+  /// trace ID of the newest rc command, until passed to the motor
+  int traceId = 0;
+  bool trajActive = false;
+  /// set by setVelocity() to stop trajectory
+  bool trajStopRequest = false;
+  int trajSeg = 0;
+  UTime trajSegStart;
+  UTime trajStartTime;
+  float trajSegDist = 0;
+  float trajDist = 0;
+  UTime trajLastStep;
+  UTime trajLastPublish;
+  /// step period for a trajectory (absolute deadlines)
+  ULoopTimer trajLoop;
+  float trajPublishInterval = 0.1;
+  UMqttTopic topicTraj;
   /** autonomous preference */
   float desiredCurvature = 0;
   float desiredLinVel = 0;
@@ -100,6 +200,7 @@ private:
   void toLog();
   //
   FILE * logfile = nullptr;
+  ULogStream * log = nullptr;
   bool toConsole = false;
   /// Linear velocity (m/s)
   float linVel = 0;
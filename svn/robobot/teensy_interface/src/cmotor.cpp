@@ -33,9 +33,15 @@
 #include "cmixer.h"
 #include "umqtt.h"
 #include "srobot.h"
+#include "utrace.h"
+#include "uflightrec.h"
+#include "utimeline.h"
+#include "ulooptimer.h"
 
 // create value
 CMotor motor[NUM_TEENSY_MAX];
+/// source name in the flight recorder
+static const char * flightName[] = {"motor0", "motor1", "motor2", "motor3"};
 
 
 void CMotor::setup(int teensy_number)
@@ -101,7 +107,7 @@ void CMotor::setup(int teensy_number)
     timeToRelax = strtof(ini[ini_section]["relax_sec"].c_str(), nullptr);
   }
   // mqtt
-  topicMotv = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/mot";
+  topicMotv = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/mot";
 
   // sample time from encoder module
   // sampleTime = strtof(ini["encoder0"]["interval_ms"].c_str(), nullptr) / 1000.0;
@@ -131,6 +137,7 @@ void CMotor::setup(int teensy_number)
       logfile[i] = fopen(fn.c_str(), "w");
       logfileLeadText(logfile[i], fn.c_str());
       pid[i].logPIDparams(logfile[i], false);
+      logPid[i] = logger.stream(logfile[i], fn, "%.3f %.3f %.3f %.3f %.3f %.3f %d\n");
     }
   }
   if (ini[ini_section]["log_voltage"] == "true" and logfileMv == nullptr)
@@ -143,6 +150,13 @@ void CMotor::setup(int teensy_number)
     fprintf(logfileMv, "%% 4-5 \tVoltage to motor (from Teensy) 1,2 (Volt)\n");
     fprintf(logfileMv, "%% 6-7 \tPWM to motor (+/- 2096) (from Teensy) 1,2\n");
     fprintf(logfileMv, "%% 8 \tRelax motor controller (standing still for some time)\n");
+    logMv = logger.stream(logfileMv, fn, "%.2f %.2f %.2f %.2f %d %d %d\n");
+  }
+  {
+    std::string lb = "tn=\"" + std::to_string(tn) + "\"";
+    mPeriod = metrics.histogram("motor_control_period_seconds", "Time between motor control updates", lb.c_str());
+    mLatency = metrics.histogram("motor_control_latency_seconds", "From encoder data received to motor voltage send", lb.c_str());
+    mSampleDelay = metrics.histogram("motor_sample_delay_seconds", "From encoder data received to motor control started", lb.c_str());
   }
   //printf("# cmotor:: debug 6\n");
   if (th1 == nullptr)
@@ -166,7 +180,10 @@ void CMotor::logfileLeadText(FILE * f, const char * ms)
 void CMotor::terminate()
 {
   if (th1 != nullptr)
+  { // no need to wait for more velocity data
+    mvel[tn].newData.notify();
     th1->join();
+  }
   UTime t("now");
   char d[100];
   t.getDateTimeAsString(d);
@@ -220,13 +237,10 @@ bool CMotor::decode(const char* msg, UTime & msgTime)
 
 void CMotor::toLogMv(UTime & updt)
 {
-  if (logfileMv != nullptr and not service.stop_logging)
+  if (logMv != nullptr and not service.stop_logging)
   {
-    fprintf(logfileMv, "%lu.%04ld %.2f %.2f %.2f %.2f %d %d %d\n",
-            updt.getSec(), updt.getMicrosec()/100,
-            u[0], u[1],
-            motorVoltage[0], motorVoltage[1],
-            motorPWM[0], motorPWM[1], relax);
+    logMv->log(updt, u[0], u[1], motorVoltage[0], motorVoltage[1],
+               motorPWM[0], motorPWM[1], relax);
   }
 }
 
@@ -241,7 +255,12 @@ void CMotor::run()
   int loop = 0;
   int euc;
   UTime t;
+  uint32_t velSeen = 0; // velocity notifications
+  // verify the sample time assumed by the PID controllers
+  ULoopTimer loopTimer;
+  loopTimer.setup(("motor" + std::to_string(tn)).c_str(), sampleTime);
   relaxTime.now();
+  timeline.threadName("motor");
   while (not service.stop)
   { // run an update at same rate as velocity estimate update
     euc = mvel[tn].updateCnt;
@@ -249,7 +268,14 @@ void CMotor::run()
     { // do constant rate control
       // that is every time new encoder data is available
       // new motor control values should be calculated.
+      UTimelineScope ts("motor_control");
+      timeline.flow("vel", euc, 'f');
+      loopTimer.begin();
       velUpdateCnt = euc;
+      // monotonic time of the encoder message behind this velocity
+      int64_t sampleNs = mvel[tn].sampleNs.load(std::memory_order_relaxed);
+      if (sampleNs != 0 and mSampleDelay != nullptr)
+        mSampleDelay->observe((UNotify::nowNs() - sampleNs) * 1e-9);
       if (not relax)
       { // do velocity control.
         // got new encoder data
@@ -266,16 +292,37 @@ void CMotor::run()
         // log_pose - for both motors
         for (int i = 0; i < SRobot::MAX_MOTORS; i++)
         {
-          pid[i].saveToLog(logfile[i], updTime);
+          pid[i].saveToLog(logPid[i], updTime);
         }
         // finished calculating motor voltage (into u)
         const int MSL = 100;
         char s[MSL];
         /// Note that left and right requires different sign to move forward.
         /// This may be hidden by a sign change in the motor driver firmware.
-        snprintf(s, MSL, "motv %.2f %.2f\n", u[0], u[1]);
+        int tid = traceId.exchange(0);
+        if (tid != 0)
+          // Teensy echoes the trace ID when used
+          snprintf(s, MSL, "motv %.2f %.2f %d\n", u[0], u[1], tid);
+        else
+          snprintf(s, MSL, "motv %.2f %.2f\n", u[0], u[1]);
         t.now();
         teensy[tn].send(s, true);
+        tracer.stamp(tid, UTrace::MOTOR, t);
+        // use the monotonic clock, as UTime is the logged time when replaying
+        float latency = t - updTime;
+        if (sampleNs != 0)
+          latency = (UNotify::nowNs() - sampleNs) * 1e-9;
+        mLatency->observe(latency);
+        float period = 0;
+        if (lastControlTime.valid)
+        {
+          period = t - lastControlTime;
+          mPeriod->observe(period);
+        }
+        flightrec.values(flightName[tn % 4], t, {desiredVelocity[0], desiredVelocity[1],
+                         mvel[tn].motorVel[0], mvel[tn].motorVel[1], u[0], u[1],
+                         latency * 1000, period * 1000});
+        lastControlTime = t;
         // if (mixer.shouldWheelsBeRunning())
         // { // we are driving (or should)
         //   relaxTime.now();
@@ -304,13 +351,16 @@ void CMotor::run()
         relaxing++;
       }
       toLogMv(t);
+      loopTimer.end();
     }
     loop++;
-    // sleep a little while, the sample time is
-    // determined by the encoder (longer than 2ms)
-    // actually determined by the Teensy, so on average
-    // a constant sample rate (defined in the robot.ini file)
-    usleep(500);
+    // wait for the next velocity update, the sample time is
+    // determined by the encoder data from the Teensy,
+    // so on average a constant sample rate (defined in the robot.ini file)
+    {
+      UTimelineScope ts("wait");
+      mvel[tn].newData.wait(velSeen, 0.1, 0.0005);
+    }
   }
   teensy[tn].send("motv 0 0\n", true);
 }
@@ -25,11 +25,14 @@
 #define UMOTOR_H
 
 #include <thread>
+#include <atomic>
 
 #include "sencoder.h"
 #include "utime.h"
+#include "ulogger.h"
 #include "upid.h"
 #include "srobot.h"
+#include "umetrics.h"
 
 /**
  * Class to do motor velocity control.
@@ -71,6 +74,9 @@ protected:
   //
 public:
   float desiredVelocity[SRobot::MAX_MOTORS] = {0.0};
+  /// trace ID of the command behind desiredVelocity (0 = not traced),
+  /// send with the next motor voltage, so the Teensy can echo it.
+  std::atomic<int> traceId = 0;
   // is output limited, this may be valuable for other controllers.
   bool limited[SRobot::MAX_MOTORS] = {false};
   UTime updTime; // time of last control update
@@ -96,6 +102,8 @@ private:
   // support variables
   FILE * logfile[SRobot::MAX_MOTORS] = {nullptr};
   FILE * logfileMv = nullptr;
+  ULogStream * logPid[SRobot::MAX_MOTORS] = {nullptr};
+  ULogStream * logMv = nullptr;
   float motorVoltage[SRobot::MAX_MOTORS] = {0};
   float motorVoltageOffset[SRobot::MAX_MOTORS] = {0};
   int   motorPWM[SRobot::MAX_MOTORS] = {0};
@@ -110,6 +118,11 @@ private:
   float timeToRelax = 3.5; // relax if zero speed more than these seconds
   // mqtt
   std::string topicMotv;
+  // metrics
+  UMetricHistogram * mPeriod = nullptr;
+  UMetricHistogram * mLatency = nullptr;
+  UMetricHistogram * mSampleDelay = nullptr;
+  UTime lastControlTime;
 };
 
 /**
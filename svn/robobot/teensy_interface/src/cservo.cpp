@@ -27,6 +27,8 @@
 #include "cservo.h"
 #include "steensy.h"
 #include "uservice.h"
+#include "umqtt.h"
+#include "umqttrouter.h"
 // create value
 CServo servo[NUM_TEENSY_MAX];
 
@@ -41,6 +43,16 @@ void CServo::setup(int teensyNumber)
     ini[ini_section]["log"] = "true";
     ini[ini_section]["print"] = "true";
   }
+  if (not ini[ini_section].has("cmd_max_age_ms"))
+  { // servo commands (cmd/T0/servo) older than this are not used (0 = no limit)
+    ini[ini_section]["cmd_max_age_ms"] = "500";
+  }
+  float maxAge = strtof(ini[ini_section]["cmd_max_age_ms"].c_str(), nullptr) / 1000.0;
+  for (int i = 0; i < MAX_SERVO_CNT; i++)
+    servoBox[i].setup(("servo" + std::to_string(i + 1)).c_str(), maxAge);
+  router.add(mqtt.root + "cmd/T" + std::to_string(tn) + "/servo", "servo",
+    [this](const char *, const char *, const char * payload, UTime & msgTime)
+    { return decodeCmd(payload, msgTime); });
   // use values and subscribe to source data
   // like teensy[0].send("sub pose 4\n");
   std::string s = "sub svo " + ini[ini_section]["interval_ms"] + "\n";
@@ -58,6 +70,48 @@ void CServo::setup(int teensyNumber)
     fprintf(logfile, "%% 3 \tRequested position\n");
     fprintf(logfile, "%% 4,5,6 \tEnabled, position, velocity\n");
   }
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+bool CServo::decodeCmd(const char * payload, UTime & msgTime)
+{ // servo index, position and velocity
+  UTime cmdTime = msgTime;
+  const char * p1 = getSenderTime(payload, cmdTime);
+  char * p2;
+  int idx = strtol(p1, &p2, 10);
+  if (p2 == p1 or idx < 1 or idx > MAX_SERVO_CNT)
+    // not for a mailbox, send to the Teensy as is
+    return false;
+  CServoCmd cmd;
+  cmd.position = strtol(p2, &p2, 10);
+  cmd.velocity = strtol(p2, &p2, 10);
+  servoBox[idx - 1].put(cmd, cmdTime);
+  wake.notify();
+  return true;
+}
+
+void CServo::run()
+{
+  uint32_t wakeSeen = 0;
+  while (not service.stop)
+  {
+    wake.wait(wakeSeen, 0.1);
+    for (int i = 0; i < MAX_SERVO_CNT; i++)
+    {
+      CServoCmd cmd;
+      UTime cmdTime;
+      if (servoBox[i].take(cmd, cmdTime))
+      { // newest valid command for this servo
+        const int MSL = 100;
+        char s[MSL];
+        snprintf(s, MSL, "servo %d %d %d\n", i + 1, cmd.position, cmd.velocity);
+        teensy[tn].send(s);
+        servo_ref[i] = cmd.position;
+        toLog(i);
+      }
+    }
+  }
 }
 
 void CServo::setServo(int servo, bool enabled, int position, int velocity)
@@ -81,6 +135,12 @@ void CServo::setServo(int servo, bool enabled, int position, int velocity)
 
 void CServo::terminate()
 {
+  if (th1 != nullptr)
+  {
+    wake.notify();
+    th1->join();
+    th1 = nullptr;
+  }
   if (logfile != nullptr and not service.stop_logging)
   {
     fclose(logfile);
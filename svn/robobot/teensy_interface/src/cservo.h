@@ -24,14 +24,21 @@
 #ifndef CSERVO_H
 #define CSERVO_H
 
+#include <thread>
+
 #include "utime.h"
 #include "steensy.h"
+#include "umailbox.h"
+#include "unotify.h"
 
 using namespace std;
 
 /**
  * Class to control the servos through the Teensy connection.
  * The servo position, as far as known by the Teensy, is also available.
+ * Servo commands from MQTT (cmd/T0/servo) go to a mailbox for each servo
+ * (latest wins, too old is discarded), and a thread sends the newest
+ * valid command to the Teensy.
  * */
 class CServo
 {
@@ -49,9 +56,18 @@ public:
   /** decode an unpacked incoming messages
    * \returns true if the message us used */
   bool decode(const char * msg, UTime & msgTime);
+  /**
+   * Servo command from MQTT, payload is '[ts:<sender time>] servo position velocity'
+   * \param payload is the command parameters
+   * \param msgTime is the arrival time (command time, if no sender time)
+   * \returns false if not a servo command for the mailbox (then passed on as is) */
+  bool decodeCmd(const char * payload, UTime & msgTime);
   /**
    * terminate */
   void terminate();
+  /**
+   * Send newest valid servo commands */
+  void run();
 
 public:
   int tn = 0;
@@ -64,6 +80,21 @@ public:
   int servo_velocity[MAX_SERVO_CNT];
 
 private:
+  static void runObj(CServo * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /// servo command from MQTT
+  class CServoCmd
+  {
+  public:
+    int position = 0;
+    int velocity = 0;
+  };
+  UMailbox<CServoCmd> servoBox[MAX_SERVO_CNT];
+  UNotify wake;
+  std::thread * th1 = nullptr;
   std::string ini_section;
   void toLog(int i);
   // debug print to console
@@ -34,18 +34,28 @@
 #include "cmixer.h"
 #include "sgpiod.h"
 #include "utime.h"
+#include "ureplay.h"
+#include "ulooptimer.h"
 
 void loop()
 { // turn on last LED (14) as green to show that we are ready
+  if (replay.active)
+  { // no Teensy (and no LEDs), wait for replay to finish
+    while (not service.stopNowRequest)
+      usleep(30000);
+    return;
+  }
   teensy[0].send("leds 14 0 45 0\n", true);
   int g = 5;
   int dg = 10;
   const int MSL = 50;
   char s[MSL];
   UTime t("now");
+  ULoopTimer loopTimer;
+  loopTimer.setup("main", 0.03);
   while (not service.stopNowRequest)
   { // no action here, action can be handled over MQTT
-    usleep(30000);
+    loopTimer.wait();
     if (t.getTimePassed() > 0.1)
     {
       t.now();
@@ -63,25 +73,18 @@ void loop()
 
 
 int main (int argc, char **argv)
-{ // is the process running already
-  int a = service.isThisProcessRunning("teensy_interfac");
-  if (a == 1)
-  { // only me is running, so continue.
-    // prepare all modules and start data flow
-    // but also handle command-line options
-    service.setup(argc, argv);
-    //
-    if (not service.theEnd)
-    { // all set to go
-      loop();
-    }
-    // close all logfiles etc.
-    service.terminate();
-    printf("# ---- Teensy_interface has ended (nicely) ----\r\n");
+{ // prepare all modules and start data flow
+  // but also handle command-line options
+  // (stops if another teensy_interface uses the robot hardware)
+  service.setup(argc, argv);
+  //
+  if (not service.theEnd)
+  { // all set to go
+    loop();
   }
-  else
-    printf("# ---- Teensy_interface is running already (stop with 'pkill teensy_interfac' ----\r\n");
-
+  // close all logfiles etc.
+  service.terminate();
+  printf("# ---- Teensy_interface has ended (nicely) ----\r\n");
   exit(0);
 }
 
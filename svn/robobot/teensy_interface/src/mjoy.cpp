@@ -199,6 +199,7 @@ void MJoy::run()
         //   joyControlCrane();
         // }
         updateCnt++;
+        mixer.wake.notify();
       }
       toLog();
     }
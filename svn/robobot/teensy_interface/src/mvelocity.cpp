@@ -31,8 +31,10 @@
 #include "sencoder.h"
 #include "steensy.h"
 #include "uservice.h"
+#include "ushm.h"
 #include "cmixer.h"
 #include "umqtt.h"
+#include "utimeline.h"
 
 // create value
 MVelocity mvel[NUM_TEENSY_MAX];
@@ -51,7 +53,7 @@ void MVelocity::setup(int teensyNumber)
     ini[ini_section]["print"] = "false";
   }
   // Mqtt topic names
-  topicVel = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/mvel";
+  topicVel.setup(mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/mvel");
   // get values from ini-file
   encTickPerRev = strtol(ini[ini_section]["encTickPerRev"].c_str(), nullptr, 10);
   radPerTick = 2.0 * M_PI  / encTickPerRev;
@@ -78,6 +80,7 @@ void MVelocity::setup(int teensyNumber)
     fprintf(logfile, "%% 1 \tTime (sec)\n");
     fprintf(logfile, "%% 2-3 \tVelocity motor 1..2 (m/s or rad/s) m/s if use Teensy, else rad/sec motor vel, see robot.ini\n");
     fprintf(logfile, "%% 4-5 \tUpdate number (encoder, velocity) - mostly debug\n");
+    log = logger.stream(logfile, fn, "%.4f %.4f %d %d\n");
   }
   if (th1 == nullptr)
     th1 = new std::thread(runObj, this);
@@ -87,7 +90,8 @@ void MVelocity::setup(int teensyNumber)
 void MVelocity::terminate()
 { // wait for thread to finish
   if (th1 != nullptr)
-  {
+  { // no need to wait for more encoder data
+    encoder[tn].newData.notify();
     th1->join();
     th1 = nullptr;
   }
@@ -107,6 +111,8 @@ void MVelocity::run()
   int encup; // pos update
   int encuv; // velocity update
   bool updated = false;
+  uint32_t encSeen = 0; // encoder notifications
+  timeline.threadName("velocity");
   while (not service.stop)
   { // there is an update - encoder or velocity
     encup = encoder[tn].updatePosCnt;
@@ -114,6 +120,8 @@ void MVelocity::run()
     if (encup != oldEncUpdate and not useTeensyVelEstimate)
     { // new encoder update - this actually calculates
       // the motor velocity, and not the wheel velocity
+      UTimelineScope ts("velocity");
+      timeline.flow("enc", encup, 'f');
       int64_t enc[SRobot::MAX_MOTORS]; // shorthand value
       for (int i = 0; i < SRobot::MAX_MOTORS; i++)
       { // get value
@@ -125,6 +133,7 @@ void MVelocity::run()
         }
       }
       t = encoder[tn].encTime;
+      sampleNs.store(encoder[tn].rxNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
       float dtt = 1.0; // in seconds - for turnrate
       float dt[SRobot::MAX_MOTORS];
       int64_t de[SRobot::MAX_MOTORS];
@@ -162,6 +171,8 @@ void MVelocity::run()
         // maybe fixed rate would be better?
         updateCnt++;
         velTime.now();
+        // to motor controller
+        timeline.flow("vel", updateCnt, 's');
       }
       oldEncUpdate = encup;
     }
@@ -172,6 +183,7 @@ void MVelocity::run()
         motorVel[i] = encoder[tn].vel[i] * motorScale[i]; // m/s
       }
       velTime = encoder[tn].encVelTime;
+      sampleNs.store(encoder[tn].rxNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
       updateCnt++;
       oldEncVelUpdate = encuv;
       updated = true;
@@ -182,7 +194,10 @@ void MVelocity::run()
 //              ini[ini_section]["useTeensyVel"].c_str());
     if (updated)
     { // finished making a new pose
-      if (ini["mqtt"]["use"] == "true")
+      // to motor controller
+      newData.notify();
+      shm.update(USHM_VEL, tn, velTime, motorVel, SRobot::MAX_MOTORS);
+      if (mqtt.use)
       {
         const int MSL = 100;
         char s[MSL];
@@ -190,13 +205,17 @@ void MVelocity::run()
                 motorVel[0], motorVel[1]);
         UTime t("now");
         // topic robobot/drive/T0/mvel
-        mqtt.publish(topicVel.c_str(), s, t);
+        mqtt.publish(topicVel, s, t);
       }
       toLog();
       updated = false;
     }
-    // just wait a bit (1ms)
-    usleep(1000);
+    // wait for new encoder data
+    // (timeout to check for stop)
+    {
+      UTimelineScope ts("wait");
+      encoder[tn].newData.wait(encSeen, 0.1, 0.001);
+    }
     loop++;
   }
   if (logfile != nullptr)
@@ -210,12 +229,9 @@ void MVelocity::toLog()
 {
   if (not service.stop)
   {
-    if (logfile != nullptr and not service.stop_logging)
+    if (log != nullptr and not service.stop_logging)
     { // log_pose
-      fprintf(logfile, "%lu.%04ld %.4f %.4f %d %d\n",
-              velTime.getSec(), velTime.getMicrosec()/100,
-              motorVel[0], motorVel[1], oldEncUpdate, oldEncVelUpdate
-              );
+      log->log(velTime, motorVel[0], motorVel[1], oldEncUpdate, oldEncVelUpdate);
     }
     if (toConsole)
     { // print_pose
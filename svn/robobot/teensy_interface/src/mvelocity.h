@@ -26,7 +26,11 @@
 
 #include "sencoder.h"
 #include "utime.h"
+#include "ulogger.h"
+#include "umqtt.h"
+#include "unotify.h"
 #include "thread"
+#include <atomic>
 
 using namespace std;
 
@@ -71,11 +75,16 @@ public:
   int updateCnt = 0;
   int oldEncUpdate = 0;
   int oldEncVelUpdate = 0;
+  /// notified on new motor velocity (updateCnt)
+  UNotify newData;
+  /// monotonic time (ns) of the encoder message used for the newest velocity
+  /// (for timing only, so relaxed order)
+  std::atomic<int64_t> sampleNs = 0;
 
 private:
   /// private stuff
   std::string ini_section;
-  std::string topicVel;
+  UMqttTopic topicVel;
 
   static void runObj(MVelocity * obj)
   { // called, when thread is started
@@ -94,6 +103,7 @@ private:
   bool toConsole = false;
   /// Logfile - most details
   FILE * logfile = nullptr;
+  ULogStream * log = nullptr;
   std::thread * th1;
   // source data iteration
   int encoderUpdateCnt = 0;
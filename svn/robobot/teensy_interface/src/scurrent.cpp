@@ -29,6 +29,7 @@
 #include "scurrent.h"
 #include "steensy.h"
 #include "uservice.h"
+#include "ushm.h"
 #include "mvelocity.h"
 #include "cmixer.h"
 #include "umqtt.h"
@@ -72,6 +73,7 @@ void SCurrent::setup(int teensy_number)
     fprintf(logfile, "%% 2-5 \tVoltage current (from Teensy) 1,2,(3,4) (Amps)\n");
     fprintf(logfile, "%% 6 \tBoard current (Amps) (low pass filtered)\n");
     fprintf(logfile, "%% 7 \tBoard current (Amps) (not filtered)\n");
+    log = logger.stream(logfile, fn, "%.3f %.3f %.3f %.3f %.2f %.2f\n");
   }
 }
 
@@ -91,6 +93,7 @@ bool SCurrent::decode(const char* msg, UTime & msgTime)
     p1 += 4;
     for (int i = 0; i < 5; i++)
       current[i] = strtof(p1, (char**)&p1);
+    toShm(msgTime);
     // save to log_encoder_pose
     toLog(msgTime);
   }
@@ -98,6 +101,7 @@ bool SCurrent::decode(const char* msg, UTime & msgTime)
   { // motor current
     p1 += 4;
     supplyCurrent = strtof(p1, (char**)&p1);
+    toShm(msgTime);
     // save to log_encoder_pose
     toLog(msgTime);
   }
@@ -106,13 +110,20 @@ bool SCurrent::decode(const char* msg, UTime & msgTime)
   return used;
 }
 
+void SCurrent::toShm(UTime & updt)
+{ // motor currents, system current and supply current
+  float v[6];
+  for (int i = 0; i < 5; i++)
+    v[i] = current[i];
+  v[5] = supplyCurrent;
+  shm.update(USHM_CURRENT, tn, updt, v, 6);
+}
+
 void SCurrent::toLog(UTime & updt)
 {
-  if (logfile != nullptr and not service.stop_logging)
+  if (log != nullptr and not service.stop_logging)
   {
-    fprintf(logfile, "%lu.%04ld %.3f %.3f %.3f %.3f %.2f %.2f\n",
-            updt.getSec(), updt.getMicrosec()/100,
-            current[0], current[1], current[2], current[3], robot[tn].supplyCurrent, supplyCurrent);
+    log->log(updt, current[0], current[1], current[2], current[3], robot[tn].supplyCurrent, supplyCurrent);
   }
 }
 
@@ -26,6 +26,7 @@
 
 #include "sencoder.h"
 #include "utime.h"
+#include "ulogger.h"
 
 /**
  * Class is to monitor motor current.
@@ -46,6 +47,9 @@ protected:
   /**
    * Save motor values for all motors */
   void toLog(UTime & updt);
+  /**
+   * Save currents to the shared memory state table */
+  void toShm(UTime & updt);
   //
 public:
   UTime updTime; // time of last control update
@@ -61,6 +65,7 @@ private:
   void logfileLeadText(FILE * f, const char * ms);
   // support variables
   FILE * logfile = nullptr;
+  ULogStream * log = nullptr;
   bool toConsole;
   // mqtt
   std::string topicMotv;
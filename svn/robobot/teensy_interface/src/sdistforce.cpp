@@ -32,6 +32,7 @@
 #include "sdistforce.h"
 #include "steensy.h"
 #include "uservice.h"
+#include "ushm.h"
 #include "umqtt.h"
 // create value
 SDistForce distforce[NUM_TEENSY_MAX];
@@ -50,14 +51,15 @@ void SDistForce::setup(int teensy_number)
     ini[ini_section]["force"] = "true";
   }
   // reset encoder and pose
-  topicDist = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/dist";
-  topicForce = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/force";
+  topicDist = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/dist";
+  topicForce = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/force";
   // use values and subscribe to source data
   // subscripe to ir distance that include raw AD values too
   std::string s = "sub ird " + ini[ini_section]["interval_ird_ms"] + "\n";
   teensy[tn].send(s.c_str());
   /// other debug feature
   toConsole = ini[ini_section]["print"] == "true";
+  useForce = ini[ini_section]["force"] == "true";
   if (ini[ini_section]["log_dist"] == "true" and logfileDist == nullptr)
   { // open logfile
     std::string fn = service.logPath + "log_t" + std::to_string(tn) + "_dist.txt";
@@ -67,6 +69,7 @@ void SDistForce::setup(int teensy_number)
     fprintf(logfileDist, "%% 2-3 \tDistance sensor 1 and 2 (meter)\n");
     fprintf(logfileDist, "%% 4-5 \tRaw AD value for sensor 1 and 2\n");
     fprintf(logfileDist, "%% 6 \tSensor power on (1=on)\n");
+    logDist = logger.stream(logfileDist, fn, "%g %g %u %u %d\n");
   }
   if (ini[ini_section]["log_force"] == "true" and logfileForce == nullptr)
   { // open logfile
@@ -76,6 +79,7 @@ void SDistForce::setup(int teensy_number)
     fprintf(logfileForce, "%% 1 \tTime (sec)\n");
     fprintf(logfileForce, "%% 2-3 \testimated force (1 and 2)\n");
     fprintf(logfileForce, "%% 4-5 \tRaw AD values (1 and 2)\n");
+    logForce = logger.stream(logfileForce, fn, "%g %g %u %u\n");
   }
 }
 
@@ -137,10 +141,11 @@ bool SDistForce::decode(const char* msg, UTime & msgTime)
     // forceAD[1] = strtoll(p1, (char**)&p1, 10);
     // sensorOn = strtoll(p1, (char**)&p1, 10);
     //
-    if (ini[ini_section]["force"] == "true")
+    if (useForce)
       calculateForce();
     // notify users of a new update
     updateCnt++;
+    shm.update(USHM_DIST, tn, msgTime, distance, 2);
     // save to log
     logTime = updTime;
     toLogDist();
@@ -156,13 +161,11 @@ void SDistForce::toLogDist()
 {
   if (not service.stop)
   {
-    if (logfileDist != nullptr and not service.stop_logging)
+    if (logDist != nullptr and not service.stop_logging)
     {
-      fprintf(logfileDist,"%lu.%04ld %g %g %u %u %d\n",
-              logTime.getSec(), logTime.getMicrosec()/100,
-              distance[0], distance[1], forceAD[0], forceAD[1], sensorOn);
+      logDist->log(logTime, distance[0], distance[1], forceAD[0], forceAD[1], sensorOn);
     }
-    if (toConsole and not (ini["mqtt"]["use"] == "true"))
+    if (toConsole and not mqtt.use)
     {
       printf("%lu.%04ld %g %g  %u %u %d\n",
               logTime.getSec(), logTime.getMicrosec()/100,
@@ -175,13 +178,11 @@ void SDistForce::toLogForce()
 {
   if (not service.stop)
   {
-    if (logfileForce != nullptr and not service.stop_logging)
+    if (logForce != nullptr and not service.stop_logging)
     {
-      fprintf(logfileForce,"%lu.%04ld %g %g %u %u\n",
-              logTime.getSec(), logTime.getMicrosec()/100,
-              force[0], force[1], forceAD[0], forceAD[1]);
+      logForce->log(logTime, force[0], force[1], forceAD[0], forceAD[1]);
     }
-    if (toConsole and (ini["mqtt"]["use"] == "true"))
+    if (toConsole and mqtt.use)
     {
       printf("%lu.%04ld %g %g %u %u\n",
               logTime.getSec(), logTime.getMicrosec()/100,
@@ -34,6 +34,7 @@
 #include <math.h>
 
 #include "utime.h"
+#include "ulogger.h"
 #include "steensy.h"
 
 using namespace std;
@@ -76,8 +77,12 @@ private:
   void toLogDist();
   void toLogForce();
   bool toConsole = false;
+  /// calculate force from AD value (from robot.ini)
+  bool useForce = false;
   FILE * logfileDist = nullptr;
   FILE * logfileForce = nullptr;
+  ULogStream * logDist = nullptr;
+  ULogStream * logForce = nullptr;
   //   std::condition_variable_any nd; // new data service
   // MQTT
   /// topic string for encoder position
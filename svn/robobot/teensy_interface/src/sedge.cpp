@@ -39,6 +39,7 @@
 #include "steensy.h"
 #include "sedge.h"
 #include "uservice.h"
+#include "ushm.h"
 #include "umqtt.h"
 
 // create the class with received info
@@ -64,7 +65,7 @@ void SEdge::setup(int teensyNumber)
   ss = "sub livn " + ini[ini_section]["interval_livn_ms"];
   teensy[tn].send(ss.c_str());
   // MQTT topic name
-  topic = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/";
+  topic = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/";
   // logfile
   if (ini[ini_section]["log"] == "true" and logfileAD == nullptr)
   { // open logfile
@@ -73,6 +74,7 @@ void SEdge::setup(int teensyNumber)
     fprintf(logfileAD, "%% Edge\n");
     fprintf(logfileAD, "%% 1 \tTime (sec)\n");
     fprintf(logfileAD, "%% 2-10 \tsensor AD value (0..4196), sensor 0 is left, AD=0 is no reflection\n");
+    logAD = logger.stream(logfileAD, fn, "%d %d %d %d %d %d %d %d\n", 3);
   }
   if (ini[ini_section]["log"] == "true" and logfileN == nullptr)
   { // open logfile
@@ -81,6 +83,7 @@ void SEdge::setup(int teensyNumber)
     fprintf(logfileN, "%% Edge\n");
     fprintf(logfileN, "%% 1 \tTime (sec)\n");
     fprintf(logfileN, "%% 2-10 \tsensor notmalized value (0..1000), sensor 0 is left, 0 is no reflection, 1000 is calibrated white\n");
+    logN = logger.stream(logfileN, fn, "%d %d %d %d %d %d %d %d\n", 3);
   }
 }
 
@@ -117,6 +120,7 @@ bool SEdge::decode(const char* msg, UTime & msgTime)
     {
       ad[i] = strtol(p1, (char **)&p1, 10);
     }
+    shm.update(USHM_EDGE, tn, msgTime, ad, 8);
     toLogEnc();
   }
   else if (strncmp(p1, "livn ", 5) == 0)
@@ -128,6 +132,7 @@ bool SEdge::decode(const char* msg, UTime & msgTime)
       adn[i] = strtol(p1, (char **)&p1, 10);
     }
     updTime = msgTime;
+    shm.update(USHM_EDGEN, tn, msgTime, adn, 8);
     toLogNormalized();
   }
   else
@@ -139,11 +144,9 @@ void SEdge::toLogEnc()
 { // data is already locked
   if (service.stop)
     return;
-  if (logfileAD != nullptr and not service.stop_logging)
+  if (logAD != nullptr and not service.stop_logging)
   {
-    fprintf(logfileAD, "%lu.%03ld %d %d %d %d %d %d %d %d\n",
-            updTime.getSec(), updTime.getMillisec(),
-            ad[0], ad[1], ad[2], ad[3], ad[4], ad[5], ad[6], ad[7]);
+    logAD->log(updTime, ad[0], ad[1], ad[2], ad[3], ad[4], ad[5], ad[6], ad[7]);
   }
   if (toConsole)
     printf("%lu.%03ld %d %d %d %d %d %d %d %d\n",
@@ -155,11 +158,9 @@ void SEdge::toLogNormalized()
 { // data is already locked
   if (service.stop)
     return;
-  if (logfileN != nullptr and not service.stop_logging)
+  if (logN != nullptr and not service.stop_logging)
   {
-    fprintf(logfileN, "%lu.%03ld %d %d %d %d %d %d %d %d\n",
-            updTime.getSec(), updTime.getMillisec(),
-            adn[0], adn[1], adn[2], adn[3], adn[4], adn[5], adn[6], adn[7]);
+    logN->log(updTime, adn[0], adn[1], adn[2], adn[3], adn[4], adn[5], adn[6], adn[7]);
   }
   if (toConsole)
     printf("%lu.%03ld %d %d %d %d %d %d %d %d\n",
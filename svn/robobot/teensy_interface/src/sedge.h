@@ -24,6 +24,7 @@
 #pragma once
 
 #include "steensy.h"
+#include "ulogger.h"
 
 using namespace std;
 
@@ -66,6 +67,8 @@ private:
   bool toConsole = false;
   FILE * logfileAD = nullptr;
   FILE * logfileN = nullptr;
+  ULogStream * logAD = nullptr;
+  ULogStream * logN = nullptr;
   /// MQTT
   std::string topic;
 
@@ -27,7 +27,9 @@
 #include "sencoder.h"
 #include "steensy.h"
 #include "uservice.h"
+#include "ushm.h"
 #include "umqtt.h"
+#include "utimeline.h"
 // create value
 SEncoder encoder[NUM_TEENSY_MAX];
 
@@ -47,9 +49,9 @@ void SEncoder::setup(int teensy_number)
   }
   // reset encoder and pose
   teensy[tn].send("enc0\n");
-  topicEnc = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/enc";
-  topicEncVel = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/vel";
-  topicPose = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/pose";
+  topicEnc = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/enc";
+  topicEncVel = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/vel";
+  topicPose = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/pose";
   // use values and subscribe to source data
   /// subscripe to encoder count data
   std::string s = "sub pose " + ini[ini_section]["interval_pose_ms"] + "\n";
@@ -82,6 +84,7 @@ void SEncoder::setup(int teensy_number)
     fprintf(logfileEnc, "%% 4-5 \tencoder velocity v1, v2 (rad/sec for motor before gear)\n");
     fprintf(logfileEnc, "%% 6 \tencoder posion update count\n");
     fprintf(logfileEnc, "%% 7 \tencoder velocity update count\n");
+    logEnc = logger.stream(logfileEnc, fn, "%lu %lu %g %g %d %d\n");
   }
   if (ini[ini_section]["log_pose"] == "true" and logfilePose == nullptr)
   { // open logfile
@@ -92,6 +95,7 @@ void SEncoder::setup(int teensy_number)
     fprintf(logfilePose, "%% 2,3 \tX, Y position (m)\n");
     fprintf(logfilePose, "%% 4 \tHeading in radians (m)\n");
     fprintf(logfilePose, "%% 5 \tTilt angle, if calculated (rad)\n");
+    logPose = logger.stream(logfilePose, fn, "%.3f %.3f %.4f %.4f\n");
   }
   // allow Teensy to process subscriptions
   usleep(23000);
@@ -125,6 +129,11 @@ bool SEncoder::decode(const char* msg, UTime & msgTime)
     enc[1] = strtoll(p1, (char**)&p1, 10);
     // notify users of a new update
     updatePosCnt++;
+    // to velocity estimate (MVelocity)
+    timeline.flow("enc", updatePosCnt, 's');
+    rxNs.store(UNotify::nowNs(), std::memory_order_relaxed);
+    newData.notify();
+    shm.update(USHM_ENC, tn, msgTime, enc, 2);
     // save to log_encoder_pose
     logTime = msgTime;
     toLogEnc();
@@ -144,6 +153,8 @@ bool SEncoder::decode(const char* msg, UTime & msgTime)
     vel[1] = strtof(p1, (char**)&p1);
     // notify users of a new update
     updateVelCnt++;
+    rxNs.store(UNotify::nowNs(), std::memory_order_relaxed);
+    newData.notify();
     // logged in the velocity module
     // after potential additional gear
   }
@@ -159,6 +170,7 @@ bool SEncoder::decode(const char* msg, UTime & msgTime)
       pose[i] = strtof(p1, (char**)&p1);
     // notify users of a new update
     updatePoseCnt++;
+    shm.update(USHM_POSE, tn, msgTime, pose, 4);
     // save to log_encoder_pose
     logTime = msgTime;
     toLogPose();
@@ -172,12 +184,9 @@ void SEncoder::toLogEnc()
 {
   if (not service.stop)
   {
-    if (logfileEnc != nullptr and not service.stop_logging)
+    if (logEnc != nullptr and not service.stop_logging)
     {
-      fprintf(logfileEnc,"%lu.%04ld %lu %lu %g %g %d %d\n",
-              logTime.getSec(), logTime.getMicrosec()/100,
-              (unsigned long int)enc[0], (unsigned long int)enc[1],
-              vel[0], vel[1], updatePosCnt, updateVelCnt);
+      logEnc->log(logTime, enc[0], enc[1], vel[0], vel[1], updatePosCnt, updateVelCnt);
     }
     if (toConsole)
     {
@@ -193,11 +202,9 @@ void SEncoder::toLogPose()
 {
   if (not service.stop)
   {
-    if (logfilePose != nullptr and not service.stop_logging)
+    if (logPose != nullptr and not service.stop_logging)
     {
-      fprintf(logfilePose,"%lu.%04ld %.3f %.3f %.4f %.4f\n",
-              logTime.getSec(), logTime.getMicrosec()/100,
-              pose[0], pose[1], pose[2], pose[3]);
+      logPose->log(logTime, pose[0], pose[1], pose[2], pose[3]);
     }
     if (toConsole)
     {
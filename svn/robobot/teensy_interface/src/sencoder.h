@@ -30,13 +30,16 @@
 #include <sys/types.h>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <math.h>
 
 #include "utime.h"
+#include "ulogger.h"
 #include "steensy.h"
+#include "unotify.h"
 #include "srobot.h"
 
 using namespace std;
@@ -67,6 +70,11 @@ public:
 //   mutex dataLock; // ensure consistency
   int updatePosCnt = 0;
   int updateVelCnt = 0;
+  /// notified on new encoder position or velocity
+  UNotify newData;
+  /// monotonic time (ns) of the newest position or velocity message
+  /// (for timing only, so relaxed order)
+  std::atomic<int64_t> rxNs = 0;
   int updatePoseCnt = 0;
   UTime encTime, encTimeLast;
   UTime encVelTime;
@@ -85,6 +93,8 @@ private:
   bool toConsole = false;
   FILE * logfileEnc = nullptr;
   FILE * logfilePose = nullptr;
+  ULogStream * logEnc = nullptr;
+  ULogStream * logPose = nullptr;
   //   std::condition_variable_any nd; // new data service
   // MQTT
   /// topic string for encoder position
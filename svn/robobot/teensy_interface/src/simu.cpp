@@ -28,6 +28,7 @@
 #include "simu.h"
 #include "steensy.h"
 #include "uservice.h"
+#include "ushm.h"
 #include <stdlib.h>
 #include "umqtt.h"
 // create value
@@ -80,12 +81,14 @@ void SImu::setup(int teensyNumber)
     fprintf(logfileGyro[0], "%% 1 \tTime (sec)\n");
     fprintf(logfileGyro[0], "%% 2-4 \tGyro (x,y,z)\n");
     fprintf(logfileGyro[0], "%% Gyro offset %g %g %g\n", gyroOffset[0][0], gyroOffset[0][1], gyroOffset[0][2]);
+    logGyro[0] = logger.stream(logfileGyro[0], fn, "%.4f %.4f %.4f\n");
     //
     fn = service.logPath + "log_t" + to_string(tn) + "_acc_1.txt";
     logfileAcc[0] = fopen(fn.c_str(), "w");
     fprintf(logfileAcc[0], "%% Accelerometer logfile (IMU1)\n");
     fprintf(logfileAcc[0], "%% 1 \tTime (sec)\n");
     fprintf(logfileAcc[0], "%% 2-4 \tAccelerometer (x,y,z)\n");
+    logAcc[0] = logger.stream(logfileAcc[0], fn, "%.4f %.4f %.4f\n");
   }
   // other IMU
   if (ini[ini2]["use"] == "true")
@@ -109,12 +112,14 @@ void SImu::setup(int teensyNumber)
       fprintf(logfileGyro[1], "%% 1 \tTime (sec)\n");
       fprintf(logfileGyro[1], "%% 2-4 \tGyro (x,y,z)\n");
       fprintf(logfileGyro[1], "%% Gyro offset %g %g %g\n", gyroOffset[1][0], gyroOffset[1][1], gyroOffset[1][2]);
+      logGyro[1] = logger.stream(logfileGyro[1], fn, "%.4f %.4f %.4f\n");
       //
       fn = service.logPath + "log_t" + to_string(tn) + "_acc_2.txt";
       logfileAcc[1] = fopen(fn.c_str(), "w");
       fprintf(logfileAcc[1], "%% Accelerometer logfile (IMU2)\n");
       fprintf(logfileAcc[1], "%% 1 \tTime (sec)\n");
       fprintf(logfileAcc[1], "%% 2-4 \tAccelerometer (x,y,z)\n");
+      logAcc[1] = logger.stream(logfileAcc[1], fn, "%.4f %.4f %.4f\n");
     }
   }
 }
@@ -155,6 +160,7 @@ bool SImu::decode(const char* msg, UTime & msgTime)
     for (int i = 0; i < 3; i++)
       acc[m][i] = a[i];
     updateAccCnt[m]++;
+    shm.update(USHM_ACC, tn, msgTime, acc[m], 3);
     // save to log
     toLog(true, m);
   }
@@ -177,6 +183,7 @@ bool SImu::decode(const char* msg, UTime & msgTime)
     }
     // notify users of a new update
     updateGyroCnt[m]++;
+    shm.update(USHM_GYRO, tn, msgTime, gyro[m], 3);
      // save to log (if requested)
     toLog(false, m);
     //
@@ -216,10 +223,9 @@ void SImu::toLog(bool accChanged, int imuIdx)
   int m = imuIdx;
   if (accChanged)
   { // accelerometer
-    if (logfileAcc[m] != nullptr and not service.stop_logging)
+    if (logAcc[m] != nullptr and not service.stop_logging)
     {
-      fprintf(logfileAcc[m],"%lu.%04ld %.4f %.4f %.4f\n", updTimeAcc[m].getSec(), updTimeAcc[m].getMicrosec()/100,
-              acc[m][0], acc[m][1], acc[m][2]);
+      logAcc[m]->log(updTimeAcc[m], acc[m][0], acc[m][1], acc[m][2]);
     }
     if (toConsoleAcc[m])
     {
@@ -229,10 +235,9 @@ void SImu::toLog(bool accChanged, int imuIdx)
   }
   else
   { // gyro data
-    if (logfileGyro[m] != nullptr and not service.stop_logging)
+    if (logGyro[m] != nullptr and not service.stop_logging)
     {
-      fprintf(logfileGyro[m],"%lu.%04ld %.4f %.4f %.4f\n", updTimeGyro[m].getSec(), updTimeGyro[m].getMicrosec()/100,
-              gyro[m][0], gyro[m][1], gyro[m][2]);
+      logGyro[m]->log(updTimeGyro[m], gyro[m][0], gyro[m][1], gyro[m][2]);
     }
     if (toConsoleGyro[m])
     {
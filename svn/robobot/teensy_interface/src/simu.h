@@ -25,6 +25,7 @@
 #define SIMU_H
 
 #include "utime.h"
+#include "ulogger.h"
 #include "steensy.h"
 
 using namespace std;
@@ -70,6 +71,8 @@ private:
   //
   FILE * logfileGyro[2] = {nullptr};
   FILE * logfileAcc[2] = {nullptr};
+  ULogStream * logGyro[2] = {nullptr};
+  ULogStream * logAcc[2] = {nullptr};
   bool toConsoleAcc[2] = {false};
   bool toConsoleGyro[2] = {false};
   // calibration values for calibration
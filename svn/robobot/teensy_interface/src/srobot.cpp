@@ -60,13 +60,17 @@ void SRobot::setup(int teensyNumber)
     ini[ini_section]["batteryCalibrate"] = "1.0";
   }
   toConsole = ini[ini_section]["print"] == "true";
+  {
+    std::string lb = "tn=\"" + std::to_string(tn) + "\"";
+    dataLock.setup("robot_data", lb.c_str());
+  }
   batteryUsedWh = strtod(ini[ini_section]["batteryUsedWh"].c_str(), nullptr);
   batteryScale = strtod(ini[ini_section]["batteryCalibrate"].c_str(), nullptr);
   string ss = "batcal " + to_string(batteryScale) + "\n";
   teensy[tn].send(ss.c_str());
   teensy[tn].send("sub hbt 500\n");
   // topic names
-  topicHbt = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/hbt";
+  topicHbt = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/hbt";
   if (ini[ini_section]["log"] == "true" and logfile == nullptr)
   { // open logfile
     std::string fn = service.logPath + "log_t" + std::to_string(tn) + "_hbt.txt";
@@ -73,7 +73,7 @@ public:
   /// system time at this Teensy time
   UTime hbtTime;
   /// mutex should be used to get consistent values
-  std::mutex dataLock;
+  UMutex dataLock;
 private:
   bool findIPs();
   bool updateIPlist();
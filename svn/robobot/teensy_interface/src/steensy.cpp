@@ -33,16 +33,25 @@
 #include <math.h>
 #include <string.h>
 #include <termios.h>
+#include <stdarg.h>
 
 #include "steensy.h"
 #include "uservice.h"
 // #include "sstate.h"
 #include "sencoder.h"
 #include "umqtt.h"
+#include "ureplay.h"
+#include "uflightrec.h"
+#include "utimeline.h"
+#include "udiag.h"
 
 // using namespace std;
 
 STeensy teensy[NUM_TEENSY_MAX];
+/// source name in the flight recorder
+static const char * flightName[] = {"T0", "T1", "T2", "T3"};
+// diagnostics level for this module
+static UDiagModule dg("teensy");
 
 
 bool UOutQueue::setMessage(const char* message)
@@ -95,9 +104,21 @@ void STeensy::setup(int teensyNumber)
     ini[ini_section]["confirm_timeout"] = "0.04";
     ini[ini_section]["encrev"] = "true";
   }
-  topicBase = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/";
-  topicDName = topicBase + "dname";
-  topicHelp = topicBase + "info";
+  topicBase = mqtt.root + ini["mqtt"]["function"] + "T" + std::to_string(tn) + "/";
+  topicHelp.setup(topicBase + "info");
+  topicLog.setup(topicBase + "log");
+  {
+    std::string lb = "tn=\"" + std::to_string(tn) + "\"";
+    mRxMsg = metrics.counter("teensy_rx_messages_total", "Messages received from Teensy", lb.c_str());
+    mTxMsg = metrics.counter("teensy_tx_messages_total", "Messages send to Teensy", lb.c_str());
+    mCrcFail = metrics.counter("teensy_crc_errors_total", "Received messages with CRC error", lb.c_str());
+    mRetry = metrics.counter("teensy_tx_retries_total", "Queued messages resend (no confirm)", lb.c_str());
+    mDumped = metrics.counter("teensy_tx_dropped_total", "Queued messages dropped after max retries", lb.c_str());
+    mQueue = metrics.gauge("teensy_tx_queue_size", "Messages in queue waiting for confirm", lb.c_str());
+    mDecodeTime = metrics.histogram("teensy_decode_seconds", "Time to decode and publish a Teensy message", lb.c_str());
+    sendLock.setup("teensy_send", lb.c_str());
+    dataLock.setup("teensy_data", lb.c_str());
+  }
   if (ini[ini_section]["use"] != "true")
   {
     printf("# STeensy::setup: open to Teensy %d disabled\n", tn);
@@ -124,6 +145,8 @@ void STeensy::setup(int teensyNumber)
     fprintf(logfile, "%%   \t(Rx) Received from Teensy\n");
     fprintf(logfile, "%%   \t(Qu N) Put in queue to Teensy, now queue size N\n");
     fprintf(logfile, "%% 3 \tMessage string queued, send or received\n");
+    // the full line is the text value
+    ioLog = logger.stream(logfile, fn, "%s");
   }
   // tell the Teensy its type-name - should be "robobot"
   // as this will change the function of Teensy to not do all the Regbot stuff.
@@ -155,6 +178,12 @@ void STeensy::setup(int teensyNumber)
     // save to Regbot flash
     send("eew\n");
   }
+  if (replay.active)
+  { // no Teensy, messages are from a log (see replayLine())
+    th1 = nullptr;
+    initialized = true;
+    return;
+  }
   // start thread and open teensy connection
   th1 = new std::thread(runObj, this);
   // allow thread to open connection
@@ -197,7 +226,12 @@ void STeensy::terminate()
 bool STeensy::send(const char* message, bool direct)
 {
   bool sendOK = false;
-  if (direct)
+  if (replay.active)
+  { // no Teensy, just log what would be send
+    toLogReplayTx(message);
+    sendOK = true;
+  }
+  else if (direct)
   {
     sendOK = sendDirect(message);
   }
@@ -218,10 +252,11 @@ void STeensy::sendToQueue(const char* message)
 //     printf("# STeensy 'sub enc' just before queue %s", message);
   // debug end
   outQueue.push(UOutQueue(message));
-  dataLock.lock(); // ensure consistency
+  if (mQueue != nullptr)
+    mQueue->set(outQueue.size());
+  timeline.counter("teensy_queue", outQueue.size());
   toLogQu();
 //   printf("# STeensy::sendToQueue: added '%s' tx-queue, now size %d\n", outQueue.back().msg, (int)outQueue.size());
-  dataLock.unlock();
 }
 
 bool STeensy::generateCRC(const char * cmd, char * crc)
@@ -252,10 +287,7 @@ bool STeensy::generateCRC(const char * cmd, char * crc)
 bool STeensy::sendDirect(const char* message)
 { // this function may be called by more than one thread
   // so make sure that only one send at any one time
-  int timeoutMs = 100;
 //   printf("# STeensy try to send timeout=%dms, confirmSend=%d, msg:%s", timeoutMs, confirmSend, message);
-  int t = 0;
-  bool lostConnection = false;
   bool sendOK = false;
   std::string cmd = message;
   // remove any source information as this is not relevant for the Teensy
@@ -268,72 +300,109 @@ bool STeensy::sendDirect(const char* message)
     cmd.insert(0, crc);
     if (not gotNewline)
       cmd.append(1, '\n');
-    int n = cmd.size();
     //
-    sendLock.lock();
+    {
+      UTimelineScope ts("teensy_send_lock");
+      sendLock.lock();
+    }
     // may have been closed in the meantime
     if (teensyConnectionOpen)
     {
       sendCnt++;
-//       printf("# STeensy sending directly CRC:'%s', msg:'%s'\n", crc, cmd);
-//       int m = write(usbport, crc, 3);
-      int d = 0;
-      int m;
-      bool skip = false;
-      while ((d < n) and (t < timeoutMs))
-      { // want to send n bytes to usbport within timeout period
-        m = write(usbport, &cmd[d], n - d);
-        if (m < 0)
-        { // error - an error occurred while sending
-          switch (errno)
-          { // may be an error, or just nothing send (buffer full)
-            case EAGAIN:
-              //not all send - just continue
-              printf("STeensy::sendDirect: waiting - nothing send %d/%d\n", d, n);
-              usleep(1000);
-              t += 1;
-              break;
-            default:
-              perror("STeensy::sendDirect (device gone?, skip message): ");
-              //lostConnection = true;
-              skip = true;
-              break;
-          }
-          // dump the rest on most errors
-          if (skip)
-            break;
-        }
-        else
-          // count bytes send
-          d += m;
-      }
-      sendOK = d == n;
-      dataLock.lock();
-      if (logfile != nullptr and not service.stop_logging)
-      {
-        UTime t;
-        t.now();
-        fprintf(logfile, "%lu.%04ld Txd %s", t.getSec(), t.getMicrosec()/100, cmd.c_str());
-        if (not gotNewline)
-          fprintf(logfile, "\n");
-      }
-      dataLock.unlock();
-      // include a short break to ensure that Teensy do not get overloaded
-      usleep(500);
+      if (mTxMsg != nullptr)
+        mTxMsg->inc();
+      sendOK = writeLocked(cmd);
+    }
+    sendLock.unlock();
+  }
+//  printf("# STeensy:: send finished\n");
+  return sendOK;
+}
+
+bool STeensy::sendBatch(const std::vector<std::string> & cmds)
+{ // all messages are send in one write,
+  // so that the Teensy gets them in one USB transfer
+  bool sendOK = false;
+  if (replay.active)
+  { // no Teensy, just log what would be send
+    for (const std::string & c : cmds)
+      toLogReplayTx((c + "\n").c_str());
+    return true;
+  }
+  std::string all;
+  all.reserve(cmds.size() * 40);
+  for (const std::string & c : cmds)
+  {
+    const int MCL = 4;
+    char crc[MCL];
+    generateCRC(c.c_str(), crc);
+    all += crc;
+    all += c;
+    all += '\n';
+  }
+  if (teensyConnectionOpen)
+  {
+    {
+      UTimelineScope ts("teensy_send_lock");
+      sendLock.lock();
     }
-    if (lostConnection)
+    // may have been closed in the meantime
+    if (teensyConnectionOpen)
     {
-      printf("# UTeensy:: lost connection\n");
-      closeUSB();
+      sendCnt += cmds.size();
+      if (mTxMsg != nullptr)
+        mTxMsg->inc(cmds.size());
+      sendOK = writeLocked(all);
     }
-    else
-      lastTxTime.now();
     sendLock.unlock();
   }
-//  printf("# STeensy:: send finished\n");
   return sendOK;
 }
 
+bool STeensy::writeLocked(const std::string & cmd)
+{ // sendLock must be locked
+  UTimelineScope ts("teensy_write");
+  int timeoutMs = 100;
+  int t = 0;
+  int n = cmd.size();
+  int d = 0;
+  int m;
+  bool skip = false;
+  while ((d < n) and (t < timeoutMs))
+  { // want to send n bytes to usbport within timeout period
+    m = write(usbport, &cmd[d], n - d);
+    if (m < 0)
+    { // error - an error occurred while sending
+      switch (errno)
+      { // may be an error, or just nothing send (buffer full)
+        case EAGAIN:
+          //not all send - just continue
+          DIAG(dg, UDiag::WARN, "# STeensy::sendDirect: waiting - nothing send %d/%d\n", d, n);
+          usleep(1000);
+          t += 1;
+          break;
+        default:
+          perror("STeensy::sendDirect (device gone?, skip message): ");
+          skip = true;
+          break;
+      }
+      // dump the rest on most errors
+      if (skip)
+        break;
+    }
+    else
+      // count bytes send
+      d += m;
+  }
+  UTime txTime("now");
+  flightrec.add(UFlightRec::TX, flightName[tn % 4], cmd.c_str(), nullptr, txTime);
+  toIoLog(txTime, "Txd %s", cmd.c_str());
+  // include a short break to ensure that Teensy do not get overloaded
+  usleep(500);
+  lastTxTime.now();
+  return d == n;
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 void STeensy::closeUSB()
@@ -349,6 +418,9 @@ void STeensy::closeUSB()
 //     printf("# STeensy::run but open=%d, gotAct=%d, lastTime=%f, just=%d, justTime=%g\n",
 //           teensyConnectionOpen, gotActivityRecently, lastRxTime.getTimePassed(), justConnected, justConnectedTime.getTimePassed());
     // then close the connection (after 100ms)
+    if (not service.stop)
+      // save what happened up to now
+      flightrec.trigger("teensy_lost");
     usleep(100000);
     close(usbport);
     usbport = -1;
@@ -379,6 +451,7 @@ void STeensy::run()
   // get robot name
   tit[9].now();
   bool ntpUpdate = false;
+  timeline.threadName("teensy");
   while (not stopUSB)
   { // handle Teensy connection
     if ((not ntpUpdate) and
@@ -475,28 +548,7 @@ void STeensy::run()
         if (rx[rxCnt-1] == '\n')
         { // terminate string - end of new line
           rx[rxCnt] = '\0';
-          // save to logfile if open
-          dataLock.lock();
-          toLogRx(rx, msgTime);
-          dataLock.unlock();
-          // handle this message line
-          if (crcCheck(rx))
-          { // got (at least) one valid message
-            const char * okMsg = &rx[3];
-            // check if this is a confirm message
-            if (strncmp(okMsg, "confirm", 7) == 0)
-            { // release next message
-              confirmSend = true;
-              // printf("# STeensy::run: received a confirm: '%s'\n", rx);
-              messageConfirmed(rx);
-            }
-            else
-            {
-              decode(okMsg, msgTime);
-            }
-          }
-          else
-            printf("# Teenst message discarded (crc-error) %s\n", rx);
+          handleRx(msgTime);
           // set activity timeer
           gotActivityRecently = true;
           lastRxTime.now();
@@ -504,6 +556,8 @@ void STeensy::run()
           rxCnt = 0;
           n = 0;
           gotCnt++;
+          if (mRxMsg != nullptr)
+            mRxMsg->inc();
         }
         titsum[4] += tit[4].getTimePassed();
       }
@@ -518,7 +572,7 @@ void STeensy::run()
       else
       { // debug n!= 0 and n!= 1
         tit[6].now();
-        printf("# Teensy::run: got n=%d chars, when asking for 1!\n", n);
+        DIAG(dg, UDiag::WARN, "# Teensy::run: got n=%d chars, when asking for 1!\n", n);
         fflush(nullptr);
         titsum[6] += tit[6].getTimePassed();
       }
@@ -535,7 +589,10 @@ void STeensy::run()
             outQueue.front().sendAt.now();
             outQueue.front().isSend = true;
             outQueue.front().resendCnt++;
+            if (mTxMsg != nullptr)
+              mTxMsg->inc();
             toLogTx();
+            flightrec.add(UFlightRec::TX, flightName[tn % 4], outQueue.front().msg, nullptr, outQueue.front().sendAt);
           }
           sendLock.unlock();
         }
@@ -560,14 +617,20 @@ void STeensy::run()
             { // just try again
               outQueue.front().isSend = false;
               confirmRetryCnt++;
+              if (mRetry != nullptr)
+                mRetry->inc();
             }
             else
             { // remove from queue
               outQueue.pop();
               confirmRetryDump++;
+              if (mDumped != nullptr)
+                mDumped->inc();
             }
           }
         }
+        if (mQueue != nullptr)
+          mQueue->set(outQueue.size());
         titsum[7] += tit[7].getTimePassed();
       }
     } // connected
@@ -579,11 +642,9 @@ void STeensy::run()
       ntpUpdate = true;
       printf("# STeensy[%d]:: time glitch of %.3f sec, %g secs after app start, maybe an NTP update\n", tn, tit[9].getTimePassed(), service.app_time);
       fflush(nullptr);
-      if (logfile != nullptr and not service.stop_logging)
       {
-        UTime t;
-        t.now();
-        fprintf(logfile, "%lu.%04ld NTP time glitch of %.3f sec, maybe an NTP update\n", t.getSec(), t.getMicrosec()/100, tit[9].getTimePassed());
+        UTime t("now");
+        toIoLog(t, "NTP time glitch of %.3f sec, maybe an NTP update\n", tit[9].getTimePassed());
       }
       if (teensyConnectionOpen)
       { //teensy time updated, so to avoid connection close
@@ -622,7 +683,11 @@ bool STeensy::crcCheck(const char* msg)
       int q1 = (sum % 99) + 1;
       int q2 = (msg[1] - '0') * 10 + msg[2] - '0';
       if (q1 != q2)
-        printf("# STeensy[%d]::handleCommand: CRC check failed (from Teensy) q1=%d != q2=%d; msg=%s\n", tn, q1, q2, msg);
+      {
+        DIAG(dg, UDiag::WARN, "# STeensy[%d]::handleCommand: CRC check failed (from Teensy) q1=%d != q2=%d; msg=%s\n", tn, q1, q2, msg);
+        if (mCrcFail != nullptr)
+          mCrcFail->inc();
+      }
       dataOK = true;
     }
   }
@@ -630,6 +695,52 @@ bool STeensy::crcCheck(const char* msg)
 }
 
 
+void STeensy::handleRx(UTime & msgTime)
+{
+  UTimelineScope ts("teensy_rx");
+  // save to logfile if open
+  toLogRx(rx, msgTime);
+  flightrec.add(UFlightRec::RX, flightName[tn % 4], rx, nullptr, msgTime);
+  // handle this message line
+  if (crcCheck(rx))
+  { // got (at least) one valid message
+    const char * okMsg = &rx[3];
+    // check if this is a confirm message
+    if (strncmp(okMsg, "confirm", 7) == 0)
+    { // release next message
+      confirmSend = true;
+      // printf("# STeensy::run: received a confirm: '%s'\n", rx);
+      messageConfirmed(rx);
+    }
+    else
+    {
+      decode(okMsg, msgTime);
+      if (mDecodeTime != nullptr)
+        mDecodeTime->observeSince(msgTime);
+    }
+  }
+  else
+  {
+    DIAG(dg, UDiag::WARN, "# Teensy[%d] message discarded (crc-error) %s", tn, rx);
+    if (mCrcFail != nullptr)
+      mCrcFail->inc();
+  }
+}
+
+void STeensy::replayLine(const char * line)
+{ // called by the replay thread only (the read thread is not running)
+  UTime msgTime("now");
+  int n = strnlen(line, MAX_RX_CNT - 2);
+  memcpy(rx, line, n);
+  if (n == 0 or rx[n - 1] != '\n')
+    rx[n++] = '\n';
+  rx[n] = '\0';
+  handleRx(msgTime);
+  gotCnt++;
+  if (mRxMsg != nullptr)
+    mRxMsg->inc();
+}
+
 void STeensy::messageConfirmed(const char* confirm)
 { // got a confirm message
   // test for first message in tx queue
@@ -652,7 +763,7 @@ void STeensy::messageConfirmed(const char* confirm)
       }
       else
       { // no match
-        printf("# Teensy[%d]::message queue compare err: '%s' != '%s'\n", tn, &confirm[11], outQueue.front().msg);
+        DIAG(dg, UDiag::WARN, "# Teensy[%d]::message queue compare err: '%s' != '%s'\n", tn, &confirm[11], outQueue.front().msg);
         confirmMismatchCnt++;
       }
     }
@@ -795,17 +906,17 @@ bool STeensy::decode(const char * msg, UTime & msgTime)
   if (msg[0] == '#')
   { // service message - just ignored
 //     printf("# UTeensy:: service message from Teensy: %s", msg);
-    mqtt.publish(topicHelp.c_str(), msg, msgTime);
+    mqtt.publish(topicHelp, msg, msgTime);
   }
   else if (msg[0] == '%')
   { // service message - just ignored
     //     printf("# UTeensy:: service message from Teensy: %s", msg);
-    mqtt.publish((topicBase + "log").c_str(), msg, msgTime);
+    mqtt.publish(topicLog, msg, msgTime);
   }
   else if (isdigit(msg[0]))
   { // service message - just ignored
     //     printf("# UTeensy:: service message from Teensy: %s", msg);
-    mqtt.publish((topicBase + "log").c_str(), msg, msgTime);
+    mqtt.publish(topicLog, msg, msgTime);
   }
   else
   { // use message key as sub-topic
@@ -814,22 +925,40 @@ bool STeensy::decode(const char * msg, UTime & msgTime)
       p1++;
     if (*p1 == ' ')
     {
-      const int MTL = 32;
-      char s[MTL];
-      int n = p1 - msg;
-      if (n > 31)
-        n = 31;
-      strncpy(s, msg, n);
-      s[n] = '\0';
+      UMqttTopic * topic = getKeyTopic(msg, p1 - msg);
       p1++;
-      mqtt.publish((topicBase + s).c_str(), p1, msgTime);
+      if (topic != nullptr)
+        mqtt.publish(*topic, p1, msgTime);
     }
     else
-      printf(" STeensy[%d]:: unused Teensy message (maybe Teensy is in interactive mode?): %s", tn, msg);
+      DIAG(dg, UDiag::INFO, "# STeensy[%d]:: unused Teensy message (maybe Teensy is in interactive mode?): %s", tn, msg);
   }
   return used;
 }
 
+UMqttTopic * STeensy::getKeyTopic(const char * key, int n)
+{ // called from the read thread only, so no locking
+  if (n >= MAX_KEY_LENGTH)
+    n = MAX_KEY_LENGTH - 1;
+  for (int i = 0; i < keyTopicCnt; i++)
+  { // most messages are known already
+    if (strncmp(keyName[i], key, n) == 0 and keyName[i][n] == '\0')
+      return &keyTopic[i];
+  }
+  if (keyTopicCnt >= MAX_KEY_TOPICS)
+  { // should not happen, Teensy has fewer message types
+    printf("# STeensy[%d]:: too many message types (max %d), not published: %.*s\n", tn, MAX_KEY_TOPICS, n, key);
+    return nullptr;
+  }
+  // new message type, make the topic (once)
+  UMqttTopic * topic = &keyTopic[keyTopicCnt];
+  strncpy(keyName[keyTopicCnt], key, n);
+  keyName[keyTopicCnt][n] = '\0';
+  topic->setup(topicBase + keyName[keyTopicCnt]);
+  keyTopicCnt++;
+  return topic;
+}
+
 int STeensy::getTeensyCommError(int& retryCnt)
 {
   retryCnt = confirmRetryCnt;
@@ -846,10 +975,7 @@ void STeensy::toLog(const char* msg)
   UTime t("now");
   if (service.stop)
     return;
-  if (logfile != nullptr and not service.stop_logging)
-  {
-    fprintf(logfile, "%lu.%04ld ## %s", t.getSec(), t.getMicrosec()/100, msg);
-  }
+  toIoLog(t, "## %s", msg);
   if (toConsole)
   {
     printf("%lu.%04ld ## %s", t.getSec(), t.getMicrosec()/100, msg);
@@ -857,14 +983,27 @@ void STeensy::toLog(const char* msg)
 }
 
 
+void STeensy::toIoLog(UTime & t, const char * format, ...)
+{ // the line is made here, but written to disk by the logger thread,
+  // so a slow SD card does not delay the Rx and Tx path
+  if (ioLog == nullptr or service.stop_logging)
+    return;
+  char s[ULogRecord::MAX_TEXT];
+  va_list ap;
+  va_start(ap, format);
+  int n = vsnprintf(s, ULogRecord::MAX_TEXT, format, ap);
+  va_end(ap);
+  if (n >= ULogRecord::MAX_TEXT)
+    // truncated, but keep one line
+    s[ULogRecord::MAX_TEXT - 2] = '\n';
+  ioLog->log(t, s);
+}
+
 void STeensy::toLogRx(const char*, UTime & mt)
 {
   if (service.stop)
     return;
-  if (logfile != nullptr and not service.stop_logging)
-  {
-    fprintf(logfile, "%lu.%04ld Rx %s", mt.getSec(), mt.getMicrosec()/100, rx);
-  }
+  toIoLog(mt, "Rx %s", rx);
   if (toConsole)
   {
     printf("%lu.%04ld Rx %s", mt.getSec(), mt.getMicrosec()/100, rx);
@@ -875,13 +1014,7 @@ void STeensy::toLogTx()
 {
   if (service.stop)
     return;
-  if (logfile != nullptr and not service.stop_logging)
-  {
-    fprintf(logfile, "%lu.%04ld Tx %s",
-            outQueue.front().sendAt.getSec(),
-            outQueue.front().sendAt.getMicrosec()/100,
-            outQueue.front().msg);
-  }
+  toIoLog(outQueue.front().sendAt, "Tx %s", outQueue.front().msg);
   if (toConsole)
   {
     printf("%lu.%04ld Tx %s",
@@ -891,18 +1024,18 @@ void STeensy::toLogTx()
   }
 }
 
+void STeensy::toLogReplayTx(const char * msg)
+{ // replay time is the time the message was send
+  UTime t("now");
+  flightrec.add(UFlightRec::TX, flightName[tn % 4], msg, nullptr, t);
+  toIoLog(t, "Tx %s", msg);
+}
+
 void STeensy::toLogQu()
 {
   if (service.stop)
     return;
-  if (logfile != nullptr and not service.stop_logging)
-  {
-    fprintf(logfile, "%lu.%04ld Qu %d %s",
-            outQueue.back().queuedAt.getSec(),
-            outQueue.back().queuedAt.getMicrosec()/100,
-            (int)outQueue.size(),
-            outQueue.back().msg);
-  }
+  toIoLog(outQueue.back().queuedAt, "Qu %d %s", (int)outQueue.size(), outQueue.back().msg);
   if (toConsole)
   {
     printf("%lu.%04ld Qu %d %s",
@@ -31,8 +31,13 @@
 #include <thread>
 #include <string.h>
 #include <string>
+#include <vector>
 
 #include "utime.h"
+#include "umqtt.h"
+#include "umetrics.h"
+#include "umutex.h"
+#include "ulogger.h"
 
 #define NUM_TEENSY_MAX 1
 
@@ -115,7 +120,7 @@ private:
 //   mutex txLock;
 //   mutex logMtx;
   std::mutex eventUpdate;
-  std::mutex sendLock;
+  UMutex sendLock;
   // receive buffer
   static const int MAX_RX_CNT = 1000;
   char rx[MAX_RX_CNT];
@@ -153,6 +158,13 @@ public:
    * \param direct for bypassing the default message queue
    * \returns true if send direct and delivered OK */
   bool send(const char * message, bool direct = false);
+  /**
+   * Send more messages to the Teensy in one write (one USB transfer),
+   * so that they are handled in the same Teensy cycle.
+   * The messages are send directly (no queue and no confirm).
+   * \param cmds are the messages (without CRC and newline)
+   * \returns true if all is delivered to the port */
+  bool sendBatch(const std::vector<std::string> & cmds);
   /**
    * runs the receive thread 
    * This run() function is called in a thread after a start() call.
@@ -161,6 +173,11 @@ public:
   /**
   * decode commands potentially for this device */
   bool decode(const char* msg, UTime & msgTime);
+  /**
+   * Handle a message line from a log, as if received from the Teensy
+   * (replay mode), message time is the replay clock.
+   * \param line is the message with CRC, e.g. ';34hbt 12.3 ...' */
+  void replayLine(const char * line);
   /** Generate 3 character CRC as ";XX", where
    * NN is sum of character value modulus 99 + 1.
    * Only characters with a value c>' ' counts
@@ -183,11 +200,29 @@ private:
   /**
    * send this message directly to the Teensy port */
   bool sendDirect(const char* message);
+  /**
+   * Write this (CRC coded) data to the port, sendLock must be locked.
+   * \returns true if all is written */
+  bool writeLocked(const std::string & data);
+  /**
+   * Log, decode and publish the received message in rx
+   * \param msgTime is the time of reception */
+  void handleRx(UTime & msgTime);
+  /**
+   * Log a message, that would have been send (replay mode) */
+  void toLogReplayTx(const char * msg);
   /**
    * Check for crc error
    * \param rawMsg is the message preceded by crc
    * \return true if OK */
   bool crcCheck(const char * rawMsg);
+  /**
+   * Get the MQTT topic for this message key (e.g. 'hbt'),
+   * the topic is created at first use only.
+   * \param key is the first part of the Teensy message
+   * \param n is the length of the key
+   * \returns pointer to topic or nullptr if the table is full. */
+  UMqttTopic * getKeyTopic(const char * key, int n);
   /**
    * is data source active (is device open) */
   virtual bool isActive()
@@ -240,16 +275,36 @@ private:
   void toLogRx(const char*, UTime& mt);
   void toLogTx();
   void toLogQu();
+  /**
+   * Add a line to the io log (written by the logger thread)
+   * \param t is the time (first column)
+   * \param format and the rest is as printf, the line should end with a newline */
+  void toIoLog(UTime & t, const char * format, ...);
   /// should logged messages be printed on console too.
   bool toConsole = false;
-  /// data io logfile
+  /// data io logfile (header only, lines are written by the logger)
   FILE * logfile = nullptr;
-  std::mutex dataLock; // ensure consistency
+  ULogStream * ioLog = nullptr;
+  UMutex dataLock; // ensure consistency
   //
   // MQTT
   std::string topicBase;
-  std::string topicDName;
-  std::string topicHelp;
+  UMqttTopic topicHelp;
+  UMqttTopic topicLog;
+  // metrics (nullptr if setup() is not called, e.g. no robot hardware)
+  UMetricCounter * mRxMsg = nullptr;
+  UMetricCounter * mTxMsg = nullptr;
+  UMetricCounter * mCrcFail = nullptr;
+  UMetricCounter * mRetry = nullptr;
+  UMetricCounter * mDumped = nullptr;
+  UMetricGauge * mQueue = nullptr;
+  UMetricHistogram * mDecodeTime = nullptr;
+  /// topics for messages forwarded using the message key as sub-topic
+  static const int MAX_KEY_TOPICS = 64;
+  static const int MAX_KEY_LENGTH = 32;
+  char keyName[MAX_KEY_TOPICS][MAX_KEY_LENGTH];
+  UMqttTopic keyTopic[MAX_KEY_TOPICS];
+  int keyTopicCnt = 0;
 };
 
 extern STeensy teensy[NUM_TEENSY_MAX];
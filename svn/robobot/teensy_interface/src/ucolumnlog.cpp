@@ -0,0 +1,359 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "ucolumnlog.h"
+
+UColumnLog::~UColumnLog()
+{
+  close();
+}
+
+bool UColumnLog::open(std::string fileName, std::string header,
+                      const std::vector<uint8_t> & types, const std::vector<std::string> & names)
+{
+  file = fopen(fileName.c_str(), "w");
+  if (file == nullptr)
+    return false;
+  columns = types.size() + 1;
+  type.clear();
+  type.push_back(TYPE_DOUBLE);
+  type.insert(type.end(), types.begin(), types.end());
+  // file header
+  const uint32_t version = 1;
+  uint32_t n = columns;
+  uint32_t hl = header.size();
+  fwrite("ULC1", 1, 4, file);
+  fwrite(&version, 4, 1, file);
+  fwrite(&n, 4, 1, file);
+  fwrite(&hl, 4, 1, file);
+  fwrite(header.data(), 1, hl, file);
+  pos = 16 + hl;
+  for (int c = 0; c < columns; c++)
+  {
+    std::string nm = "time";
+    if (c > 0)
+    {
+      if (c - 1 < (int)names.size())
+        nm = names[c - 1];
+      else
+        nm = "c" + std::to_string(c + 1);
+    }
+    if (nm.size() > 255)
+      nm.resize(255);
+    uint8_t h[2] = {type[c], (uint8_t)nm.size()};
+    fwrite(h, 1, 2, file);
+    fwrite(nm.data(), 1, nm.size(), file);
+    pos += 2 + nm.size();
+  }
+  buf.resize(columns);
+  for (auto & b : buf)
+    b.resize(chunkRows);
+  rows = 0;
+  index.clear();
+  return true;
+}
+
+void UColumnLog::add(double time, const UColumnValue * v, int n)
+{
+  if (file == nullptr)
+    return;
+  buf[0][rows].d = time;
+  for (int c = 1; c < columns; c++)
+  {
+    if (c - 1 < n)
+      buf[c][rows] = v[c - 1];
+    else
+      buf[c][rows].i = 0;
+  }
+  rows++;
+  if (rows >= chunkRows)
+    flushChunk();
+}
+
+void UColumnLog::flushChunk()
+{
+  if (file == nullptr or rows == 0)
+    return;
+  std::vector<double> mn(columns), mx(columns);
+  for (int c = 0; c < columns; c++)
+  { // min and max as double
+    for (int r = 0; r < rows; r++)
+    {
+      double d = type[c] == TYPE_INT ? buf[c][r].i : buf[c][r].d;
+      if (r == 0 or d < mn[c])
+        mn[c] = d;
+      if (r == 0 or d > mx[c])
+        mx[c] = d;
+    }
+  }
+  uint32_t n = rows;
+  uint64_t bytes = columns * 16 + (uint64_t)columns * rows * 8;
+  fwrite("CHNK", 1, 4, file);
+  fwrite(&n, 4, 1, file);
+  fwrite(&bytes, 8, 1, file);
+  fwrite(mn.data(), 8, columns, file);
+  fwrite(mx.data(), 8, columns, file);
+  for (int c = 0; c < columns; c++)
+    fwrite(buf[c].data(), 8, rows, file);
+  index.push_back({pos, n, mn[0], mx[0]});
+  pos += 16 + bytes;
+  rows = 0;
+  fflush(file);
+}
+
+void UColumnLog::close()
+{
+  if (file == nullptr)
+    return;
+  flushChunk();
+  uint64_t indexPos = pos;
+  uint32_t n = index.size();
+  fwrite("CIDX", 1, 4, file);
+  fwrite(&n, 4, 1, file);
+  for (auto & ci : index)
+  {
+    fwrite(&ci.offset, 8, 1, file);
+    fwrite(&ci.rows, 4, 1, file);
+    fwrite(&ci.tmin, 8, 1, file);
+    fwrite(&ci.tmax, 8, 1, file);
+  }
+  fwrite(&indexPos, 8, 1, file);
+  fwrite("ULCE", 1, 4, file);
+  fclose(file);
+  file = nullptr;
+}
+
+std::vector<std::string> UColumnLog::namesFromHeader(const std::string & header, int columns)
+{
+  std::vector<std::string> names(columns);
+  size_t p = 0;
+  while (p < header.size())
+  {
+    size_t e = header.find('\n', p);
+    if (e == std::string::npos)
+      e = header.size();
+    std::string line = header.substr(p, e - p);
+    p = e + 1;
+    // e.g. '% 2-4 \tGyro (x,y,z)' or '% 2,3 \tVelocity left, right'
+    const char * p1 = line.c_str();
+    if (*p1 != '%')
+      continue;
+    p1++;
+    while (*p1 == ' ')
+      p1++;
+    if (not isdigit(*p1))
+      continue;
+    char * p2;
+    int a = strtol(p1, &p2, 10);
+    int b = a;
+    while (*p2 == '-' or *p2 == ',')
+      b = strtol(p2 + 1, &p2, 10);
+    while (isspace(*p2))
+      p2++;
+    std::string desc = p2;
+    while (not desc.empty() and isspace(desc.back()))
+      desc.pop_back();
+    // text log column 1 is time
+    for (int c = a; c <= b; c++)
+    {
+      int v = c - 2;
+      if (v < 0 or v >= columns or not names[v].empty())
+        continue;
+      names[v] = desc;
+      if (b > a)
+        names[v] += " " + std::to_string(c - a + 1);
+    }
+  }
+  for (int v = 0; v < columns; v++)
+  {
+    if (names[v].empty())
+      names[v] = "c" + std::to_string(v + 2);
+  }
+  return names;
+}
+
+////////////////////////////////////////////////////////////////
+
+UColumnLogReader::~UColumnLogReader()
+{
+  close();
+}
+
+void UColumnLogReader::close()
+{
+  if (file != nullptr)
+  {
+    fclose(file);
+    file = nullptr;
+  }
+}
+
+bool UColumnLogReader::open(std::string fileName)
+{
+  close();
+  file = fopen(fileName.c_str(), "rb");
+  if (file == nullptr)
+    return false;
+  char magic[4];
+  uint32_t version, columns, hl;
+  bool ok = fread(magic, 1, 4, file) == 4 and strncmp(magic, "ULC1", 4) == 0;
+  ok = ok and fread(&version, 4, 1, file) == 1;
+  ok = ok and fread(&columns, 4, 1, file) == 1;
+  ok = ok and fread(&hl, 4, 1, file) == 1;
+  if (not ok)
+  {
+    close();
+    return false;
+  }
+  header.resize(hl);
+  ok = fread(header.data(), 1, hl, file) == hl;
+  name.clear();
+  type.clear();
+  for (uint32_t c = 0; c < columns and ok; c++)
+  {
+    uint8_t h[2];
+    ok = fread(h, 1, 2, file) == 2;
+    std::string nm(h[1], ' ');
+    ok = ok and fread(nm.data(), 1, h[1], file) == h[1];
+    type.push_back(h[0]);
+    name.push_back(nm);
+  }
+  if (not ok)
+  {
+    close();
+    return false;
+  }
+  uint64_t dataStart = ftell(file);
+  // index from the end of the file
+  index.clear();
+  hadIndex = false;
+  uint64_t indexPos;
+  if (fseek(file, -12, SEEK_END) == 0 and
+      fread(&indexPos, 8, 1, file) == 1 and
+      fread(magic, 1, 4, file) == 4 and
+      strncmp(magic, "ULCE", 4) == 0 and
+      fseek(file, indexPos, SEEK_SET) == 0)
+  {
+    uint32_t n;
+    hadIndex = fread(magic, 1, 4, file) == 4 and strncmp(magic, "CIDX", 4) == 0 and
+               fread(&n, 4, 1, file) == 1;
+    for (uint32_t i = 0; i < n and hadIndex; i++)
+    {
+      UColumnChunk ci;
+      hadIndex = fread(&ci.offset, 8, 1, file) == 1 and fread(&ci.rows, 4, 1, file) == 1 and
+                 fread(&ci.tmin, 8, 1, file) == 1 and fread(&ci.tmax, 8, 1, file) == 1;
+      index.push_back(ci);
+    }
+  }
+  if (not hadIndex)
+  { // not closed, so find the chunks
+    index.clear();
+    scanChunks(dataStart);
+  }
+  return true;
+}
+
+bool UColumnLogReader::scanChunks(uint64_t from)
+{
+  int columns = name.size();
+  uint64_t p = from;
+  while (fseek(file, p, SEEK_SET) == 0)
+  {
+    char magic[4];
+    UColumnChunk ci;
+    uint64_t bytes;
+    if (fread(magic, 1, 4, file) != 4 or strncmp(magic, "CHNK", 4) != 0 or
+        fread(&ci.rows, 4, 1, file) != 1 or fread(&bytes, 8, 1, file) != 1)
+      break;
+    // time min and max are the first in min and max arrays
+    if (fread(&ci.tmin, 8, 1, file) != 1 or
+        fseek(file, (columns - 1) * 8, SEEK_CUR) != 0 or
+        fread(&ci.tmax, 8, 1, file) != 1)
+      break;
+    // is the chunk complete
+    if (fseek(file, p + 16 + bytes - 1, SEEK_SET) != 0 or fgetc(file) == EOF)
+      break;
+    ci.offset = p;
+    index.push_back(ci);
+    p += 16 + bytes;
+  }
+  return not index.empty();
+}
+
+int UColumnLogReader::read(double t0, double t1, std::vector<int> cols,
+                           std::vector<std::vector<double>> & data)
+{
+  int columns = name.size();
+  if (file == nullptr)
+    return 0;
+  if (cols.empty())
+  {
+    for (int c = 0; c < columns; c++)
+      cols.push_back(c);
+  }
+  data.clear();
+  data.resize(cols.size());
+  int total = 0;
+  std::vector<UColumnValue> t, v;
+  for (auto & ci : index)
+  {
+    if ((t1 > 0 and ci.tmin > t1) or ci.tmax < t0)
+      // not in window
+      continue;
+    uint64_t dataPos = ci.offset + 16 + columns * 16;
+    // rows within window (time column)
+    t.resize(ci.rows);
+    if (fseek(file, dataPos, SEEK_SET) != 0 or fread(t.data(), 8, ci.rows, file) != ci.rows)
+      break;
+    std::vector<bool> use(ci.rows);
+    int n = 0;
+    for (uint32_t r = 0; r < ci.rows; r++)
+    {
+      use[r] = t[r].d >= t0 and (t1 <= 0 or t[r].d <= t1);
+      n += use[r];
+    }
+    for (int k = 0; k < (int)cols.size(); k++)
+    {
+      int c = cols[k];
+      if (c < 0 or c >= columns)
+        continue;
+      v.resize(ci.rows);
+      if (fseek(file, dataPos + (uint64_t)c * ci.rows * 8, SEEK_SET) != 0 or
+          fread(v.data(), 8, ci.rows, file) != ci.rows)
+        break;
+      auto & d = data[k];
+      d.reserve(d.size() + n);
+      for (uint32_t r = 0; r < ci.rows; r++)
+      {
+        if (use[r])
+          d.push_back(type[c] == UColumnLog::TYPE_INT ? v[r].i : v[r].d);
+      }
+    }
+    total += n;
+  }
+  return total;
+}
@@ -0,0 +1,153 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+/**
+ * Columnar log file (.ulc), for fast loading of long logs.
+ * Values are stored in chunks, column by column, so a time window
+ * or some of the columns can be read without reading the rest.
+ * All numbers are little endian.
+ *
+ * File header
+ *   char[4] "ULC1", uint32 version, uint32 columns (time is column 0),
+ *   uint32 n, char[n] text header (the '%' lines of the text log),
+ *   for each column: uint8 type (0 = int64, 1 = double), uint8 n, char[n] name
+ * Chunk (repeated)
+ *   char[4] "CHNK", uint32 rows, uint64 bytes (after this field),
+ *   double min[columns], double max[columns],
+ *   data: column 0 (rows * 8 bytes), column 1, ...
+ * Index (when closed)
+ *   char[4] "CIDX", uint32 chunks,
+ *   for each chunk: uint64 offset, uint32 rows, double tmin, double tmax
+ *   uint64 index offset, char[4] "ULCE"
+ * A file without index (e.g. after a crash) is read by
+ * skipping from chunk to chunk.
+ * Readers: UColumnLogReader (here), log_columns.py and doc/matlab/read_ulc.m */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** a value as stored, int64 or double as the column type */
+union UColumnValue
+{
+  int64_t i;
+  double d;
+};
+
+/** chunk index entry */
+class UColumnChunk
+{
+public:
+  uint64_t offset;
+  uint32_t rows;
+  double tmin;
+  double tmax;
+};
+
+/**
+ * Write a columnar log */
+class UColumnLog
+{
+public:
+  enum {TYPE_INT = 0, TYPE_DOUBLE = 1};
+  ~UColumnLog();
+  /**
+   * Create the file
+   * \param fileName is the file to create (e.g. log_t0_encoder.ulc)
+   * \param header is the text header of the log (comment lines)
+   * \param types is the type of each value column (after time)
+   * \param names is the name of each value column (after time), may be empty
+   * \returns true if created */
+  bool open(std::string fileName, std::string header,
+            const std::vector<uint8_t> & types, const std::vector<std::string> & names);
+  /**
+   * Add a row
+   * \param time is the time (sec since epoch)
+   * \param v are the values (as the column types)
+   * \param n is number of values (missing values are 0) */
+  void add(double time, const UColumnValue * v, int n);
+  /** write buffered rows as a chunk */
+  void flushChunk();
+  /** write last chunk and the index, and close */
+  void close();
+  bool isOpen()
+  {
+    return file != nullptr;
+  }
+  /**
+   * Get column names from a text log header,
+   * where lines are like '% 2 \tLeft encoder' or '% 2-4 \tGyro (x,y,z)'
+   * \param header is the comment lines
+   * \param columns is the number of value columns (after time)
+   * \returns a name for each value column */
+  static std::vector<std::string> namesFromHeader(const std::string & header, int columns);
+  /// rows in a chunk
+  int chunkRows = 4096;
+
+private:
+  FILE * file = nullptr;
+  uint64_t pos = 0;
+  int columns = 0;
+  std::vector<uint8_t> type;
+  /// column buffers (column 0 is time)
+  std::vector<std::vector<UColumnValue>> buf;
+  int rows = 0;
+  std::vector<UColumnChunk> index;
+};
+
+/**
+ * Read a columnar log */
+class UColumnLogReader
+{
+public:
+  ~UColumnLogReader();
+  /**
+   * Open and read header and index
+   * \returns true if the file is a columnar log */
+  bool open(std::string fileName);
+  void close();
+  /**
+   * Read a time window
+   * \param t0 is start time (sec since epoch, 0 = from start)
+   * \param t1 is end time (0 = to end)
+   * \param cols are the columns to read (0 is time), empty is all
+   * \param data is set to one vector for each column (as double)
+   * \returns number of rows */
+  int read(double t0, double t1, std::vector<int> cols,
+           std::vector<std::vector<double>> & data);
+  /// text header from the log
+  std::string header;
+  /// column names (time is column 0)
+  std::vector<std::string> name;
+  std::vector<uint8_t> type;
+  std::vector<UColumnChunk> index;
+  /// the file had an index (else it was build by reading chunk headers)
+  bool hadIndex = false;
+
+private:
+  bool scanChunks(uint64_t from);
+  FILE * file = nullptr;
+};
@@ -0,0 +1,234 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+
+#include "udiag.h"
+#include "uservice.h"
+#include "umqttrouter.h"
+
+// create value
+UDiag diag;
+
+static const char * levelName[UDiag::LEVEL_CNT] = {"error", "warn", "info", "debug"};
+
+UDiagModule::UDiagModule(const char * moduleName)
+{ // called at static initialization
+  name = moduleName;
+  console = UDiag::WARN;
+  log = UDiag::WARN;
+  level = UDiag::WARN;
+  UDiag::modules().push_back(this);
+}
+
+std::vector<UDiagModule *> & UDiag::modules()
+{ // created at first use (modules are static in other files)
+  static std::vector<UDiagModule *> list;
+  return list;
+}
+
+int UDiag::levelFromName(const char * name)
+{
+  for (int i = 0; i < LEVEL_CNT; i++)
+  {
+    if (strncmp(name, levelName[i], strlen(levelName[i])) == 0)
+      return i;
+  }
+  return -1;
+}
+
+void UDiag::setup()
+{ // ensure default values
+  if (not ini.has("diag"))
+  { // no data yet, so generate some default values
+    ini["diag"]["rate_per_s"] = "5";
+    ini["diag"]["burst"] = "20";
+    // console level and log (log_service.txt) level
+    ini["diag"]["default"] = "warn info";
+  }
+  rate = strtof(ini["diag"]["rate_per_s"].c_str(), nullptr);
+  burst = strtof(ini["diag"]["burst"].c_str(), nullptr);
+  if (burst < 1)
+    burst = 1;
+  mShown = metrics.counter("diag_messages_total", "Diagnostics messages printed or logged");
+  mSuppressed = metrics.counter("diag_suppressed_total", "Diagnostics messages suppressed by rate limit");
+  topicDiag.setup(mqtt.root + ini["mqtt"]["function"] + "diag");
+  // levels from ini-file
+  std::string def = ini["diag"]["default"];
+  for (auto m : modules())
+  {
+    std::string v = def;
+    if (ini["diag"].has(m->name))
+      v = ini["diag"][m->name];
+    const char * p1 = v.c_str();
+    while (*p1 == ' ')
+      p1++;
+    const char * p2 = strchr(p1, ' ');
+    if (p2 != nullptr)
+      while (*p2 == ' ')
+        p2++;
+    setLevel(m->name, p1, p2);
+  }
+  router.add(mqtt.root + "cmd/ti/diag", "diag",
+    [this](const char *, const char *, const char * payload, UTime &)
+    { // '<module> <console level> [<log level>]'
+      const int MSL = 100;
+      char s[MSL];
+      strncpy(s, payload, MSL - 1);
+      s[MSL - 1] = '\0';
+      char * save;
+      const char * mod = strtok_r(s, " \n", &save);
+      const char * con = strtok_r(nullptr, " \n", &save);
+      const char * lg = strtok_r(nullptr, " \n", &save);
+      if (mod != nullptr and con != nullptr)
+      {
+        if (not setLevel(mod, con, lg))
+          printf("# UDiag:: unknown module or level in '%s'\n", payload);
+      }
+      publishLevels();
+      return true;
+    });
+}
+
+bool UDiag::setLevel(const char * module, const char * console, const char * log)
+{
+  int c = levelFromName(console);
+  int l = c;
+  if (log != nullptr and *log != '\0')
+    l = levelFromName(log);
+  if (c < 0 or l < 0)
+    return false;
+  bool found = false;
+  for (auto m : modules())
+  {
+    if (strcmp(module, "all") == 0 or strcmp(module, m->name) == 0)
+    {
+      m->console = c;
+      m->log = l;
+      m->level = std::max(c, l);
+      found = true;
+    }
+  }
+  return found;
+}
+
+void UDiag::publishLevels()
+{
+  std::string s;
+  for (auto m : modules())
+  {
+    s += m->name;
+    s += "=";
+    s += levelName[m->console];
+    s += ",";
+    s += levelName[m->log];
+    s += " ";
+  }
+  UTime t("now");
+  mqtt.publish(topicDiag, s.c_str(), t);
+}
+
+void UDiag::print(UDiagModule & module, UDiagSite & site, int lvl, const char * format, ...)
+{
+  UTime t("now");
+  std::lock_guard<std::mutex> guard(lock);
+  site.level = lvl;
+  // refill rate limit
+  if (site.tokens < 0)
+    site.tokens = burst;
+  else
+    site.tokens = std::min(burst, site.tokens + rate * (t - site.last));
+  site.last = t;
+  if (site.tokens < 1)
+  { // too many, just count
+    site.suppressed++;
+    if (mSuppressed != nullptr)
+      mSuppressed->inc();
+    if (not site.pending)
+    { // report later
+      site.pending = true;
+      pendingSites.push_back(&site);
+      pendingModules.push_back(&module);
+    }
+    return;
+  }
+  site.tokens -= 1;
+  const int MSL = 1000;
+  char s[MSL];
+  if (site.suppressed > 0)
+  { // summary of the burst first
+    snprintf(s, MSL, "# %d similar suppressed (%s): %s\n", site.suppressed, module.name, site.msg);
+    output(module, lvl, s);
+    site.suppressed = 0;
+  }
+  va_list args;
+  va_start(args, format);
+  vsnprintf(s, MSL, format, args);
+  va_end(args);
+  // remember start of message (for summary)
+  int n = strcspn(s, "\n");
+  snprintf(site.msg, UDiagSite::MSL, "%.*s", n, s);
+  output(module, lvl, s);
+  if (mShown != nullptr)
+    mShown->inc();
+}
+
+void UDiag::output(UDiagModule & module, int lvl, const char * msg)
+{ // lock is locked
+  if (lvl <= module.console)
+  {
+    printf("%s", msg);
+  }
+  if (lvl <= module.log and service.logfile != nullptr)
+  {
+    UTime t("now");
+    fprintf(service.logfile, "%lu.%04ld %s %s", t.getSec(), t.getMicrosec()/100, levelName[lvl], msg);
+  }
+}
+
+void UDiag::flushSuppressed()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (int i = 0; i < (int)pendingSites.size(); i++)
+  {
+    UDiagSite * site = pendingSites[i];
+    if (site->last.getTimePassed() < 1.0)
+      // burst may continue
+      continue;
+    if (site->suppressed > 0)
+    {
+      const int MSL = 200;
+      char s[MSL];
+      snprintf(s, MSL, "# %d similar suppressed (%s): %s\n", site->suppressed, pendingModules[i]->name, site->msg);
+      output(*pendingModules[i], site->level, s);
+      site->suppressed = 0;
+    }
+    site->pending = false;
+    pendingSites.erase(pendingSites.begin() + i);
+    pendingModules.erase(pendingModules.begin() + i);
+    i--;
+  }
+}
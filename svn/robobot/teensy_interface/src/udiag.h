@@ -0,0 +1,140 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "utime.h"
+#include "umqtt.h"
+#include "umetrics.h"
+
+/**
+ * A module with its own diagnostics level,
+ * create one (static) for each source file, e.g.
+ * static UDiagModule dg("mixer"); */
+class UDiagModule
+{
+public:
+  UDiagModule(const char * moduleName);
+  /** is this level printed or logged (cheap test) */
+  inline bool enabled(int lvl)
+  {
+    return lvl <= level.load(std::memory_order_relaxed);
+  }
+  const char * name;
+  /// level for console (stdout) and for log_service.txt
+  std::atomic<int> console;
+  std::atomic<int> log;
+  /// the highest of console and log
+  std::atomic<int> level;
+};
+
+/**
+ * Rate limit for one diagnostics message (one call site) */
+class UDiagSite
+{
+public:
+  float tokens = -1;
+  UTime last;
+  int suppressed = 0;
+  bool pending = false;
+  /// level of the message
+  int level = 0;
+  /// start of last message shown
+  static const int MSL = 60;
+  char msg[MSL] = {'\0'};
+};
+
+/**
+ * Print a diagnostics message, e.g.
+ * DIAG(dg, UDiag::INFO, "# CMixer:: vel=%g\n", v);
+ * The arguments are used only if the level is enabled for the module.
+ * Messages from the same line are rate limited. */
+#define DIAG(module, lvl, ...) \
+  do { \
+    static UDiagSite diagSite; \
+    if ((module).enabled(lvl)) \
+      diag.print(module, diagSite, lvl, __VA_ARGS__); \
+  } while (0)
+
+/**
+ * Diagnostics (console and service log) with a level for each module.
+ * Levels are set in ini [diag] as '<module> = <console level> [<log level>]',
+ * e.g. 'teensy = warn info', 'default' is used for modules not in the ini-file.
+ * Levels are 'error', 'warn', 'info' and 'debug'.
+ * Levels can be changed over MQTT 'robobot/cmd/ti/diag' with payload
+ * '<module> <console level> [<log level>]' ('all' for all modules),
+ * and '?' publishes the levels on 'robobot/drive/diag'.
+ * Each message (call site) is limited to 'rate_per_s' (with a burst of 'burst'),
+ * suppressed messages are reported as 'N similar suppressed' later. */
+class UDiag
+{
+public:
+  enum Level {ERROR = 0, WARN, INFO, DEBUG, LEVEL_CNT};
+  void setup();
+  /**
+   * Print (and log) a message, if not rate limited
+   * \param module is the source module
+   * \param site is the rate limit for this message
+   * \param lvl is the message level
+   * \param format is printf format (with newline) */
+  void print(UDiagModule & module, UDiagSite & site, int lvl, const char * format, ...)
+    __attribute__((format(printf, 5, 6)));
+  /**
+   * Report messages suppressed more than a second ago (called by service thread) */
+  void flushSuppressed();
+  /**
+   * Set level
+   * \param module is the module name or 'all'
+   * \param console is level name (e.g. 'info')
+   * \param log is level name, or nullptr if same as console
+   * \returns false if module or level is unknown */
+  bool setLevel(const char * module, const char * console, const char * log);
+  /** modules (all files) */
+  static std::vector<UDiagModule *> & modules();
+  /** level from name, e.g. 'warn' gives WARN, -1 if unknown */
+  static int levelFromName(const char * name);
+
+private:
+  /** publish levels of all modules */
+  void publishLevels();
+  /** print and log a line */
+  void output(UDiagModule & module, int lvl, const char * msg);
+  std::mutex lock;
+  std::vector<UDiagSite *> pendingSites;
+  std::vector<UDiagModule *> pendingModules;
+  float rate = 5;
+  float burst = 20;
+  UMqttTopic topicDiag;
+  UMetricCounter * mShown = nullptr;
+  UMetricCounter * mSuppressed = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UDiag diag;
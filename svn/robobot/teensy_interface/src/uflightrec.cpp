@@ -0,0 +1,292 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "uflightrec.h"
+#include "uservice.h"
+#include "umqttrouter.h"
+#include "cmixer.h"
+#include "mvelocity.h"
+#include "ulooptimer.h"
+
+// create value
+UFlightRec flightrec;
+
+void UFlightRec::setup()
+{ // ensure default values
+  if (not ini.has("flightrec"))
+  { // no data yet, so generate some default values
+    ini["flightrec"]["enabled"] = "true";
+    // ring size (128 bytes each), rounded up to a power of 2
+    ini["flightrec"]["entries"] = "65536";
+    ini["flightrec"]["seconds"] = "10";
+    ini["flightrec"]["post_s"] = "0.5";
+    ini["flightrec"]["min_interval_s"] = "10";
+    ini["flightrec"]["stall_s"] = "1.0";
+  }
+  enabled = ini["flightrec"]["enabled"] == "true";
+  seconds = strtof(ini["flightrec"]["seconds"].c_str(), nullptr);
+  postSec = strtof(ini["flightrec"]["post_s"].c_str(), nullptr);
+  minInterval = strtof(ini["flightrec"]["min_interval_s"].c_str(), nullptr);
+  stallSec = strtof(ini["flightrec"]["stall_s"].c_str(), nullptr);
+  if (not enabled)
+    return;
+  if (ring == nullptr)
+  {
+    uint64_t n = 1024;
+    uint64_t entries = strtoull(ini["flightrec"]["entries"].c_str(), nullptr, 10);
+    while (n < entries)
+      n <<= 1;
+    ring = new UFlightEvent[n];
+    mask = n - 1;
+  }
+  mDumps = metrics.counter("flightrec_dumps_total", "Flight recorder dumps saved");
+  mEvents = metrics.counter("flightrec_events_total", "Events added to the flight recorder");
+  router.add(mqtt.root + "cmd/ti/flightrec", "flightrec",
+    [this](const char *, const char *, const char * payload, UTime &)
+    {
+      trigger(strlen(payload) > 0 ? payload : "mqtt");
+      return true;
+    });
+  signal(SIGUSR1, [](int) { flightrec.signalRequest = true; });
+  running = true;
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void UFlightRec::terminate()
+{
+  if (th1 != nullptr)
+  {
+    running = false;
+    th1->join();
+    delete th1;
+    th1 = nullptr;
+  }
+}
+
+UFlightEvent * UFlightRec::begin(Kind kind, const char * name, UTime & t, uint64_t & n)
+{
+  if (ring == nullptr)
+    return nullptr;
+  n = head.fetch_add(1, std::memory_order_relaxed);
+  UFlightEvent * e = &ring[n & mask];
+  e->seq.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  e->sec = t.getSec();
+  e->usec = t.getMicrosec();
+  e->name = name;
+  e->kind = kind;
+  return e;
+}
+
+void UFlightRec::add(Kind kind, const char * name, const char * text, const char * text2, UTime & t)
+{
+  uint64_t n;
+  UFlightEvent * e = begin(kind, name, t, n);
+  if (e == nullptr)
+    return;
+  int len = strnlen(text, UFlightEvent::MAX_TEXT);
+  // no newline
+  while (len > 0 and (text[len - 1] == '\n' or text[len - 1] == '\r'))
+    len--;
+  memcpy(e->text, text, len);
+  if (text2 != nullptr and len < UFlightEvent::MAX_TEXT - 1)
+  {
+    e->text[len++] = ' ';
+    int n2 = strnlen(text2, UFlightEvent::MAX_TEXT - len);
+    memcpy(&e->text[len], text2, n2);
+    len += n2;
+  }
+  e->len = len;
+  e->n = 0;
+  e->seq.store(2 * n + 2, std::memory_order_release);
+}
+
+void UFlightRec::values(const char * name, UTime & t, std::initializer_list<float> v)
+{
+  uint64_t n;
+  UFlightEvent * e = begin(VALUES, name, t, n);
+  if (e == nullptr)
+    return;
+  int i = 0;
+  for (float f : v)
+  {
+    if (i >= UFlightEvent::MAX_VALUES)
+      break;
+    e->v[i++] = f;
+  }
+  e->n = i;
+  e->len = 0;
+  e->seq.store(2 * n + 2, std::memory_order_release);
+}
+
+void UFlightRec::trigger(const char * reason)
+{
+  if (ring == nullptr)
+    return;
+  std::lock_guard<std::mutex> lock(triggerLock);
+  if (triggered)
+    // dump is pending already
+    return;
+  // reason is used in a filename
+  int i = 0;
+  for (const char * p1 = reason; *p1 != '\0' and i < MRL - 1; p1++)
+    triggerReason[i++] = (isalnum(*p1) or *p1 == '-') ? *p1 : '_';
+  triggerReason[i] = '\0';
+  triggerTime.now();
+  triggered = true;
+  // mark the trigger in the ring too
+  add(EVENT, "trigger", reason, nullptr, triggerTime);
+}
+
+void UFlightRec::run()
+{
+  uint64_t counted = 0;
+  int loop = 0;
+  ULoopTimer loopTimer;
+  loopTimer.setup("flightrec", 0.02);
+  while (running)
+  {
+    loopTimer.wait();
+    loop++;
+    if (signalRequest)
+    {
+      signalRequest = false;
+      trigger("signal");
+    }
+    checkFaults();
+    bool doDump = false;
+    const int MSL = MRL;
+    char reason[MSL];
+    UTime from;
+    {
+      std::lock_guard<std::mutex> lock(triggerLock);
+      if (triggered and triggerTime.getTimePassed() >= postSec)
+      {
+        triggered = false;
+        // not too many dumps of the same incident
+        doDump = not lastDump.valid or lastDump.getTimePassed() > minInterval;
+        strncpy(reason, triggerReason, MSL);
+        from = triggerTime - seconds;
+      }
+    }
+    if (doDump)
+    {
+      dump(reason, from);
+      lastDump.now();
+    }
+    if (loop % 50 == 0)
+    { // update event count every second
+      uint64_t h = head.load(std::memory_order_relaxed);
+      mEvents->inc(h - counted);
+      counted = h;
+    }
+  }
+}
+
+void UFlightRec::checkFaults()
+{ // wheels should run, but are not turning
+  bool stall = mixer.shouldWheelsBeRunning() and
+               fabsf(mvel[0].motorVel[0]) < 0.1 and fabsf(mvel[0].motorVel[1]) < 0.1;
+  if (not stall)
+  {
+    stalled = false;
+    stallStart.clear();
+  }
+  else if (not stallStart.valid)
+    stallStart.now();
+  else if (not stalled and stallStart.getTimePassed() > stallSec)
+  { // once for each stall
+    stalled = true;
+    trigger("motor_stall");
+  }
+}
+
+void UFlightRec::dump(const char * reason, UTime & from)
+{
+  UTime t("now");
+  std::string fn = service.logPath + "flightrec_" + t.getForFilename() + "_" + reason + ".txt";
+  FILE * f = fopen(fn.c_str(), "w");
+  if (f == nullptr)
+  {
+    printf("# UFlightRec:: failed to create %s\n", fn.c_str());
+    return;
+  }
+  fprintf(f, "%% Flight recorder dump, reason '%s'\n", reason);
+  fprintf(f, "%% 1 \tTime (sec)\n");
+  fprintf(f, "%% 2 \tKind: Rx (from Teensy), Tx (to Teensy), Mq (MQTT command), Va (values), Ev (event)\n");
+  fprintf(f, "%% 3 \tSource, e.g. T0\n");
+  fprintf(f, "%% 4 \tMessage or values, values are\n");
+  fprintf(f, "%%   \tmixer: linear velocity (m/s), turnrate (rad/s), desired left, right wheel velocity\n");
+  fprintf(f, "%%   \tmotorN: desired velocity m0, m1, measured velocity m0, m1, voltage m0, m1,\n");
+  fprintf(f, "%%   \t        control latency (ms), control period (ms)\n");
+  const char * kindName[KIND_CNT] = {"Rx", "Tx", "Mq", "Va", "Ev"};
+  uint64_t h = head.load(std::memory_order_acquire);
+  uint64_t n0 = 0;
+  if (h > mask + 1)
+    n0 = h - mask - 1;
+  int cnt = 0;
+  int lost = 0;
+  UFlightEvent e;
+  for (uint64_t n = n0; n < h; n++)
+  {
+    UFlightEvent & r = ring[n & mask];
+    uint64_t s1 = r.seq.load(std::memory_order_acquire);
+    if (s1 != 2 * n + 2)
+    { // overwritten or being written
+      lost++;
+      continue;
+    }
+    memcpy((char*)&e + sizeof(e.seq), (char*)&r + sizeof(r.seq), sizeof(e) - sizeof(e.seq));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (r.seq.load(std::memory_order_relaxed) != s1)
+    { // overwritten while copying
+      lost++;
+      continue;
+    }
+    if (e.sec < from.getSec() or (e.sec == from.getSec() and e.usec < from.getMicrosec()))
+      continue;
+    fprintf(f, "%u.%06u %s %s ", e.sec, e.usec, kindName[e.kind % KIND_CNT], e.name);
+    if (e.kind == VALUES)
+    {
+      for (int i = 0; i < e.n; i++)
+        fprintf(f, "%g ", e.v[i]);
+      fprintf(f, "\n");
+    }
+    else
+      fprintf(f, "%.*s\n", e.len, e.text);
+    cnt++;
+  }
+  fclose(f);
+  mDumps->inc();
+  printf("# UFlightRec:: saved %d events (%d overwritten) to %s\n", cnt, lost, fn.c_str());
+  if (service.logfile != nullptr)
+    fprintf(service.logfile, "%lu.%04ld Flight recorder saved %d events to %s\n",
+            t.getSec(), t.getMicrosec()/100, cnt, fn.c_str());
+}
@@ -0,0 +1,149 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <initializer_list>
+
+#include "utime.h"
+#include "umetrics.h"
+
+/**
+ * One flight recorder event (128 bytes).
+ * The event has either a text or up to MAX_VALUES values. */
+class UFlightEvent
+{
+public:
+  static const int MAX_TEXT = 100;
+  static const int MAX_VALUES = MAX_TEXT / 4;
+  /// odd while being written, 2 * (event number + 1) when written
+  std::atomic<uint64_t> seq{0};
+  uint32_t sec;
+  uint32_t usec;
+  /// source, e.g. 'T0' or 'motor0' (must be a static string)
+  const char * name;
+  uint8_t kind;
+  uint8_t n;
+  uint8_t len;
+  uint8_t spare;
+  union
+  {
+    char text[MAX_TEXT];
+    float v[MAX_VALUES];
+  };
+};
+
+/**
+ * Flight recorder: the newest events (Teensy messages, MQTT commands,
+ * control values and timing) are always kept in a fixed size ring in RAM,
+ * also when logging is off.
+ * The ring is saved to the log directory (flightrec_<time>_<reason>.txt) on
+ * - faults: Teensy connection lost, MQTT connection lost, master alive timeout,
+ *   or wheels commanded to run but not turning (motor stall),
+ * - signal SIGUSR1 (e.g. 'pkill -USR1 teensy_interfac'),
+ * - MQTT 'robobot/cmd/ti/flightrec' with the reason as payload.
+ * Adding an event is lock free (no waiting), and the dump is done by the
+ * flight recorder thread, including events until post_s after the trigger.
+ * ini [flightrec]: enabled, entries (ring size), seconds (before trigger
+ * to save), post_s, min_interval_s (between dumps), stall_s. */
+class UFlightRec
+{
+public:
+  /// event kinds
+  enum Kind {RX = 0, TX, MQTT, VALUES, EVENT, KIND_CNT};
+  /** setup and allocate the ring */
+  void setup();
+  /** stop the thread (the ring stays, other threads may still add) */
+  void terminate();
+  /**
+   * Add a text event (text is truncated to fit)
+   * \param kind is RX, TX, MQTT or EVENT
+   * \param name is the source (a static string, e.g. "T0")
+   * \param text is the message
+   * \param text2 is added after a space (e.g. MQTT payload), may be nullptr
+   * \param t is the time of the event */
+  void add(Kind kind, const char * name, const char * text, const char * text2, UTime & t);
+  /**
+   * Add a values event
+   * \param name is the source (a static string, e.g. "motor0")
+   * \param t is the time of the values
+   * \param v is the values */
+  void values(const char * name, UTime & t, std::initializer_list<float> v);
+  /**
+   * Request a dump of the ring (from any thread)
+   * \param reason is a short text used in the filename, e.g. "teensy_lost" */
+  void trigger(const char * reason);
+  /** flight recorder thread (dumps and fault checks) */
+  void run();
+  /// set by the SIGUSR1 handler
+  std::atomic<bool> signalRequest{false};
+
+private:
+  static void runObj(UFlightRec * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * Get an event slot, and mark it as being written
+   * \returns the slot or nullptr if not enabled */
+  UFlightEvent * begin(Kind kind, const char * name, UTime & t, uint64_t & n);
+  /**
+   * Save the events from 'from' to now
+   * \param reason is added to filename */
+  void dump(const char * reason, UTime & from);
+  /** check for faults that should trigger a dump */
+  void checkFaults();
+  UFlightEvent * ring = nullptr;
+  uint64_t mask = 0;
+  std::atomic<uint64_t> head{0};
+  bool enabled = false;
+  /// pending dump
+  std::mutex triggerLock;
+  static const int MRL = 32;
+  char triggerReason[MRL] = {'\0'};
+  UTime triggerTime;
+  bool triggered = false;
+  UTime lastDump;
+  /// settings
+  float seconds = 10;
+  float postSec = 0.5;
+  float minInterval = 10;
+  float stallSec = 1.0;
+  /// motor stall detect
+  UTime stallStart;
+  bool stalled = false;
+  std::thread * th1 = nullptr;
+  bool running = false;
+  UMetricCounter * mDumps = nullptr;
+  UMetricCounter * mEvents = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UFlightRec flightrec;
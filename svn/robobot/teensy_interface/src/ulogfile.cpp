@@ -0,0 +1,279 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "ulogfile.h"
+#include "uservice.h"
+#include "ulogstage.h"
+#include "udiag.h"
+
+static UDiagModule dg("logger");
+
+bool ULogFile::compress = false;
+int ULogFile::level = 3;
+uint64_t ULogFile::rotateBytes = 0;
+float ULogFile::rotateSeconds = 0;
+uint64_t ULogFile::diskBudget = 0;
+int ULogFile::deletedFiles = 0;
+std::set<std::string> ULogFile::openFiles;
+std::mutex ULogFile::openLock;
+
+
+void ULogFile::setup()
+{ // ensure default values
+  if (not ini["logger"].has("compress"))
+  { // compression and rotation of data logs
+    ini["logger"]["compress"] = "false";
+    ini["logger"]["compress_level"] = "3";
+    ini["logger"]["rotate_mb"] = "0";
+    ini["logger"]["rotate_minutes"] = "0";
+    // deleting old logs is opt-in
+    ini["logger"]["disk_budget_mb"] = "0";
+  }
+  compress = ini["logger"]["compress"] == "true";
+  level = strtol(ini["logger"]["compress_level"].c_str(), nullptr, 10);
+  if (level < 1 or level > 9)
+    level = 3;
+  rotateBytes = strtof(ini["logger"]["rotate_mb"].c_str(), nullptr) * 1e6;
+  rotateSeconds = strtof(ini["logger"]["rotate_minutes"].c_str(), nullptr) * 60;
+  diskBudget = strtof(ini["logger"]["disk_budget_mb"].c_str(), nullptr) * 1e6;
+}
+
+bool ULogFile::open(std::string fileName, std::string fileHeader)
+{
+  name = fileName;
+  header = fileHeader;
+  segment = 0;
+  return openSegment();
+}
+
+bool ULogFile::openSegment()
+{
+  close();
+  segmentName = name;
+  if (rotateBytes > 0 or rotateSeconds > 0)
+  { // e.g. log_enc.txt -> log_enc_000.txt
+    const int MSL = 20;
+    char s[MSL];
+    snprintf(s, MSL, "_%03d", segment++);
+    size_t n = segmentName.rfind('.');
+    if (n == std::string::npos or n < segmentName.rfind('/') + 1)
+      n = segmentName.size();
+    segmentName.insert(n, s);
+  }
+  if (compress)
+  {
+    segmentName += ".gz";
+    const int MSL = 10;
+    char mode[MSL];
+    snprintf(mode, MSL, "wb%d", level);
+    gz = gzopen(segmentName.c_str(), mode);
+  }
+  else
+    plain = fopen(segmentName.c_str(), "w");
+  if (not isOpen())
+  {
+    printf("# ULogFile:: failed to open %s\n", segmentName.c_str());
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(openLock);
+    openFiles.insert(std::filesystem::path(segmentName).filename().string());
+  }
+  bytes = 0;
+  opened.now();
+  if (not header.empty())
+  {
+    if (gz != nullptr)
+      gzwrite(gz, header.data(), header.size());
+    else
+      fwrite(header.data(), 1, header.size(), plain);
+    bytes = header.size();
+  }
+  return true;
+}
+
+void ULogFile::addHeader(const char* data, int n)
+{
+  header.append(data, n);
+  if (gz != nullptr)
+    gzwrite(gz, data, n);
+  else if (plain != nullptr)
+    fwrite(data, 1, n, plain);
+  bytes += n;
+}
+
+void ULogFile::write(const char* data, int n)
+{
+  if (not isOpen())
+    return;
+  if ((rotateBytes > 0 and bytes + n > rotateBytes and bytes > header.size()) or
+      (rotateSeconds > 0 and opened.getTimePassed() > rotateSeconds))
+  { // start a new segment
+    if (not openSegment())
+      return;
+  }
+  if (gz != nullptr)
+    gzwrite(gz, data, n);
+  else
+    fwrite(data, 1, n, plain);
+  bytes += n;
+}
+
+void ULogFile::close()
+{
+  if (gz != nullptr)
+  {
+    gzclose(gz);
+    gz = nullptr;
+  }
+  if (plain != nullptr)
+  {
+    fclose(plain);
+    plain = nullptr;
+  }
+  if (not segmentName.empty())
+  {
+    std::lock_guard<std::mutex> lock(openLock);
+    openFiles.erase(std::filesystem::path(segmentName).filename().string());
+  }
+}
+
+bool ULogFile::isRunDir(const std::string & name, const std::string & prefix, const std::string & suffix)
+{ // <prefix>YYYYMMDD_HHMMSS.mmm<suffix>, as made by UTime::getForFilename()
+  const char * date = "dddddddd_dddddd.ddd";
+  int dl = strlen(date);
+  if (name.size() != prefix.size() + dl + suffix.size())
+    return false;
+  if (name.compare(0, prefix.size(), prefix) != 0 or
+      name.compare(prefix.size() + dl, suffix.size(), suffix) != 0)
+    return false;
+  for (int i = 0; i < dl; i++)
+  {
+    char c = name[prefix.size() + i];
+    if (date[i] == 'd' ? not isdigit(c) : c != date[i])
+      return false;
+  }
+  return true;
+}
+
+uint64_t ULogFile::limitDiskUse()
+{
+  namespace fs = std::filesystem;
+  // log directories are named as logpath, e.g. 'log_%d/'
+  std::string logpath = ini["service"]["logpath"];
+  while (not logpath.empty() and logpath.back() == '/')
+    logpath.pop_back();
+  // on the SD card (service.logPath may be a RAM disk)
+  std::string storage = logstage.storagePath;
+  if (storage.empty())
+    storage = service.logPath;
+  if (storage.empty())
+    return 0;
+  fs::path thisRun = fs::absolute(storage).lexically_normal();
+  if (not thisRun.has_filename())
+    thisRun = thisRun.parent_path();
+  int n = logpath.find("%d");
+  std::string prefix;
+  std::string suffix;
+  if (n > 0)
+  { // e.g. 'log_' and '' from 'log_%d'
+    prefix = fs::path(logpath.substr(0, n)).filename().string();
+    suffix = logpath.substr(n + 2);
+  }
+  // all runs, or this run only (no date in logpath)
+  bool allRuns = n > 0 and not prefix.empty();
+  fs::path base = thisRun.parent_path();
+  if (allRuns)
+    base = fs::absolute(logpath).parent_path();
+  //
+  class UFile
+  {
+  public:
+    fs::path path;
+    fs::file_time_type time;
+    uint64_t size;
+  };
+  std::vector<UFile> files;
+  uint64_t total = 0;
+  std::error_code e;
+  for (auto & d : fs::directory_iterator(base, e))
+  {
+    if (not d.is_directory(e))
+      continue;
+    std::string dn = d.path().filename().string();
+    if (allRuns and not isRunDir(dn, prefix, suffix))
+      continue;
+    bool current = fs::absolute(d.path()).lexically_normal() == thisRun;
+    if (not allRuns and not current)
+      continue;
+    for (auto & f : fs::directory_iterator(d.path(), e))
+    {
+      if (not f.is_regular_file(e))
+        continue;
+      uint64_t sz = f.file_size(e);
+      total += sz;
+      if (current)
+      { // only rotated segments that are closed
+        std::string fn = f.path().filename().string();
+        size_t m = fn.find('.');
+        bool isSegment = m != std::string::npos and m >= 4 and fn[m - 4] == '_' and
+                         isdigit(fn[m - 3]) and isdigit(fn[m - 2]) and isdigit(fn[m - 1]);
+        if (not isSegment)
+          continue;
+        std::lock_guard<std::mutex> lock(openLock);
+        if (openFiles.count(fn) > 0)
+          continue;
+      }
+      files.push_back({f.path(), f.last_write_time(e), sz});
+    }
+  }
+  if (diskBudget == 0 or total <= diskBudget)
+    return total;
+  // oldest first
+  std::sort(files.begin(), files.end(), [](const UFile & a, const UFile & b)
+  {
+    return a.time < b.time;
+  });
+  for (auto & f : files)
+  {
+    if (total <= diskBudget)
+      break;
+    if (fs::remove(f.path, e))
+    {
+      DIAG(dg, UDiag::WARN, "# ULogFile:: disk budget %.0f MB: deleted %s (%.1f MB)\n",
+           diskBudget / 1e6, f.path.c_str(), f.size / 1e6);
+      total -= f.size;
+      deletedFiles++;
+      // remove directory too, if empty
+      fs::path dir = f.path.parent_path();
+      if (fs::is_empty(dir, e) and fs::absolute(dir).lexically_normal() != thisRun)
+        fs::remove(dir, e);
+    }
+  }
+  return total;
+}
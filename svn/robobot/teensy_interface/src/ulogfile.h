@@ -0,0 +1,110 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <set>
+#include <mutex>
+#include <zlib.h>
+
+#include "utime.h"
+
+/**
+ * Output file for the logger (used by the logger thread only).
+ * The file can be gzip compressed and rotated by size or time,
+ * a rotated file is named e.g. log_enc_003.txt.gz (segment 3).
+ * All segments start with the same header, so each can be used alone.
+ * Use 'zcat' or log_convert.py to get the text. */
+class ULogFile
+{
+public:
+  /**
+   * Open the (first segment of) the file
+   * \param name is the logfile name, e.g. log_xxx/log_enc.txt
+   * \param header is written at the start of every segment
+   * \returns true if opened */
+  bool open(std::string name, std::string header);
+  /**
+   * Add to the header (and write it to the current segment) */
+  void addHeader(const char * data, int n);
+  /**
+   * Write data, rotate if segment is full or too old */
+  void write(const char * data, int n);
+  /** close the current segment */
+  void close();
+  bool isOpen()
+  {
+    return gz != nullptr or plain != nullptr;
+  }
+  /**
+   * Read ini settings (section [logger]) */
+  static void setup();
+  /**
+   * Delete the oldest log files, until the total size
+   * of all log directories is within the disk budget.
+   * Files that are open are not deleted, and for this run only
+   * rotated segments are deleted.
+   * Only directories named as the logpath with a date, e.g.
+   * 'log_20250131_145940.242', are counted (and cleaned).
+   * \returns bytes used by log files */
+  static uint64_t limitDiskUse();
+  /**
+   * Test if a directory name is a log directory for a run,
+   * i.e. prefix, date as from UTime::getForFilename() and suffix.
+   * \param name is the directory name (no path)
+   * \param prefix is the part of logpath before '%d', e.g. 'log_'
+   * \param suffix is the part of logpath after '%d' (no '/')
+   * \returns true if it matches */
+  static bool isRunDir(const std::string & name, const std::string & prefix, const std::string & suffix);
+  /// compress using gzip
+  static bool compress;
+  /// compression level (1 fast .. 9 small)
+  static int level;
+  /// rotate after this many (uncompressed) bytes (0 = no)
+  static uint64_t rotateBytes;
+  /// rotate after this time (sec) (0 = no)
+  static float rotateSeconds;
+  /// max bytes for all log directories (0 = no limit, nothing is deleted)
+  static uint64_t diskBudget;
+  /// files deleted to stay within the budget
+  static int deletedFiles;
+
+private:
+  /** open next segment */
+  bool openSegment();
+  std::string name;
+  std::string header;
+  /// segment number, used when rotating only
+  int segment = 0;
+  gzFile gz = nullptr;
+  FILE * plain = nullptr;
+  /// current segment
+  std::string segmentName;
+  uint64_t bytes = 0;
+  UTime opened;
+  /// file names (without path) of open segments (not to be deleted)
+  static std::set<std::string> openFiles;
+  static std::mutex openLock;
+};
@@ -0,0 +1,510 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <time.h>
+
+#include "ulogger.h"
+#include "uservice.h"
+#include "ulooptimer.h"
+
+// create value
+ULogger logger;
+
+/**
+ * Ring of records from one thread */
+class ULogRing
+{
+public:
+  static const uint32_t SIZE = 512;
+  ULogRecord rec[SIZE];
+  /// written by producer
+  std::atomic<uint32_t> head{0};
+  /// written by logger thread
+  std::atomic<uint32_t> tail{0};
+};
+
+/// all rings (only added to)
+static std::vector<ULogRing *> rings;
+static std::mutex ringLock;
+/// the ring of this thread
+static thread_local ULogRing * myRing = nullptr;
+
+
+void ULogger::setup()
+{ // ensure default values
+  if (not ini.has("logger"))
+  { // no data yet, so generate some default values
+    ini["logger"]["binary"] = "false";
+  }
+  binary = ini["logger"]["binary"] == "true";
+  if (not ini["logger"].has("columnar"))
+    // data logs in columnar files (.ulc)
+    ini["logger"]["columnar"] = "false";
+  columnar = ini["logger"]["columnar"] == "true";
+  // compression, rotation and disk budget
+  ULogFile::setup();
+  mRecords = metrics.counter("logger_records_total", "Log lines written by the logger");
+  mDropped = metrics.counter("logger_dropped_total", "Log lines dropped (ring full)");
+  mDrain = metrics.histogram("logger_drain_seconds", "Time to write queued log lines");
+  mDiskBytes = metrics.gauge("logger_disk_bytes", "Size of all log directories");
+  mDeleted = metrics.counter("logger_deleted_files_total", "Old logfiles deleted to keep the disk budget");
+  if (binary and not binFile.isOpen())
+  { // magic and version, stream definitions are added as header too
+    std::string fn = service.logPath + "log_binary.bin";
+    const uint32_t version = 1;
+    std::string hdr = "ULOG";
+    hdr.append((const char *)&version, sizeof(version));
+    binFile.open(fn, hdr);
+  }
+  running = true;
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void ULogger::terminate()
+{
+  if (th1 != nullptr)
+  {
+    running = false;
+    th1->join();
+    delete th1;
+    th1 = nullptr;
+    // the rest
+    drain();
+    for (int i = 0; i < streamCnt; i++)
+    {
+      if (streams[i]->col != nullptr)
+        streams[i]->col->close();
+      if (streams[i]->out != nullptr)
+        streams[i]->out->close();
+      else if (streams[i]->file != nullptr)
+        fflush(streams[i]->file);
+    }
+  }
+  binFile.close();
+}
+
+ULogStream * ULogger::stream(FILE * file, std::string fileName, const char * format, int timeDecimals)
+{
+  if (file == nullptr)
+    return nullptr;
+  std::lock_guard<std::mutex> lock(streamLock);
+  int n = streamCnt;
+  if (n >= MAX_STREAMS)
+  {
+    printf("# ULogger:: too many log streams (max %d), %s not logged\n", MAX_STREAMS, fileName.c_str());
+    return nullptr;
+  }
+  ULogStream * s = new ULogStream();
+  s->id = n;
+  s->file = file;
+  s->fileName = fileName;
+  s->format = format;
+  s->timeDecimals = timeDecimals;
+  // split format into one conversion each
+  const char * p1 = format;
+  std::string seg;
+  while (*p1 != '\0')
+  {
+    if (*p1 != '%' or p1[1] == '%')
+    { // literal
+      seg += *p1;
+      if (*p1 == '%')
+        seg += *++p1;
+      p1++;
+      continue;
+    }
+    // conversion, e.g. %.3f or %lu
+    seg += *p1++;
+    int longs = 0;
+    while (*p1 != '\0' and strchr("diouxXcsfFeEgGaA", *p1) == nullptr)
+    {
+      if (*p1 == 'l')
+        longs++;
+      seg += *p1++;
+    }
+    char c = *p1;
+    if (c == '\0')
+      break;
+    seg += *p1++;
+    char type = 'i';
+    if (strchr("fFeEgGaA", c) != nullptr)
+      type = 'd';
+    else if (c == 's')
+      type = 's';
+    else if (longs == 1)
+      type = 'l';
+    else if (longs > 1)
+      type = 'L';
+    s->segment.push_back({seg, type});
+    seg.clear();
+  }
+  if (not seg.empty())
+    // trailing text (e.g. newline)
+    s->segment.push_back({seg, '-'});
+  bool hasText = false;
+  int values = 0;
+  for (auto & sg : s->segment)
+  {
+    hasText |= sg.type == 's';
+    values += sg.type != '-';
+  }
+  if (not binary and columnar and not hasText)
+  { // columnar file, opened when the value types are known (first record)
+    fflush(file);
+    std::ifstream f(fileName);
+    std::stringstream hdr;
+    hdr << f.rdbuf();
+    s->header = hdr.str();
+    s->col = new UColumnLog();
+    s->colName = fileName;
+    size_t m = s->colName.rfind(".txt");
+    if (m != std::string::npos)
+      s->colName.erase(m);
+    s->colName += ".ulc";
+    s->values = values;
+  }
+  else if (not binary and (ULogFile::compress or ULogFile::rotateBytes > 0 or ULogFile::rotateSeconds > 0))
+  { // the logger writes the file, move the header from the logfile
+    fflush(file);
+    std::ifstream f(fileName);
+    std::stringstream hdr;
+    hdr << f.rdbuf();
+    s->out = new ULogFile();
+    if (s->out->open(fileName, hdr.str()))
+      unlink(fileName.c_str());
+    else
+    { // use the logfile as is
+      delete s->out;
+      s->out = nullptr;
+    }
+  }
+  streams[n] = s;
+  streamCnt = n + 1;
+  return s;
+}
+
+ULogRecord * ULogger::reserve()
+{
+  if (not running)
+    return nullptr;
+  if (myRing == nullptr)
+  { // first log from this thread
+    myRing = new ULogRing();
+    std::lock_guard<std::mutex> lock(ringLock);
+    rings.push_back(myRing);
+  }
+  uint32_t h = myRing->head.load(std::memory_order_relaxed);
+  while (h - myRing->tail.load(std::memory_order_acquire) >= ULogRing::SIZE)
+  { // logger is behind
+    if (not waitWhenFull or not running)
+    {
+      mDropped->inc();
+      return nullptr;
+    }
+    usleep(1000);
+  }
+  return &myRing->rec[h % ULogRing::SIZE];
+}
+
+void ULogger::commit()
+{
+  myRing->head.fetch_add(1, std::memory_order_release);
+}
+
+std::string ULogger::toText(ULogStream * s, ULogRecord & r)
+{
+  const int MSL = 400;
+  char buf[MSL];
+  if (s->timeDecimals == 3)
+    snprintf(buf, MSL, "%u.%03u ", r.sec, r.usec / 1000);
+  else
+    snprintf(buf, MSL, "%u.%04u ", r.sec, r.usec / 100);
+  std::string line = buf;
+  int k = 0;
+  for (auto & seg : s->segment)
+  {
+    if (seg.type == '-')
+    {
+      line += seg.fmt;
+      continue;
+    }
+    // get value as the stored kind
+    int kind = (r.kinds >> (2 * k)) & 3;
+    double d = 0;
+    int64_t i = 0;
+    const char * txt = "";
+    if (k < r.n)
+    {
+      if (kind == ULogRecord::KIND_DOUBLE)
+      {
+        d = r.value[k].d;
+        i = d;
+      }
+      else if (kind == ULogRecord::KIND_TEXT)
+        txt = r.text;
+      else
+      {
+        i = r.value[k].i;
+        d = i;
+      }
+    }
+    k++;
+    // and print as the format needs
+    switch (seg.type)
+    {
+      case 'd': snprintf(buf, MSL, seg.fmt.c_str(), d); break;
+      case 's': snprintf(buf, MSL, seg.fmt.c_str(), txt); break;
+      case 'l': snprintf(buf, MSL, seg.fmt.c_str(), (long)i); break;
+      case 'L': snprintf(buf, MSL, seg.fmt.c_str(), (long long)i); break;
+      default:  snprintf(buf, MSL, seg.fmt.c_str(), (int)i); break;
+    }
+    line += buf;
+  }
+  return line;
+}
+
+void ULogger::writeDefinitions()
+{ // definition: 0xffff, length, then 'id\tfilename\ttimeDecimals\tformat'
+  int n = streamCnt;
+  while (streamsDefined < n)
+  {
+    ULogStream * s = streams[streamsDefined++];
+    std::string def = std::to_string(s->id) + "\t" + s->fileName + "\t" +
+                      std::to_string(s->timeDecimals) + "\t" + s->format;
+    uint16_t h[2] = {0xffff, (uint16_t)def.size()};
+    binFile.addHeader((const char *)h, sizeof(h));
+    binFile.addHeader(def.c_str(), def.size());
+  }
+}
+
+void ULogger::write(ULogRecord & r)
+{
+  if (binary)
+  { // header, used values and text only
+    if (binFile.isOpen())
+    { // in one write, so that a record is not split by rotation
+      const int MBL = 16 + sizeof(r.value) + sizeof(r.text);
+      char buf[MBL];
+      int n = 16 + sizeof(r.value[0]) * r.n;
+      memcpy(buf, &r, n);
+      memcpy(&buf[n], r.text, r.textLen);
+      binFile.write(buf, n + r.textLen);
+    }
+  }
+  else if (r.stream < streamCnt)
+  {
+    ULogStream * s = streams[r.stream];
+    if (s->col != nullptr)
+    {
+      writeColumns(s, r);
+      return;
+    }
+    std::string line = toText(s, r);
+    if (s->out != nullptr)
+      s->out->write(line.c_str(), line.size());
+    else
+      fputs(line.c_str(), s->file);
+  }
+}
+
+void ULogger::writeColumns(ULogStream * s, ULogRecord & r)
+{
+  if (not s->col->isOpen())
+  { // first record, so value types are known
+    std::vector<uint8_t> types;
+    for (int k = 0; k < s->values; k++)
+    {
+      int kind = (r.kinds >> (2 * k)) & 3;
+      types.push_back(kind == ULogRecord::KIND_DOUBLE ? UColumnLog::TYPE_DOUBLE : UColumnLog::TYPE_INT);
+    }
+    std::vector<std::string> names = UColumnLog::namesFromHeader(s->header, s->values);
+    if (not s->col->open(s->colName, s->header, types, names))
+    { // write as text then
+      printf("# ULogger:: failed to create %s\n", s->colName.c_str());
+      delete s->col;
+      s->col = nullptr;
+      return;
+    }
+  }
+  s->col->add(r.sec + r.usec * 1e-6, (const UColumnValue *)r.value, r.n);
+}
+
+int ULogger::drain()
+{
+  int cnt = 0;
+  if (binFile.isOpen())
+    writeDefinitions();
+  std::vector<ULogRing *> rs;
+  {
+    std::lock_guard<std::mutex> lock(ringLock);
+    rs = rings;
+  }
+  // a logfile may have more producer threads (e.g. the Teensy io log),
+  // so merge the queued records from all rings in time order
+  const int n = rs.size();
+  std::vector<uint32_t> tail(n);
+  std::vector<uint32_t> head(n);
+  for (int i = 0; i < n; i++)
+  {
+    tail[i] = rs[i]->tail.load(std::memory_order_relaxed);
+    head[i] = rs[i]->head.load(std::memory_order_acquire);
+  }
+  while (true)
+  { // oldest record first (the first ring if same time)
+    int oldest = -1;
+    ULogRecord * ro = nullptr;
+    for (int i = 0; i < n; i++)
+    {
+      if (tail[i] == head[i])
+        continue;
+      ULogRecord * r = &rs[i]->rec[tail[i] % ULogRing::SIZE];
+      if (ro == nullptr or r->sec < ro->sec or (r->sec == ro->sec and r->usec < ro->usec))
+      {
+        oldest = i;
+        ro = r;
+      }
+    }
+    if (ro == nullptr)
+      break;
+    write(*ro);
+    tail[oldest]++;
+    cnt++;
+  }
+  for (int i = 0; i < n; i++)
+    rs[i]->tail.store(tail[i], std::memory_order_release);
+  return cnt;
+}
+
+void ULogger::run()
+{
+  UTime diskCheck("now");
+  int deleted = 0;
+  ULoopTimer loopTimer;
+  loopTimer.setup("logger", 0.02);
+  while (running)
+  {
+    if (diskCheck.getTimePassed() > 10)
+    { // keep within disk budget
+      diskCheck.now();
+      mDiskBytes->set(ULogFile::limitDiskUse());
+      mDeleted->inc(ULogFile::deletedFiles - deleted);
+      deleted = ULogFile::deletedFiles;
+    }
+    UTime t("now");
+    int n = drain();
+    if (n > 0)
+    {
+      mRecords->inc(n);
+      mDrain->observeSince(t);
+    }
+    loopTimer.wait();
+  }
+}
+
+void ULogger::benchmark(float seconds)
+{ // the same Teensy io line, every other line direct or using the logger,
+  // so that both see the same disk load
+  std::string fnd = service.logPath + "log_bench_direct.txt";
+  std::string fnl = service.logPath + "log_bench_logger.txt";
+  std::string fnLoad = service.logPath + "log_bench_load.bin";
+  FILE * fd = fopen(fnd.c_str(), "w");
+  FILE * fl = fopen(fnl.c_str(), "w");
+  if (fd == nullptr or fl == nullptr or not running)
+  {
+    printf("# ULogger::benchmark: failed to open logfiles in '%s' (or logger not running)\n", service.logPath.c_str());
+    return;
+  }
+  fprintf(fl, "%% Logger benchmark, Teensy io lines using the logger\n");
+  ULogStream * ls = stream(fl, fnl, "%s");
+  std::mutex directLock;
+  // disk load: write and sync 256kB every 50ms
+  std::atomic<bool> loadRunning{true};
+  std::thread load([&]()
+  {
+    int f = open(fnLoad.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::vector<char> b(256 * 1024, 'x');
+    while (loadRunning and f >= 0)
+    {
+      if (::write(f, b.data(), b.size()) < 0)
+        break;
+      fsync(f);
+      usleep(50000);
+    }
+    if (f >= 0)
+      close(f);
+  });
+  const char * msg = ";42enc 1234.5678 123456 -123456 0.1234 0.4567\n";
+  std::vector<float> dt[2];
+  UTime start("now");
+  // first line allocates the ring for this thread, so not timed
+  ls->log(start, "## start\n");
+  fprintf(fd, "%lu.%04ld ## start\n", start.getSec(), start.getMicrosec()/100);
+  int i = 0;
+  while (start.getTimePassed() < seconds)
+  {
+    UTime t("now");
+    timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    if (i % 2 == 0)
+    { // as the old io log
+      std::lock_guard<std::mutex> lock(directLock);
+      fprintf(fd, "%lu.%04ld Rx %s", t.getSec(), t.getMicrosec()/100, msg);
+    }
+    else
+    { // as STeensy::toIoLog
+      char s[ULogRecord::MAX_TEXT];
+      snprintf(s, ULogRecord::MAX_TEXT, "Rx %s", msg);
+      ls->log(t, s);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    dt[i % 2].push_back((b.tv_sec - a.tv_sec) * 1e6 + (b.tv_nsec - a.tv_nsec) * 1e-3);
+    i++;
+    // about 1kHz of each
+    usleep(500);
+  }
+  loadRunning = false;
+  load.join();
+  fclose(fd);
+  unlink(fnLoad.c_str());
+  printf("# ULogger::benchmark: time to log one Teensy io line (us), %.1f sec, with disk load\n", seconds);
+  printf("# %-8s %8s %8s %8s %8s %8s %8s\n", "path", "lines", "p50", "p99", "p99.9", "max", "dropped");
+  const char * name[2] = {"direct", "logger"};
+  for (int k = 0; k < 2; k++)
+  {
+    std::vector<float> & v = dt[k];
+    if (v.empty())
+      continue;
+    std::sort(v.begin(), v.end());
+    auto q = [&v](float p) { return v[std::min(v.size() - 1, size_t(p * v.size()))]; };
+    printf("# %-8s %8d %8.1f %8.1f %8.1f %8.1f %8s\n", name[k], (int)v.size(),
+           q(0.5), q(0.99), q(0.999), v.back(),
+           k == 0 ? "-" : std::to_string((long long)mDropped->get()).c_str());
+  }
+}
@@ -0,0 +1,239 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <string.h>
+
+#include "utime.h"
+#include "umetrics.h"
+#include "ulogfile.h"
+#include "ucolumnlog.h"
+
+/**
+ * One log line as a fixed binary record.
+ * Values are 64 bit integers or doubles (2 bits in 'kinds' for each),
+ * one value can be a text (e.g. a Teensy message). */
+class ULogRecord
+{
+public:
+  static const int MAX_VALUES = 16;
+  static const int MAX_TEXT = 240;
+  /// value kinds (2 bits each)
+  enum {KIND_INT = 0, KIND_DOUBLE = 1, KIND_TEXT = 2};
+  uint16_t stream;
+  uint8_t n;
+  uint8_t textLen;
+  uint32_t kinds;
+  uint32_t sec;
+  uint32_t usec;
+  union
+  {
+    int64_t i;
+    double d;
+  } value[MAX_VALUES];
+  char text[MAX_TEXT];
+  /** add a value */
+  template<typename T>
+  void put(T v)
+  {
+    if (n >= MAX_VALUES)
+      return;
+    int k = n++;
+    if constexpr (std::is_floating_point_v<T>)
+    {
+      value[k].d = v;
+      kinds |= KIND_DOUBLE << (2 * k);
+    }
+    else if constexpr (std::is_integral_v<T> or std::is_enum_v<T>)
+      value[k].i = (int64_t)v;
+    else
+    { // text
+      const char * s;
+      if constexpr (std::is_same_v<T, std::string>)
+        s = v.c_str();
+      else
+        s = v;
+      int m = strnlen(s, MAX_TEXT - 1);
+      memcpy(text, s, m);
+      text[m] = '\0';
+      textLen = m + 1;
+      kinds |= KIND_TEXT << (2 * k);
+    }
+  }
+};
+
+/**
+ * A log (file) using the logger.
+ * The header of the logfile is written by the owner (as before),
+ * log lines are queued by log(..) and written by the logger thread. */
+class ULogStream
+{
+public:
+  /**
+   * Queue a log line
+   * \param t is the time (first column)
+   * \param args are the values as in the format given to ULogger::stream(..) */
+  template<typename... Args>
+  void log(UTime & t, Args... args);
+  //
+  int id = 0;
+  FILE * file = nullptr;
+  /// compressed and/or rotated output (else file is used)
+  ULogFile * out = nullptr;
+  /// columnar output (else text)
+  UColumnLog * col = nullptr;
+  std::string colName;
+  /// logfile header (for columnar file)
+  std::string header;
+  /// values in a record
+  int values = 0;
+  std::string fileName;
+  /// format for values (after the time), e.g. "%.3f %d\n"
+  std::string format;
+  /// decimals in time column (3 or 4)
+  int timeDecimals = 4;
+  /// format split into one conversion each
+  class USegment
+  {
+  public:
+    std::string fmt;
+    /// argument type: 'i' int, 'l' long, 'L' long long, 'd' double, 's' text, '-' no argument
+    char type;
+  };
+  std::vector<USegment> segment;
+};
+
+/**
+ * Asynchronous logger.
+ * Producer threads write fixed binary records into their own
+ * lock-free ring (one producer, one consumer), the logger thread
+ * merges the rings in time order and writes them to disk,
+ * so a slow SD card does not delay the data path.
+ * With [logger] binary=false (default) the log lines are written as text
+ * to the same files as before. With binary=true all records go to
+ * log_binary.bin, and log_convert.py adds the text lines to the logfiles
+ * (that already have the header).
+ * With compress or rotation (see ULogFile) the logger writes the files
+ * (including the header), and the oldest logfiles are deleted
+ * to keep within the disk budget.
+ * With columnar=true the data (not text) is written to a columnar
+ * file (e.g. log_t0_encoder.ulc, see UColumnLog), the header stays in the text log. */
+class ULogger
+{
+public:
+  /** setup and start writer thread */
+  void setup();
+  /**
+   * Write all queued and stop the writer thread */
+  void terminate();
+  /**
+   * Make a log stream for a logfile
+   * \param file is the open logfile (header is written by the caller)
+   * \param fileName is the logfile name
+   * \param format is the printf format for the values after the time, e.g. "%.3f %d\n"
+   * \param timeDecimals is decimals of the time column
+   * \returns the stream or nullptr if file is nullptr */
+  ULogStream * stream(FILE * file, std::string fileName, const char * format, int timeDecimals = 4);
+  /**
+   * Get a free record in this threads ring
+   * \returns nullptr if full (or not running) */
+  ULogRecord * reserve();
+  /**
+   * The record from reserve() is ready */
+  void commit();
+  /**
+   * writer thread */
+  void run();
+  /**
+   * Benchmark (command line option --log-bench): time to log a Teensy io line
+   * directly (fprintf, as the io log before the logger) and using the logger.
+   * Other threads load the disk, as on a busy SD card.
+   * Result (percentiles of the time for one log call) is printed.
+   * \param seconds is the duration of the test */
+  void benchmark(float seconds);
+  /// wait for space in ring, rather than drop the log line (replay)
+  bool waitWhenFull = false;
+
+private:
+  static void runObj(ULogger * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * Write queued records from all rings, merged in time order
+   * \returns number of records written */
+  int drain();
+  void write(ULogRecord & r);
+  /** format a record as text line */
+  std::string toText(ULogStream * s, ULogRecord & r);
+  /** write record to columnar file */
+  void writeColumns(ULogStream * s, ULogRecord & r);
+  /** write stream definitions to binary file */
+  void writeDefinitions();
+  static const int MAX_STREAMS = 64;
+  ULogStream * streams[MAX_STREAMS] = {nullptr};
+  std::atomic<int> streamCnt{0};
+  int streamsDefined = 0;
+  std::mutex streamLock;
+  std::atomic<bool> running{false};
+  bool binary = false;
+  bool columnar = false;
+  ULogFile binFile;
+  std::thread * th1 = nullptr;
+  UMetricCounter * mRecords = nullptr;
+  UMetricCounter * mDropped = nullptr;
+  UMetricHistogram * mDrain = nullptr;
+  UMetricGauge * mDiskBytes = nullptr;
+  UMetricCounter * mDeleted = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern ULogger logger;
+
+template<typename... Args>
+void ULogStream::log(UTime & t, Args... args)
+{
+  ULogRecord * r = logger.reserve();
+  if (r == nullptr)
+    return;
+  r->stream = id;
+  r->n = 0;
+  r->textLen = 0;
+  r->kinds = 0;
+  r->sec = t.getSec();
+  r->usec = t.getMicrosec();
+  (r->put(args), ...);
+  logger.commit();
+}
+
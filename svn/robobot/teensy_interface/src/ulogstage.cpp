@@ -0,0 +1,260 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ulogstage.h"
+#include "uservice.h"
+#include "cmixer.h"
+#include "ulooptimer.h"
+
+// create value
+ULogStage logstage;
+
+
+std::string ULogStage::path(std::string storage)
+{
+  namespace fs = std::filesystem;
+  storagePath = storage;
+  if (not ini["logger"].has("stage"))
+  { // logfiles in RAM disk, copied to SD card by a thread
+    ini["logger"]["stage"] = "true";
+    ini["logger"]["stage_path"] = "/dev/shm/teensy_interface/";
+    ini["logger"]["stage_flush_s"] = "10";
+    ini["logger"]["stage_chunk_mb"] = "1";
+    ini["logger"]["stage_idle_flush_s"] = "2";
+  }
+  flushInterval = strtof(ini["logger"]["stage_flush_s"].c_str(), nullptr);
+  chunkBytes = strtof(ini["logger"]["stage_chunk_mb"].c_str(), nullptr) * 1e6;
+  idleInterval = strtof(ini["logger"]["stage_idle_flush_s"].c_str(), nullptr);
+  if (ini["logger"]["stage"] != "true")
+    return storage;
+  std::string dir = ini["logger"]["stage_path"];
+  if (not dir.empty() and dir.back() != '/')
+    dir += "/";
+  fs::path sp = fs::absolute(storage).lexically_normal();
+  if (not sp.has_filename())
+    sp = sp.parent_path();
+  std::string name = sp.filename().string();
+  std::error_code e;
+  fs::create_directories(dir + name, e);
+  if (e)
+  {
+    printf("# ULogStage:: failed to create %s%s (%s), logs not staged\n", dir.c_str(), name.c_str(), e.message().c_str());
+    return storage;
+  }
+  // left by a crash
+  recover(dir, sp.parent_path().string() + "/", name);
+  stagePath = dir + name + "/";
+  staged = true;
+  printf("# ULogStage:: logfiles staged in %s, copied to %s every %gs "
+         "(on power loss, logs since last copy are lost)\n",
+         stagePath.c_str(), storagePath.c_str(), flushInterval);
+  return stagePath;
+}
+
+void ULogStage::setup()
+{
+  if (not staged)
+    return;
+  mPending = metrics.gauge("logger_stage_pending_bytes", "Staged log data not yet on SD card (lost on power loss)");
+  mFlushed = metrics.counter("logger_stage_flushed_bytes_total", "Log data copied to SD card");
+  mFlushTime = metrics.histogram("logger_stage_flush_seconds", "Time to copy staged logs to SD card");
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void ULogStage::terminate()
+{
+  if (not staged)
+    return;
+  if (th1 != nullptr)
+  {
+    th1->join();
+    delete th1;
+    th1 = nullptr;
+  }
+  // the rest, all logfiles are closed
+  uint64_t n = flush();
+  printf("# ULogStage:: copied %lu bytes to %s\n", (unsigned long)n, storagePath.c_str());
+  if (errors == 0)
+  {
+    std::error_code e;
+    std::filesystem::remove_all(stagePath, e);
+  }
+  else
+    printf("# ULogStage:: %d copy errors, staged logs kept in %s\n", errors, stagePath.c_str());
+  staged = false;
+}
+
+bool ULogStage::copyFile(std::string from, std::string to, uint64_t & offset, bool truncate)
+{
+  int src = open(from.c_str(), O_RDWR);
+  if (src < 0)
+    return false;
+  struct stat st;
+  fstat(src, &st);
+  uint64_t size = st.st_size;
+  if (size < offset)
+  { // staged file is truncated (reopened), so start over
+    offset = 0;
+    truncate = true;
+  }
+  if (size == offset and not truncate)
+  {
+    close(src);
+    return true;
+  }
+  int flags = O_WRONLY | O_CREAT | O_APPEND;
+  if (truncate)
+    flags |= O_TRUNC;
+  int dst = open(to.c_str(), flags, 0664);
+  if (dst < 0)
+  {
+    close(src);
+    return false;
+  }
+  // in large chunks
+  const int MBL = 256 * 1024;
+  static char buf[MBL];
+  bool ok = true;
+  while (offset < size and ok)
+  {
+    int n = pread(src, buf, std::min<uint64_t>(MBL, size - offset), offset);
+    ok = n > 0 and write(dst, buf, n) == n;
+    if (ok)
+      offset += n;
+  }
+  fsync(dst);
+  close(dst);
+  // release RAM for the copied part (file size is unchanged)
+  off_t done = offset & ~(uint64_t)4095;
+  if (done > 0)
+    fallocate(src, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, done);
+  close(src);
+  return ok;
+}
+
+uint64_t ULogStage::flush()
+{
+  namespace fs = std::filesystem;
+  std::lock_guard<std::mutex> lock(flushLock);
+  uint64_t bytes = 0;
+  std::error_code e;
+  for (auto & f : fs::directory_iterator(stagePath, e))
+  {
+    if (not f.is_regular_file(e))
+      continue;
+    std::string name = f.path().filename().string();
+    bool first = copied.count(name) == 0;
+    uint64_t & offset = copied[name];
+    uint64_t was = offset;
+    if (not copyFile(f.path().string(), storagePath + name, offset, first))
+    {
+      printf("# ULogStage:: failed to copy %s to %s\n", name.c_str(), storagePath.c_str());
+      errors++;
+    }
+    if (offset > was)
+      bytes += offset - was;
+  }
+  return bytes;
+}
+
+uint64_t ULogStage::pending()
+{
+  namespace fs = std::filesystem;
+  std::lock_guard<std::mutex> lock(flushLock);
+  uint64_t bytes = 0;
+  std::error_code e;
+  for (auto & f : fs::directory_iterator(stagePath, e))
+  {
+    if (not f.is_regular_file(e))
+      continue;
+    uint64_t size = f.file_size(e);
+    auto c = copied.find(f.path().filename().string());
+    if (c == copied.end())
+      bytes += size;
+    else if (size > c->second)
+      bytes += size - c->second;
+  }
+  return bytes;
+}
+
+void ULogStage::recover(std::string stageDir, std::string storageDir, std::string current)
+{
+  namespace fs = std::filesystem;
+  std::error_code e;
+  for (auto & d : fs::directory_iterator(stageDir, e))
+  {
+    std::string name = d.path().filename().string();
+    if (not d.is_directory(e) or name == current)
+      continue;
+    // copy what is not on the SD card already
+    std::string to = storageDir + name + "/";
+    fs::create_directories(to, e);
+    bool ok = true;
+    for (auto & f : fs::directory_iterator(d.path(), e))
+    {
+      if (not f.is_regular_file(e))
+        continue;
+      std::string dest = to + f.path().filename().string();
+      uint64_t offset = 0;
+      if (fs::exists(dest, e))
+        offset = fs::file_size(dest, e);
+      ok &= copyFile(f.path().string(), dest, offset, false);
+    }
+    printf("# ULogStage:: recovered staged logs to %s (ok=%d)\n", to.c_str(), ok);
+    if (ok)
+      fs::remove_all(d.path(), e);
+  }
+}
+
+void ULogStage::run()
+{
+  UTime lastFlush("now");
+  ULoopTimer loopTimer;
+  loopTimer.setup("logstage", 0.1);
+  while (not service.stop)
+  {
+    loopTimer.wait();
+    uint64_t p = pending();
+    mPending->set(p);
+    float age = lastFlush.getTimePassed();
+    bool idle = not mixer.shouldWheelsBeRunning();
+    if (flushRequest or
+        p >= chunkBytes or
+        (p > 0 and age >= flushInterval) or
+        (p > 0 and idle and age >= idleInterval))
+    {
+      flushRequest = false;
+      UTime t("now");
+      uint64_t n = flush();
+      mFlushed->inc(n);
+      mFlushTime->observeSince(t);
+      lastFlush.now();
+    }
+  }
+}
@@ -0,0 +1,116 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+#include "utime.h"
+#include "umetrics.h"
+
+/**
+ * Logfiles are written to a RAM disk (tmpfs, e.g. /dev/shm),
+ * and copied to the SD card by this thread in large sequential writes,
+ * so no thread (but this) waits for the SD card.
+ * Flush to SD card (ini [logger]):
+ * - every stage_flush_s seconds (default 10),
+ * - when more than stage_chunk_mb is waiting,
+ * - every stage_idle_flush_s seconds when the robot is not driving,
+ * - at terminate, and at once on SIGTERM (and other stop signals).
+ * On power loss up to stage_flush_s seconds of log is lost
+ * (plus data in stdio buffers), see logger_stage_pending_bytes.
+ * Data copied to the SD card is released from the RAM disk,
+ * and logs left on the RAM disk by a crash are copied at next start. */
+class ULogStage
+{
+public:
+  /**
+   * Find the directory for logfiles, called before any logfile is opened.
+   * Creates the staging directory, if staging is enabled.
+   * \param storagePath is the log directory on the SD card, e.g. 'log_20250302_154030.123/'
+   * \returns the directory to open logfiles in (staged or storagePath) */
+  std::string path(std::string storagePath);
+  /** start the flush thread (after metrics setup) */
+  void setup();
+  /**
+   * Stop thread, copy the rest to the SD card, and remove the staging directory.
+   * Call when all logfiles are closed. */
+  void terminate();
+  /**
+   * Copy new data of all staged files to the SD card
+   * \returns bytes copied */
+  uint64_t flush();
+  /** flush thread */
+  void run();
+  /// flush as soon as possible (e.g. from signal handler)
+  std::atomic<bool> flushRequest{false};
+  /// logfiles are staged in RAM
+  bool staged = false;
+  /// directory with staged logfiles
+  std::string stagePath;
+  /// log directory on the SD card
+  std::string storagePath;
+
+private:
+  static void runObj(ULogStage * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * Append new data from staged file to the file on SD card
+   * \param from is the staged file
+   * \param to is the file on the SD card
+   * \param offset is bytes copied already (updated)
+   * \param truncate the file on SD card (first copy in this run)
+   * \returns false on error */
+  bool copyFile(std::string from, std::string to, uint64_t & offset, bool truncate);
+  /** bytes in staged files not yet on the SD card */
+  uint64_t pending();
+  /**
+   * Copy logs left in the staging area (by a crash)
+   * \param stageDir is the staging area
+   * \param storageDir is where log directories are on the SD card
+   * \param current is the log directory for this run (not to recover) */
+  void recover(std::string stageDir, std::string storageDir, std::string current);
+  /// bytes copied from each staged file
+  std::map<std::string, uint64_t> copied;
+  std::mutex flushLock;
+  /// copy errors (staged files are then kept)
+  int errors = 0;
+  float flushInterval = 10;
+  float idleInterval = 1;
+  uint64_t chunkBytes = 1000000;
+  std::thread * th1 = nullptr;
+  UMetricGauge * mPending = nullptr;
+  UMetricCounter * mFlushed = nullptr;
+  UMetricHistogram * mFlushTime = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern ULogStage logstage;
@@ -0,0 +1,248 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <algorithm>
+
+#include "ulooptimer.h"
+#include "uservice.h"
+
+ULoopTiming looptiming;
+
+ULoopTimer::~ULoopTimer()
+{
+  if (mPeriod != nullptr)
+    looptiming.remove(this);
+}
+
+void ULoopTimer::setup(const char * loopName, float periodSec)
+{
+  strncpy(name, loopName, MNL - 1);
+  name[MNL - 1] = '\0';
+  period = periodSec;
+  std::string lb = "loop=\"" + std::string(name) + "\"";
+  mPeriod = metrics.histogram("loop_period_seconds", "Actual period of a loop", lb.c_str());
+  mExec = metrics.histogram("loop_exec_seconds", "Execution time of a loop (without sleep)", lb.c_str());
+  mOverrun = metrics.counter("loop_overruns_total", "Loop deadline missed", lb.c_str());
+  metrics.gauge("loop_nominal_period_seconds", "Nominal period of a loop", lb.c_str())->set(period);
+  deadline = 0;
+  loopStart = 0;
+  looptiming.add(this);
+}
+
+int64_t ULoopTimer::nowNs()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+bool ULoopTimer::wait()
+{
+  const int64_t periodNs = int64_t(period * 1e9);
+  int64_t t = nowNs();
+  if (deadline == 0)
+  { // first call
+    deadline = t;
+    loopStart = t;
+  }
+  int64_t exec = t - loopStart;
+  deadline += periodNs;
+  bool overrun = t > deadline;
+  missed = 0;
+  if (overrun)
+  { // skip missed periods, but keep the phase
+    missed = (t - deadline) / periodNs + 1;
+    deadline += int64_t(missed) * periodNs;
+  }
+  timespec d;
+  d.tv_sec = deadline / 1000000000;
+  d.tv_nsec = deadline % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &d, nullptr) == EINTR)
+  { // interrupted by a signal, continue sleeping
+  }
+  t = nowNs();
+  addSample(t - loopStart, exec, overrun);
+  loopStart = t;
+  return not overrun;
+}
+
+void ULoopTimer::restart()
+{
+  deadline = 0;
+  missed = 0;
+}
+
+void ULoopTimer::begin()
+{
+  int64_t t = nowNs();
+  if (loopStart != 0)
+  {
+    int64_t p = t - loopStart;
+    addSample(p, -1, p > int64_t(period * 1.5e9));
+  }
+  loopStart = t;
+}
+
+void ULoopTimer::end()
+{
+  int64_t exec = nowNs() - loopStart;
+  mExec->observe(exec * 1e-9);
+  std::lock_guard<std::mutex> lock(statLock);
+  nExec++;
+  execSum += exec;
+  execMax = std::max(execMax, exec);
+}
+
+void ULoopTimer::addSample(int64_t periodNs, int64_t execNs, bool overrun)
+{
+  mPeriod->observe(periodNs * 1e-9);
+  if (execNs >= 0)
+    mExec->observe(execNs * 1e-9);
+  if (overrun)
+    mOverrun->inc();
+  std::lock_guard<std::mutex> lock(statLock);
+  if (n == 0 or periodNs < periodMin)
+    periodMin = periodNs;
+  if (n == 0 or periodNs > periodMax)
+    periodMax = periodNs;
+  n++;
+  periodSum += periodNs;
+  periodSqSum += double(periodNs) * periodNs;
+  if (execNs >= 0)
+  {
+    nExec++;
+    execSum += execNs;
+    execMax = std::max(execMax, execNs);
+  }
+  if (overrun)
+    overruns++;
+}
+
+bool ULoopTimer::summary(char * s, int sCnt)
+{
+  std::lock_guard<std::mutex> lock(statLock);
+  if (n == 0)
+    return false;
+  double mean = periodSum / n;
+  double sd = sqrt(std::max(0.0, periodSqSum / n - mean * mean));
+  double execMean = 0;
+  if (nExec > 0)
+    execMean = execSum / nExec;
+  // all times in ms
+  snprintf(s, sCnt, "%s %d %.3f %.3f %.3f %.3f %.3f %.3f %.3f %d\n",
+           name, n, period * 1e3, mean * 1e-6, sd * 1e-6,
+           periodMin * 1e-6, periodMax * 1e-6,
+           execMean * 1e-6, execMax * 1e-6, overruns);
+  n = 0;
+  periodSum = 0;
+  periodSqSum = 0;
+  nExec = 0;
+  execSum = 0;
+  execMax = 0;
+  overruns = 0;
+  return true;
+}
+
+///////////////////////////////////////////////////////////
+
+void ULoopTiming::setup()
+{ // ensure default values
+  if (not ini.has("looptiming"))
+  { // no data yet, so generate some default values
+    ini["looptiming"]["interval_s"] = "10";
+    ini["looptiming"]["log"] = "true";
+    ini["looptiming"]["print"] = "false";
+  }
+  interval = strtof(ini["looptiming"]["interval_s"].c_str(), nullptr);
+  if (interval < 0.5)
+    interval = 0.5;
+  toConsole = ini["looptiming"]["print"] == "true";
+  topicLoop.setup(mqtt.root + ini["mqtt"]["function"] + "looptiming");
+  if (ini["looptiming"]["log"] == "true" and logfile == nullptr)
+  { // open logfile
+    std::string fn = service.logPath + "log_loop_timing.txt";
+    logfile = fopen(fn.c_str(), "w");
+    fprintf(logfile, "%% Loop timing, one line for each loop every %.1f sec\n", interval);
+    fprintf(logfile, "%% 1 \tTime (sec)\n");
+    fprintf(logfile, "%% 2 \tLoop name\n");
+    fprintf(logfile, "%% 3 \tNumber of loops\n");
+    fprintf(logfile, "%% 4 \tNominal period (ms)\n");
+    fprintf(logfile, "%% 5 \tMean period (ms)\n");
+    fprintf(logfile, "%% 6 \tPeriod standard deviation (ms) (jitter)\n");
+    fprintf(logfile, "%% 7,8 \tMin and max period (ms)\n");
+    fprintf(logfile, "%% 9,10 \tMean and max execution time (ms)\n");
+    fprintf(logfile, "%% 11 \tOverruns (deadline missed)\n");
+  }
+  lastReport.now();
+}
+
+void ULoopTiming::tick()
+{
+  if (lastReport.getTimePassed() < interval)
+    return;
+  UTime t("now");
+  lastReport = t;
+  const int MSL = 200;
+  char s[MSL];
+  std::lock_guard<std::mutex> lock(listLock);
+  for (auto loop : loops)
+  {
+    if (not loop->summary(s, MSL))
+      continue;
+    // topic robobot/drive/looptiming
+    mqtt.publish(topicLoop, s, t);
+    if (logfile != nullptr and not service.stop_logging)
+      fprintf(logfile, "%lu.%04ld %s", t.getSec(), t.getMicrosec()/100, s);
+    if (toConsole)
+      printf("# loop %s", s);
+  }
+}
+
+void ULoopTiming::terminate()
+{
+  if (logfile != nullptr)
+  {
+    fclose(logfile);
+    logfile = nullptr;
+  }
+}
+
+void ULoopTiming::add(ULoopTimer * loop)
+{
+  std::lock_guard<std::mutex> lock(listLock);
+  if (std::find(loops.begin(), loops.end(), loop) == loops.end())
+    loops.push_back(loop);
+}
+
+void ULoopTiming::remove(ULoopTimer * loop)
+{
+  std::lock_guard<std::mutex> lock(listLock);
+  auto it = std::find(loops.begin(), loops.end(), loop);
+  if (it != loops.end())
+    loops.erase(it);
+}
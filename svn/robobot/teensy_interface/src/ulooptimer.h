@@ -0,0 +1,137 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <vector>
+
+#include "utime.h"
+#include "umqtt.h"
+#include "umetrics.h"
+
+/**
+ * Timing of a control or service loop.
+ * A fixed rate loop calls wait() once every loop; it sleeps to an
+ * absolute deadline (CLOCK_MONOTONIC), so the period does not drift
+ * with the execution time. A missed deadline is an overrun, and
+ * the missed periods are skipped (the phase is kept).
+ * A loop driven by data (e.g. the motor controller, driven by the
+ * encoder samples) calls begin() and end() to get the same statistics;
+ * here a period longer than 1.5 times nominal is an overrun.
+ * Period, execution time and overruns go to the metrics
+ * (label loop="name"), and a summary is published and logged
+ * by looptiming. */
+class ULoopTimer
+{
+public:
+  ~ULoopTimer();
+  /**
+   * Name the loop and set nominal period
+   * \param name is the loop name, e.g. 'service'
+   * \param periodSec is the nominal period (sec) */
+  void setup(const char * name, float periodSec);
+  /**
+   * Fixed rate loop: sleep until the next deadline
+   * \returns false if the deadline was missed (overrun) */
+  bool wait();
+  /**
+   * Fixed rate loop: start again after a pause (e.g. a new trajectory),
+   * so the pause is not counted as an overrun */
+  void restart();
+  /**
+   * Data driven loop: start of work (new sample) */
+  void begin();
+  /**
+   * Data driven loop: end of work */
+  void end();
+  /**
+   * Make a summary since the last summary (and reset)
+   * \param s is the string for the summary
+   * \param sCnt is the size of the string buffer
+   * \returns false if the loop has not been run since the last summary */
+  bool summary(char * s, int sCnt);
+  /// loop name
+  static const int MNL = 32;
+  char name[MNL] = "";
+  /// nominal period (sec)
+  float period = 0.1;
+  /// periods skipped by the last wait() (overrun), 0 if on time
+  int missed = 0;
+
+private:
+  static int64_t nowNs();
+  /**
+   * Add one loop to the statistics (times in ns) */
+  void addSample(int64_t periodNs, int64_t execNs, bool overrun);
+  /// next deadline (ns, monotonic)
+  int64_t deadline = 0;
+  /// start of this loop (ns, monotonic)
+  int64_t loopStart = 0;
+  /// statistics since last summary
+  std::mutex statLock;
+  int n = 0;
+  double periodSum = 0, periodSqSum = 0;
+  int64_t periodMin = 0, periodMax = 0;
+  int nExec = 0;
+  double execSum = 0;
+  int64_t execMax = 0;
+  int overruns = 0;
+  UMetricHistogram * mPeriod = nullptr;
+  UMetricHistogram * mExec = nullptr;
+  UMetricCounter * mOverrun = nullptr;
+};
+
+/**
+ * Publish and log the timing of all loops (ULoopTimer)
+ * with a fixed interval. */
+class ULoopTiming
+{
+public:
+  /** setup and open logfile */
+  void setup();
+  /**
+   * Report, if it is time to do so (called by the service loop) */
+  void tick();
+  /** close logfile */
+  void terminate();
+  /**
+   * Add or remove a loop (done by the ULoopTimer) */
+  void add(ULoopTimer * loop);
+  void remove(ULoopTimer * loop);
+
+private:
+  std::mutex listLock;
+  std::vector<ULoopTimer *> loops;
+  /// report interval (sec)
+  float interval = 10;
+  UTime lastReport;
+  bool toConsole = false;
+  FILE * logfile = nullptr;
+  UMqttTopic topicLoop;
+};
+
+extern ULoopTiming looptiming;
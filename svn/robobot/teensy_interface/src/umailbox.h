@@ -0,0 +1,152 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utime.h"
+#include "umetrics.h"
+#include "umutex.h"
+
+/**
+ * Get an optional sender timestamp from the start of a command payload.
+ * The timestamp is written as 'ts:<seconds since 1970>', e.g.
+ * 'ts:1739885000.123 0.2 0.5' for a rc command (sender clock must be NTP synchronized).
+ * \param payload is the command payload
+ * \param cmdTime is set to the sender time, if there is one (else unchanged)
+ * \returns pointer to the rest of the payload (the command parameters) */
+inline const char * getSenderTime(const char * payload, UTime & cmdTime)
+{
+  const char * p1 = payload;
+  while (*p1 == ' ')
+    p1++;
+  if (strncmp(p1, "ts:", 3) == 0)
+  {
+    char * p2;
+    double t = strtod(p1 + 3, &p2);
+    if (p2 != p1 + 3)
+    {
+      long sec = long(t);
+      cmdTime.setTime(sec, long((t - sec) * 1e6));
+      p1 = p2;
+    }
+  }
+  return p1;
+}
+
+/**
+ * Single slot mailbox for one command class (e.g. 'rc').
+ * A new command replaces any unused command (latest wins),
+ * and a command older than maxAge is discarded when taken.
+ * So the user gets the newest valid command only, also if the
+ * MQTT broker delivers a backlog of old commands at once. */
+template <class T>
+class UMailbox
+{
+public:
+  /**
+   * Setup
+   * \param name is used in metrics labels, e.g. 'rc'
+   * \param maxAgeSec is the maximum age (sec) of a command to be used (0 = no limit) */
+  void setup(const char * name, float maxAgeSec)
+  {
+    maxAge = maxAgeSec;
+    std::string lb = "cmd=\"" + std::string(name) + "\"";
+    mPut = metrics.counter("mailbox_put_total", "Commands put in mailbox", lb.c_str());
+    mReplaced = metrics.counter("mailbox_replaced_total", "Commands replaced by a newer before use", lb.c_str());
+    mExpired = metrics.counter("mailbox_expired_total", "Commands discarded as too old", lb.c_str());
+    mAge = metrics.histogram("mailbox_age_seconds", "Command age when used", lb.c_str());
+    boxLock.setup("mailbox", lb.c_str());
+  }
+  /**
+   * Put a new command in the mailbox
+   * \param v is the command value
+   * \param cmdTime is when the command was made (sender time or arrival time) */
+  void put(const T & v, UTime & cmdTime)
+  {
+    std::lock_guard<UMutex> lock(boxLock);
+    if (full and mReplaced != nullptr)
+      mReplaced->inc();
+    value = v;
+    time = cmdTime;
+    full = true;
+    if (mPut != nullptr)
+      mPut->inc();
+  }
+  /**
+   * Take the command, if there is a new and valid command.
+   * \param v is set to the command value
+   * \param cmdTime is set to the command time
+   * \returns true if v is valid */
+  bool take(T & v, UTime & cmdTime)
+  {
+    std::lock_guard<UMutex> lock(boxLock);
+    if (not full)
+      return false;
+    full = false;
+    float age = time.getTimePassed();
+    if (maxAge > 0 and age > maxAge)
+    { // too old
+      expiredCnt++;
+      if (mExpired != nullptr)
+        mExpired->inc();
+      return false;
+    }
+    if (mAge != nullptr)
+      mAge->observe(age);
+    v = value;
+    cmdTime = time;
+    return true;
+  }
+  /**
+   * Discard any unused command */
+  void clear()
+  {
+    std::lock_guard<UMutex> lock(boxLock);
+    full = false;
+  }
+  /**
+   * Is there an unused command */
+  inline bool isFull()
+  {
+    return full;
+  }
+  /// max age (seconds) of a command
+  float maxAge = 0.5;
+  /// number of discarded (too old) commands
+  int expiredCnt = 0;
+
+private:
+  T value;
+  UTime time;
+  bool full = false;
+  UMutex boxLock;
+  UMetricCounter * mPut = nullptr;
+  UMetricCounter * mReplaced = nullptr;
+  UMetricCounter * mExpired = nullptr;
+  UMetricHistogram * mAge = nullptr;
+};
+
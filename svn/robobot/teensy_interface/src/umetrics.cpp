@@ -0,0 +1,448 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <cinttypes>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "umetrics.h"
+#include "uservice.h"
+
+// create value
+UMetrics metrics;
+/// type names for exposition (and warnings)
+static const char * typeName[] = {"counter", "gauge", "histogram"};
+
+// bucket limits in seconds (last bucket is +Inf)
+const double UMetricHistogram::bound[BUCKETS - 1] =
+  {10e-6, 20e-6, 50e-6, 100e-6, 200e-6, 500e-6,
+   1e-3, 2e-3, 5e-3, 10e-3, 20e-3, 50e-3,
+   0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0};
+
+std::string UMetric::fullName(const char * postfix, const char * extraLabel)
+{
+  std::string s = name + postfix;
+  bool hasLabels = not labels.empty();
+  bool hasExtra = extraLabel != nullptr;
+  if (hasLabels or hasExtra)
+  {
+    s += "{" + labels;
+    if (hasLabels and hasExtra)
+      s += ",";
+    if (hasExtra)
+      s += extraLabel;
+    s += "}";
+  }
+  return s;
+}
+
+///////////////////////////////////////////////////
+
+void UMetricCounter::toText(std::string & out)
+{
+  const int MSL = 50;
+  char s[MSL];
+  snprintf(s, MSL, " %" PRIu64 "\n", get());
+  out += fullName() + s;
+}
+
+void UMetricCounter::toPayload(char * s, int n)
+{
+  snprintf(s, n, "%" PRIu64, get());
+}
+
+void UMetricGauge::toText(std::string & out)
+{
+  const int MSL = 50;
+  char s[MSL];
+  snprintf(s, MSL, " %g\n", get());
+  out += fullName() + s;
+}
+
+void UMetricGauge::toPayload(char * s, int n)
+{
+  snprintf(s, n, "%g", get());
+}
+
+///////////////////////////////////////////////////
+
+void UMetricHistogram::observe(double v)
+{
+  int i = 0;
+  while (i < BUCKETS - 1 and v > bound[i])
+    i++;
+  bucket[i].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  // atomic<double> has no fetch_add before C++20 on all compilers
+  double old = sum.load(std::memory_order_relaxed);
+  while (not sum.compare_exchange_weak(old, old + v, std::memory_order_relaxed))
+    ;
+  old = max.load(std::memory_order_relaxed);
+  while (v > old and not max.compare_exchange_weak(old, v, std::memory_order_relaxed))
+    ;
+}
+
+double UMetricHistogram::quantile(double q)
+{
+  uint64_t n = count.load(std::memory_order_relaxed);
+  if (n == 0)
+    return 0;
+  uint64_t limit = uint64_t(q * n);
+  uint64_t acc = 0;
+  for (int i = 0; i < BUCKETS - 1; i++)
+  {
+    acc += bucket[i].load(std::memory_order_relaxed);
+    if (acc > limit)
+      return bound[i];
+  }
+  return max.load(std::memory_order_relaxed);
+}
+
+void UMetricHistogram::toText(std::string & out)
+{
+  const int MSL = 50;
+  char s[MSL];
+  char le[MSL];
+  uint64_t acc = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    acc += bucket[i].load(std::memory_order_relaxed);
+    if (i < BUCKETS - 1)
+      snprintf(le, MSL, "le=\"%g\"", bound[i]);
+    else
+      snprintf(le, MSL, "le=\"+Inf\"");
+    snprintf(s, MSL, " %" PRIu64 "\n", acc);
+    out += fullName("_bucket", le) + s;
+  }
+  snprintf(s, MSL, " %g\n", sum.load(std::memory_order_relaxed));
+  out += fullName("_sum") + s;
+  snprintf(s, MSL, " %" PRIu64 "\n", count.load(std::memory_order_relaxed));
+  out += fullName("_count") + s;
+}
+
+void UMetricHistogram::toPayload(char * s, int n)
+{ // count, mean, 50%, 99% and max (in ms)
+  uint64_t cnt = count.load(std::memory_order_relaxed);
+  double mean = 0;
+  if (cnt > 0)
+    mean = sum.load(std::memory_order_relaxed) / cnt;
+  snprintf(s, n, "%" PRIu64 " %.3f %.3f %.3f %.3f", cnt, mean * 1000.0,
+           quantile(0.5) * 1000.0, quantile(0.99) * 1000.0,
+           max.load(std::memory_order_relaxed) * 1000.0);
+}
+
+///////////////////////////////////////////////////
+
+void UMetrics::setup()
+{ // ensure default values
+  if (not ini.has("metrics"))
+  { // no data yet, so generate some default values
+    ini["metrics"]["use"] = "true";
+    ini["metrics"]["mqtt"] = "true";
+    ini["metrics"]["interval_ms"] = "1000";
+    ini["metrics"]["http_port"] = "9100"; // 0 = no HTTP server
+    ini["metrics"]["http_bind"] = "127.0.0.1"; // loopback only
+    ini["metrics"]["log"] = "false";
+  }
+  if (ini["metrics"]["use"] != "true")
+  {
+    printf("# UMetrics:: disabled in robot.ini\n");
+    return;
+  }
+  useMqtt = ini["metrics"]["mqtt"] == "true";
+  interval = strtof(ini["metrics"]["interval_ms"].c_str(), nullptr) / 1000.0;
+  if (interval < 0.05)
+    interval = 0.05;
+  httpPort = strtol(ini["metrics"]["http_port"].c_str(), nullptr, 10);
+  topicRoot = mqtt.root + "metrics/";
+  if (ini["metrics"]["log"] == "true" and logfile == nullptr)
+  { // open logfile
+    std::string fn = service.logPath + "log_metrics.txt";
+    logfile = fopen(fn.c_str(), "w");
+    fprintf(logfile, "%% metrics logfile (one line per metric each interval)\n");
+    fprintf(logfile, "%% 1 \tTime (sec)\n");
+    fprintf(logfile, "%% 2 \tMetric name with labels\n");
+    fprintf(logfile, "%% 3 \tValue, for histograms: count, mean, 50%%, 99%% and max (ms)\n");
+  }
+  if (httpPort > 0)
+    openHttp();
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void UMetrics::terminate()
+{
+  if (th1 != nullptr)
+    th1->join();
+  if (httpSocket >= 0)
+    close(httpSocket);
+  if (logfile != nullptr)
+  {
+    fclose(logfile);
+    printf("# UMetrics:: logfile closed\n");
+  }
+}
+
+UMetric * UMetrics::find(const char * name, const char * labels)
+{
+  int n = metricCnt.load();
+  for (int i = 0; i < n; i++)
+  {
+    if (metric[i]->name == name and metric[i]->labels == labels)
+      return metric[i];
+  }
+  return nullptr;
+}
+
+bool UMetrics::typeConflict(const char * name, UMetric::MetricType type)
+{ // called with registerLock locked
+  int n = metricCnt.load();
+  for (int i = 0; i < n; i++)
+  {
+    if (metric[i]->name == name and metric[i]->type != type)
+    {
+      printf("# UMetrics:: %s is a %s, a %s with this name is not exported\n",
+             name, typeName[metric[i]->type], typeName[type]);
+      return true;
+    }
+  }
+  return false;
+}
+
+UMetric * UMetrics::add(UMetric * m, const char * name, const char * help, const char * labels)
+{ // called with registerLock locked
+  int n = metricCnt.load();
+  if (n >= MAX_METRICS)
+  {
+    printf("# UMetrics:: table full, metric %s not exported\n", name);
+    return m;
+  }
+  m->name = name;
+  m->help = help;
+  m->labels = labels;
+  metric[n] = m;
+  // make visible to export thread after the metric is complete
+  metricCnt.store(n + 1);
+  return m;
+}
+
+UMetricCounter * UMetrics::counter(const char * name, const char * help, const char * labels)
+{
+  std::lock_guard<std::mutex> lock(registerLock);
+  UMetric * m = find(name, labels);
+  if (m != nullptr and m->type == UMetric::COUNTER)
+    return (UMetricCounter *) m;
+  UMetricCounter * c = new UMetricCounter();
+  c->type = UMetric::COUNTER;
+  if (not typeConflict(name, UMetric::COUNTER))
+    add(c, name, help, labels);
+  return c;
+}
+
+UMetricGauge * UMetrics::gauge(const char * name, const char * help, const char * labels)
+{
+  std::lock_guard<std::mutex> lock(registerLock);
+  UMetric * m = find(name, labels);
+  if (m != nullptr and m->type == UMetric::GAUGE)
+    return (UMetricGauge *) m;
+  UMetricGauge * g = new UMetricGauge();
+  g->type = UMetric::GAUGE;
+  if (not typeConflict(name, UMetric::GAUGE))
+    add(g, name, help, labels);
+  return g;
+}
+
+UMetricHistogram * UMetrics::histogram(const char * name, const char * help, const char * labels)
+{
+  std::lock_guard<std::mutex> lock(registerLock);
+  UMetric * m = find(name, labels);
+  if (m != nullptr and m->type == UMetric::HISTOGRAM)
+    return (UMetricHistogram *) m;
+  UMetricHistogram * h = new UMetricHistogram();
+  h->type = UMetric::HISTOGRAM;
+  if (not typeConflict(name, UMetric::HISTOGRAM))
+    add(h, name, help, labels);
+  return h;
+}
+
+std::string UMetrics::toText()
+{
+  std::string out;
+  int n = metricCnt.load();
+  out.reserve(n * 120);
+  for (int i = 0; i < n; i++)
+  {
+    UMetric * m = metric[i];
+    // HELP and TYPE only once for each name
+    bool first = true;
+    for (int j = 0; j < i; j++)
+      if (metric[j]->name == m->name)
+      {
+        first = false;
+        break;
+      }
+    if (first)
+    {
+      out += "# HELP " + m->name + " " + m->help + "\n";
+      out += "# TYPE " + m->name + " " + typeName[m->type] + "\n";
+    }
+    m->toText(out);
+  }
+  return out;
+}
+
+void UMetrics::publishAll()
+{
+  const int MSL = 200;
+  char s[MSL];
+  UTime t("now");
+  int n = metricCnt.load();
+  for (int i = 0; i < n; i++)
+  {
+    UMetric * m = metric[i];
+    m->toPayload(s, MSL);
+    if (useMqtt and mqtt.use)
+    {
+      if (not m->topic.valid())
+      { // topic is robobot/metrics/name or robobot/metrics/name/labelvalue
+        std::string tp = topicRoot + m->name;
+        if (not m->labels.empty())
+        { // use label values only, e.g. tn="0" gives /0
+          std::string lv;
+          bool inValue = false;
+          for (char c : m->labels)
+          {
+            if (c == '"')
+            {
+              inValue = not inValue;
+              if (not inValue)
+                lv += '_';
+            }
+            else if (inValue)
+              lv += c;
+          }
+          if (not lv.empty())
+            lv.pop_back();
+          tp += "/" + lv;
+        }
+        m->topic.setup(tp);
+      }
+      mqtt.publish(m->topic, s, t);
+    }
+    if (logfile != nullptr and not service.stop_logging)
+    {
+      fprintf(logfile, "%lu.%04ld %s{%s} %s\n", t.getSec(), t.getMicrosec()/100,
+              m->name.c_str(), m->labels.c_str(), s);
+    }
+  }
+}
+
+bool UMetrics::openHttp()
+{
+  httpSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (httpSocket < 0)
+  {
+    printf("# UMetrics:: failed to create HTTP socket\n");
+    return false;
+  }
+  int on = 1;
+  setsockopt(httpSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(httpPort);
+  if (inet_pton(AF_INET, ini["metrics"]["http_bind"].c_str(), &addr.sin_addr) != 1)
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bool isOK = bind(httpSocket, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+  if (isOK)
+    isOK = listen(httpSocket, 4) == 0;
+  if (not isOK)
+  {
+    printf("# UMetrics:: failed to open HTTP port %d (%s)\n", httpPort, strerror(errno));
+    close(httpSocket);
+    httpSocket = -1;
+  }
+  else
+    printf("# UMetrics:: serving metrics on http://%s:%d/metrics\n",
+           ini["metrics"]["http_bind"].c_str(), httpPort);
+  return isOK;
+}
+
+void UMetrics::serveHttp()
+{ // a request is waiting
+  int fd = accept(httpSocket, nullptr, nullptr);
+  if (fd < 0)
+    return;
+  // read (and ignore) the request, all paths return the metrics
+  const int MRL = 1000;
+  char req[MRL];
+  struct pollfd pfd = {fd, POLLIN, 0};
+  if (poll(&pfd, 1, 100) > 0)
+    recv(fd, req, MRL, 0);
+  std::string body = toText();
+  const int MSL = 200;
+  char s[MSL];
+  snprintf(s, MSL, "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: %zu\r\n"
+                   "Connection: close\r\n\r\n", body.size());
+  std::string reply = s + body;
+  size_t sent = 0;
+  while (sent < reply.size())
+  {
+    ssize_t n = send(fd, reply.c_str() + sent, reply.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      break;
+    sent += n;
+  }
+  close(fd);
+}
+
+void UMetrics::run()
+{
+  UTime t("now");
+  while (not service.stop)
+  {
+    if (httpSocket >= 0)
+    { // wait for a client, but no longer than 50ms
+      struct pollfd pfd = {httpSocket, POLLIN, 0};
+      if (poll(&pfd, 1, 50) > 0)
+        serveHttp();
+    }
+    else
+      usleep(50000);
+    if (t.getTimePassed() >= interval)
+    {
+      t += interval;
+      if (t.getTimePassed() > interval)
+        // we are far behind, so skip
+        t.now();
+      publishAll();
+    }
+  }
+}
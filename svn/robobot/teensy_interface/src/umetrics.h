@@ -0,0 +1,218 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "utime.h"
+#include "umqtt.h"
+
+/**
+ * One value in the metrics registry.
+ * Values are updated without locks (std::atomic), so
+ * modules can update them from any thread in the data path. */
+class UMetric
+{
+public:
+  enum MetricType {COUNTER, GAUGE, HISTOGRAM};
+  /// metric name, e.g. teensy_rx_messages_total
+  std::string name;
+  /// help text (one line)
+  std::string help;
+  /// labels in exposition format, e.g. tn="0" (may be empty)
+  std::string labels;
+  MetricType type;
+  /// topic for MQTT export (robobot/metrics/name[/label value])
+  UMqttTopic topic;
+  /**
+   * Append this metric in text exposition format (without HELP and TYPE lines) */
+  virtual void toText(std::string & out) = 0;
+  /**
+   * Make the short (MQTT) payload for this metric
+   * \param s is a buffer for the result
+   * \param n is the buffer size */
+  virtual void toPayload(char * s, int n) = 0;
+  virtual ~UMetric() {}
+protected:
+  /**
+   * Name with labels, e.g. name{tn="0"} */
+  std::string fullName(const char * postfix = "", const char * extraLabel = nullptr);
+};
+
+/**
+ * Counter that can only increase */
+class UMetricCounter : public UMetric
+{
+public:
+  inline void inc(uint64_t n = 1)
+  {
+    value.fetch_add(n, std::memory_order_relaxed);
+  }
+  inline uint64_t get()
+  {
+    return value.load(std::memory_order_relaxed);
+  }
+  void toText(std::string & out) override;
+  void toPayload(char * s, int n) override;
+private:
+  std::atomic<uint64_t> value{0};
+};
+
+/**
+ * Gauge that can be set to any value (e.g. queue size) */
+class UMetricGauge : public UMetric
+{
+public:
+  inline void set(double v)
+  {
+    value.store(v, std::memory_order_relaxed);
+  }
+  inline double get()
+  {
+    return value.load(std::memory_order_relaxed);
+  }
+  void toText(std::string & out) override;
+  void toPayload(char * s, int n) override;
+private:
+  std::atomic<double> value{0};
+};
+
+/**
+ * Histogram of (latency) values in seconds.
+ * The buckets are fixed, from 10us to 10s in 1-2-5 steps. */
+class UMetricHistogram : public UMetric
+{
+public:
+  static const int BUCKETS = 20;
+  /// upper bound of each bucket (last bucket is +Inf)
+  static const double bound[BUCKETS - 1];
+  /**
+   * Add a value (seconds) */
+  void observe(double v);
+  /**
+   * Add the time passed since this time */
+  inline void observeSince(UTime & t)
+  {
+    observe(t.getTimePassed());
+  }
+  /**
+   * Estimate a quantile from the buckets
+   * \param q is the quantile (0..1)
+   * \returns the upper bound of the bucket with the quantile */
+  double quantile(double q);
+  /**
+   * Number of observed values */
+  inline uint64_t getCount()
+  {
+    return count.load(std::memory_order_relaxed);
+  }
+  void toText(std::string & out) override;
+  void toPayload(char * s, int n) override;
+private:
+  std::atomic<uint64_t> bucket[BUCKETS] = {};
+  std::atomic<uint64_t> count{0};
+  std::atomic<double> sum{0};
+  std::atomic<double> max{0};
+};
+
+/**
+ * Registry of counters, gauges and histograms for the whole daemon.
+ * Registration (at setup) uses a lock, updates do not.
+ * The values are published on MQTT (robobot/metrics/...) at a
+ * fixed interval, and served in Prometheus text format on a (loopback) HTTP port. */
+class UMetrics
+{
+public:
+  /** setup and start export thread */
+  void setup();
+  /**
+   * terminate */
+  void terminate();
+  /**
+   * export thread */
+  void run();
+  /**
+   * Get a counter, the counter is created the first time.
+   * \param name is metric name (should end in _total)
+   * \param help is a one line description
+   * \param labels is e.g. tn="0" or empty
+   * \returns pointer to counter (never deleted), if the name is used
+   * by another type, the counter works, but is not exported */
+  UMetricCounter * counter(const char * name, const char * help, const char * labels = "");
+  /**
+   * Get a gauge, the gauge is created the first time.
+   * see counter(..) for parameters */
+  UMetricGauge * gauge(const char * name, const char * help, const char * labels = "");
+  /**
+   * Get a (latency) histogram, created the first time.
+   * see counter(..) for parameters */
+  UMetricHistogram * histogram(const char * name, const char * help, const char * labels = "");
+  /**
+   * Get all metrics in text exposition format */
+  std::string toText();
+
+private:
+  static void runObj(UMetrics * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * Find or add a metric of this type */
+  UMetric * find(const char * name, const char * labels);
+  /**
+   * Test if a metric with this name has another type
+   * (one name must have one type, also with other labels)
+   * \returns true (and prints a warning) if so */
+  bool typeConflict(const char * name, UMetric::MetricType type);
+  UMetric * add(UMetric * m, const char * name, const char * help, const char * labels);
+  /**
+   * publish all metrics on MQTT */
+  void publishAll();
+  /**
+   * HTTP (Prometheus) server */
+  bool openHttp();
+  void serveHttp();
+  //
+  static const int MAX_METRICS = 256;
+  UMetric * metric[MAX_METRICS] = {nullptr};
+  std::atomic<int> metricCnt{0};
+  std::mutex registerLock;
+  //
+  std::thread * th1 = nullptr;
+  std::string topicRoot;
+  bool useMqtt = true;
+  float interval = 1.0;
+  int httpPort = 0;
+  int httpSocket = -1;
+  FILE * logfile = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UMetrics metrics;
+
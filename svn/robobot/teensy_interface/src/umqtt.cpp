@@ -30,6 +30,8 @@
 #include <iostream>
 #include "uservice.h"
 #include "umqtt.h"
+#include "umetrics.h"
+#include "uflightrec.h"
 
 using namespace std::chrono;
 
@@ -44,19 +46,56 @@ UMqtt mqtt;
 // #define TIMEOUT     10000L
 
 
+std::string UMqtt::clientId(const std::string & base)
+{ // add robot namespace (without '/') and host name
+  std::string id = base;
+  std::string ns = ini["mqtt"]["robot"];
+  while (not ns.empty() and ns.back() == '/')
+    ns.pop_back();
+  if (not ns.empty())
+    id += "_" + ns;
+  const int MSL = 65;
+  char s[MSL];
+  if (gethostname(s, MSL) == 0)
+  {
+    s[MSL - 1] = '\0';
+    id += "_" + std::string(s);
+  }
+  return id;
+}
+
 void UMqtt::setup()
 { // ensure default values
   if (not ini.has("mqtt"))
   { // no data yet, so generate some default values
     ini["mqtt"]["broker"] = "tcp://localhost:1883"; // IP and port to broker
     ini["mqtt"]["context"] = "drive"; // not used
-    ini["mqtt"]["clientid"] = "tif_out"; // data source for publish
+    ini["mqtt"]["clientid"] = "tif_out"; // data source for publish (robot namespace and host name are added)
     ini["mqtt"]["function"] = "drive/"; // drive/ or crane/. Function of this process
     ini["mqtt"]["system"] = "robobot/"; // top name in MQTT topic
     ini["mqtt"]["log"] = "true";
     ini["mqtt"]["print"] = "false";
     ini["mqtt"]["use"] = "true";
   }
+  mTxMsg = metrics.counter("mqtt_tx_messages_total", "MQTT messages published");
+  mTxErr = metrics.counter("mqtt_tx_errors_total", "MQTT publish failed");
+  mTxTime = metrics.histogram("mqtt_tx_publish_seconds", "Time to publish a MQTT message (including wait for lock)");
+  mqttPublishLock.setup("mqtt_publish");
+  logLock.setup("mqtt_log");
+  if (not ini["mqtt"].has("robot"))
+  { // robot namespace, so that more robots can share one broker
+    // e.g. 'r17/' gives topics like robobot/r17/drive/T0/hbt and robobot/r17/cmd/#
+    ini["mqtt"]["robot"] = "";
+    // should commands for all robots (robobot/fleet/cmd/...) be used too
+    ini["mqtt"]["fleet"] = "false";
+  }
+  root = ini["mqtt"]["system"] + ini["mqtt"]["robot"];
+  if (root.back() != '/')
+    root += "/";
+  fleetRoot = ini["mqtt"]["system"] + "fleet/";
+  fleet = ini["mqtt"]["fleet"] == "true";
+  // MQTT use is tested for every publish, so cache the value
+  use = ini["mqtt"]["use"] == "true";
   if (ini["mqtt"]["print"] == "true")
   // logfiles
   toConsole = ini["mqtt"]["print"] == "true";
@@ -67,9 +106,11 @@ void UMqtt::setup()
     fprintf(logfile, "%% mqtt logfile, enabled=%s\n", ini["mqtt"]["use"].c_str());
     fprintf(logfile, "%% broker=%s\n", ini["mqtt"]["broker"].c_str());
     fprintf(logfile, "%% context=%s\n", ini["mqtt"]["context"].c_str());
-    fprintf(logfile, "%% client id=%s\n", ini["mqtt"]["clientid"].c_str());
+    fprintf(logfile, "%% client id=%s\n", clientId(ini["mqtt"]["clientid"]).c_str());
     fprintf(logfile, "%% system=%s (top level ID)\n", ini["mqtt"]["system"].c_str());
     fprintf(logfile, "%% function=%s (next level name)\n", ini["mqtt"]["function"].c_str());
+    fprintf(logfile, "%% robot=%s (namespace, all topics start with %s)\n", ini["mqtt"]["robot"].c_str(), root.c_str());
+    fprintf(logfile, "%% fleet=%s (use commands from %scmd/)\n", ini["mqtt"]["fleet"].c_str(), fleetRoot.c_str());
     fprintf(logfile, "%% 1 \tTime (sec)\n");
     fprintf(logfile, "%% 2 \tQuality of service 0=max once, 1=at least once, 2=once, S=subscribe\n");
     // fprintf(logfile, "%% 3 \tTx = published, Rx = received, Su = subscribe\n");
@@ -77,14 +118,14 @@ void UMqtt::setup()
     fprintf(logfile, "%% 4 \tMessage / payload\n");
   }
   // MQTT
-  if (ini["mqtt"]["use"] == "true" and not connected)
+  if (use and not connected)
   { // MQTT enabled
     int rc;
     int connectCnt = 0;
     bool isOK = false;
     rc = MQTTClient_create(&client,
                             ini["mqtt"]["broker"].c_str(),
-                            ini["mqtt"]["clientid"].c_str(),
+                            clientId(ini["mqtt"]["clientid"]).c_str(),
                             MQTTCLIENT_PERSISTENCE_NONE,
                             NULL);
     isOK = rc == MQTTCLIENT_SUCCESS;
@@ -265,13 +306,30 @@ void UMqtt::connlost(void */*context*/, char *cause)
 {
   printf("# UMqtt:: Connection lost\n");
   printf("#     cause: %s\n", cause);
+  flightrec.trigger("mqtt_lost");
 }
 
 
 
 bool UMqtt::publish(const char * topic, const char * payload, UTime & msgTime, int qos)
 {
-  if (ini["mqtt"]["use"] != "true")
+  if (strlen(topic) < 5)
+    // no topic
+    return false;
+  return publishRaw(topic, payload, msgTime, qos, false);
+}
+
+bool UMqtt::publish(const UMqttTopic & topic, const char * payload, UTime & msgTime)
+{
+  if (not topic.valid())
+    // no topic
+    return false;
+  return publishRaw(topic.c_str(), payload, msgTime, topic.qos, topic.retain);
+}
+
+bool UMqtt::publishRaw(const char * topic, const char * payload, UTime & msgTime, int qos, bool retain)
+{
+  if (not use)
     // MQTT disabled in robot.ini
     return false;
   if (not connected)
@@ -279,9 +337,7 @@ bool UMqtt::publish(const char * topic, const char * payload, UTime & msgTime, i
     // mosquitto is probably not found
     return false;
   }
-  if (strlen(topic) < 5)
-    // no topic
-    return false;
+  UTime t0("now");
   mqttPublishLock.lock();  //
   //const auto mtime{system_clock::now()};
   //auto ms_since_epoch = duration_cast<milliseconds>(mtime.time_since_epoch());
@@ -296,7 +352,7 @@ bool UMqtt::publish(const char * topic, const char * payload, UTime & msgTime, i
   pubmsg.payload = (void*)s;
   pubmsg.payloadlen = (int)strlen(s);
   pubmsg.qos = qos;
-  pubmsg.retained = 0;
+  pubmsg.retained = retain;
   deliveredtoken = 0;
   int rc = MQTTClient_publishMessage(client, topic, &pubmsg, &token);
   char * nl = strchrnul(s, '\n');
@@ -317,6 +373,7 @@ bool UMqtt::publish(const char * topic, const char * payload, UTime & msgTime, i
       logLock.unlock();
     }
     publish_error++;
+    mTxErr->inc();
     if (publish_error > 200)
       connected = false;
     printf("Failed to publish message, return code %d\n", rc);
@@ -344,8 +401,10 @@ bool UMqtt::publish(const char * topic, const char * payload, UTime & msgTime, i
       usleep(1000L);
       #endif
     }
+    mTxMsg->inc();
   }
   mqttPublishLock.unlock();
+  mTxTime->observeSince(t0);
   return true;
 }
 
@@ -24,9 +24,53 @@
 #ifndef UMQTT_H
 #define UMQTT_H
 
+#include <string>
+#include <mutex>
+#include <thread>
 #include "MQTTClient.h"
 
 #include "utime.h"
+#include "umutex.h"
+
+class UMetricCounter;
+class UMetricHistogram;
+
+/**
+ * A topic that is resolved once (at setup time),
+ * so that publishing needs no string building or ini-file lookup.
+ * The full topic name is stored with the quality of service and retain flag. */
+class UMqttTopic
+{
+public:
+  /**
+   * Set the topic
+   * \param fullTopic is the full topic name, e.g. robobot/drive/T0/mvel
+   * \param qos quality of service: 0: at most once (fast), 1: at least once, 2: exactly once
+   * \param retain should the broker keep the last message for new subscribers */
+  void setup(const std::string & fullTopic, int topicQos = 0, bool topicRetain = false)
+  {
+    name = fullTopic;
+    qos = topicQos;
+    retain = topicRetain;
+  }
+  /**
+   * Is the topic set (a topic of less than 5 characters is not used) */
+  inline bool valid() const
+  {
+    return name.size() >= 5;
+  }
+  /**
+   * Topic as C-string */
+  inline const char * c_str() const
+  {
+    return name.c_str();
+  }
+
+public:
+  std::string name;
+  int qos = 0;
+  bool retain = false;
+};
 
 
 /**
@@ -60,15 +104,38 @@ public:
    * \param qos quality of service: 0: at most once (fast), 1: at least once (resend if fail), 2: exactly once
    */
   bool publish(const char * topic, const char * payload, UTime & msgTime, int qos = 0);
+  /**
+   * Publish a message to a topic resolved at setup time.
+   * This is the preferred version for data that is published often.
+   * \param topic is the pre-build topic (with qos and retain flag)
+   * \param payload a string with parameters in clear text
+   * \param msgTime is the timestamp added in front of the payload */
+  bool publish(const UMqttTopic & topic, const char * payload, UTime & msgTime);
   /**
    * \param topic is something like robobot/drive/t1/mot
    * \param qos, quality of service: 0: at most once (fast), 1: at least once (resend if fail), 2: exactly once
    * \return true (error handling not implemented */
   bool subscribe(const char * topic, int qos);
+  /**
+   * MQTT client ID that is unique on a shared broker, as the broker
+   * closes an existing session when another client connects with the same ID.
+   * \param base is the ID from robot.ini, e.g. 'tif_out'
+   * \returns base, robot namespace and host name, e.g. 'tif_out_r17_pi17' */
+  std::string clientId(const std::string & base);
 
   bool connected = false;
+  /// MQTT enabled in robot.ini (read at setup only)
+  bool use = false;
+  /// topic root for this robot, system + robot namespace, e.g. 'robobot/' or 'robobot/r17/'
+  std::string root = "robobot/";
+  /// topic root for commands to all robots (used if fleet is true)
+  std::string fleetRoot = "robobot/fleet/";
+  bool fleet = false;
 
 private:
+  /**
+   * The common publish function */
+  bool publishRaw(const char * topic, const char * payload, UTime & msgTime, int qos, bool retain);
   // logfile
   bool toConsole = false;
   FILE * logfile = nullptr;
@@ -82,13 +149,17 @@ private:
   MQTTClient_deliveryToken token;
   MQTTClient_deliveryToken deliveredtoken;
   //
-  std::mutex mqttPublishLock;
-  std::mutex logLock;
+  UMutex mqttPublishLock;
+  UMutex logLock;
   //
   static void delivered(void */*context*/, MQTTClient_deliveryToken dt);
   static int msgarrvd(void */*context*/, char *topicName, int /*topicLen*/, MQTTClient_message *message);
   static void connlost(void */*context*/, char *cause);
   int publish_error = 0;
+  // metrics
+  UMetricCounter * mTxMsg = nullptr;
+  UMetricCounter * mTxErr = nullptr;
+  UMetricHistogram * mTxTime = nullptr;
 
   // static void runObj(UMqtt * obj)
   // { // called, when thread is started
@@ -30,6 +30,8 @@
 #include <iostream>
 #include "uservice.h"
 #include "umqttin.h"
+#include "umqtt.h"
+#include "utimeline.h"
 
 using namespace std::chrono;
 
@@ -49,13 +51,18 @@ void UMqttIn::setup()
   { // no data yet, so generate some default values
     ini["mqttin"]["broker"] = "tcp://localhost:1883"; // IP and port to broker
     ini["mqttin"]["context"] = "drive"; // not used
-    ini["mqttin"]["clientid"] = "tif_in"; // data source for publish
+    ini["mqttin"]["clientid"] = "tif_in"; // data source for publish (robot namespace and host name are added)
     ini["mqttin"]["function"] = "drive/"; // drive/ or crane/. Function of this process
     ini["mqttin"]["system"] = "robobot/"; // top name in MQTT topic
     ini["mqttin"]["log"] = "true";
     ini["mqttin"]["print"] = "false";
     ini["mqttin"]["use"] = "true";
   }
+  mRxMsg = metrics.counter("mqtt_rx_messages_total", "MQTT messages received");
+  mRxUnused = metrics.counter("mqtt_rx_unused_total", "MQTT messages received, but not used");
+  mHandleTime = metrics.histogram("mqtt_rx_handle_seconds", "Time to handle a received MQTT message");
+  mqttPublishLock.setup("mqttin_publish");
+  logLock.setup("mqttin_log");
   if (ini["mqttin"]["print"] == "true")
   // logfiles
   toConsole = ini["mqttin"]["print"] == "true";
@@ -66,7 +73,7 @@ void UMqttIn::setup()
     fprintf(logfile, "%% mqtt logfile, enabled=%s\n", ini["mqttin"]["use"].c_str());
     fprintf(logfile, "%% broker=%s\n", ini["mqttin"]["broker"].c_str());
     fprintf(logfile, "%% context=%s\n", ini["mqttin"]["context"].c_str());
-    fprintf(logfile, "%% client id=%s\n", ini["mqttin"]["clientid"].c_str());
+    fprintf(logfile, "%% client id=%s\n", mqtt.clientId(ini["mqttin"]["clientid"]).c_str());
     fprintf(logfile, "%% system=%s (top level ID)\n", ini["mqttin"]["system"].c_str());
     fprintf(logfile, "%% function=%s (next level name)\n", ini["mqttin"]["function"].c_str());
     fprintf(logfile, "%% 1 \tTime (sec)\n");
@@ -83,7 +90,7 @@ void UMqttIn::setup()
     bool isOK = false;
     rc = MQTTClient_create(&client,
                             ini["mqttin"]["broker"].c_str(),
-                            ini["mqttin"]["clientid"].c_str(),
+                            mqtt.clientId(ini["mqttin"]["clientid"]).c_str(),
                             MQTTCLIENT_PERSISTENCE_NONE,
                             NULL);
     isOK = rc == MQTTCLIENT_SUCCESS;
@@ -136,7 +143,10 @@ void UMqttIn::setup()
     {
       printf("# UMqttIn:: connection to MQTT broker on %s established\n", ini["mqttin"]["broker"].c_str());
       // subscribe
-      subscribe("robobot/cmd/#", 1);
+      subscribe((mqtt.root + "cmd/#").c_str(), 1);
+      if (mqtt.fleet)
+        // commands to all robots (opt-in)
+        subscribe((mqtt.fleetRoot + "cmd/#").c_str(), 1);
     }
     //end MQTT
 
@@ -224,6 +234,8 @@ int UMqttIn::msgarrvd(void *context, char *topicName, int /*topicLen*/, MQTTClie
   }
   //
   UTime t("now");
+  timeline.threadName("mqtt_in");
+  UTimelineScope ts("mqtt_rx");
   const int MSL = 200;
   char s[MSL];
   int n = 200;
@@ -234,6 +246,10 @@ int UMqttIn::msgarrvd(void *context, char *topicName, int /*topicLen*/, MQTTClie
   strncpy(s, (char*)message->payload, n);
   s[n] = '\0';
   bool used = service.mqttDecode(topicName, s, t);
+  mqttin.mRxMsg->inc();
+  if (not used)
+    mqttin.mRxUnused->inc();
+  mqttin.mHandleTime->observeSince(t);
   mqttin.toLogRx((char*)context, topicName, s, message->qos, t, used);
   //
   MQTTClient_freeMessage(&message);
@@ -26,6 +26,8 @@
 #include "MQTTClient.h"
 
 #include "utime.h"
+#include "umetrics.h"
+#include "umutex.h"
 
 
 /**
@@ -81,13 +83,17 @@ private:
   MQTTClient_deliveryToken token;
   MQTTClient_deliveryToken deliveredtoken;
   //
-  std::mutex mqttPublishLock;
-  std::mutex logLock;
+  UMutex mqttPublishLock;
+  UMutex logLock;
   //
   static void delivered(void */*context*/, MQTTClient_deliveryToken dt);
   static int msgarrvd(void */*context*/, char *topicName, int /*topicLen*/, MQTTClient_message *message);
   static void connlost(void */*context*/, char *cause);
   int publish_error = 0;
+  // metrics
+  UMetricCounter * mRxMsg = nullptr;
+  UMetricCounter * mRxUnused = nullptr;
+  UMetricHistogram * mHandleTime = nullptr;
 
   // static void runObj(UMqttIn * obj)
   // { // called, when thread is started
@@ -0,0 +1,173 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <cinttypes>
+#include <mutex>
+
+#include "umqttrouter.h"
+
+// create value
+UMqttRouter router;
+
+UMqttRouteNode::~UMqttRouteNode()
+{
+  for (auto & c : child)
+    delete c.second;
+  if (plus != nullptr)
+    delete plus;
+}
+
+UMqttRouter::~UMqttRouter()
+{
+  for (UMqttRoute * r : all)
+    delete r;
+}
+
+bool UMqttRouter::add(const std::string & pattern, const char * name, UMqttHandler handler)
+{
+  std::unique_lock<std::shared_mutex> lock(treeLock);
+  if (mUnmatched == nullptr)
+    mUnmatched = metrics.counter("mqtt_route_unmatched_total", "MQTT messages with no matching route");
+  UMqttRoute * r = new UMqttRoute();
+  r->name = name;
+  r->pattern = pattern;
+  r->handler = handler;
+  std::string lb = "route=\"" + r->name + "\"";
+  r->mTime = metrics.histogram("mqtt_route_seconds", "Time used by MQTT route handler", lb.c_str());
+  // walk (and extend) the tree
+  UMqttRouteNode * node = &root;
+  bool wild = false;
+  size_t p = 0;
+  while (true)
+  {
+    size_t e = pattern.find('/', p);
+    std::string level = pattern.substr(p, e == std::string::npos ? std::string::npos : e - p);
+    bool last = e == std::string::npos;
+    if (level == "#")
+    {
+      if (not last)
+      {
+        printf("# UMqttRouter::add: '#' must be last in '%s' - ignored\n", pattern.c_str());
+        delete r;
+        return false;
+      }
+      node->hash.push_back(r);
+      break;
+    }
+    if (level == "+")
+    {
+      wild = true;
+      if (node->plus == nullptr)
+        node->plus = new UMqttRouteNode();
+      node = node->plus;
+    }
+    else
+    {
+      if (not wild and not last)
+        r->fixedLevels++;
+      auto it = node->child.find(level);
+      if (it == node->child.end())
+        it = node->child.emplace(level, new UMqttRouteNode()).first;
+      node = it->second;
+    }
+    if (last)
+    {
+      node->routes.push_back(r);
+      break;
+    }
+    p = e + 1;
+  }
+  all.push_back(r);
+  return true;
+}
+
+bool UMqttRouter::call(UMqttRoute * r, const char * topic, const char * payload, UTime & msgTime)
+{ // find the tail - after the fixed levels
+  const char * tail = topic;
+  for (int i = 0; i < r->fixedLevels and tail != nullptr; i++)
+  {
+    tail = strchr(tail, '/');
+    if (tail != nullptr)
+      tail++;
+  }
+  if (tail == nullptr)
+    tail = "";
+  UTime t("now");
+  bool used = r->handler(topic, tail, payload, msgTime);
+  r->mTime->observeSince(t);
+  return used;
+}
+
+bool UMqttRouter::match(UMqttRouteNode * node, const char * topic, const char * level,
+                        const char * payload, UTime & msgTime)
+{
+  if (level == nullptr)
+  { // all levels used - routes ending here
+    for (UMqttRoute * r : node->routes)
+      if (call(r, topic, payload, msgTime))
+        return true;
+  }
+  else
+  {
+    const char * e = strchrnul(level, '/');
+    const char * next = nullptr;
+    if (*e == '/')
+      next = e + 1;
+    std::string_view lv(level, e - level);
+    // most specific first
+    auto it = node->child.find(lv);
+    if (it != node->child.end())
+      if (match(it->second, topic, next, payload, msgTime))
+        return true;
+    if (node->plus != nullptr)
+      if (match(node->plus, topic, next, payload, msgTime))
+        return true;
+  }
+  // '#' matches the rest (also the parent level)
+  for (UMqttRoute * r : node->hash)
+    if (call(r, topic, payload, msgTime))
+      return true;
+  return false;
+}
+
+bool UMqttRouter::route(const char * topic, const char * payload, UTime & msgTime)
+{
+  bool used;
+  {
+    std::shared_lock<std::shared_mutex> lock(treeLock);
+    used = match(&root, topic, topic, payload, msgTime);
+  }
+  if (not used and mUnmatched != nullptr)
+    mUnmatched->inc();
+  return used;
+}
+
+void UMqttRouter::list()
+{
+  std::shared_lock<std::shared_mutex> lock(treeLock);
+  printf("# UMqttRouter:: %d routes\n", (int)all.size());
+  for (UMqttRoute * r : all)
+    printf("#   %-14s %s (%" PRIu64 " calls)\n", r->name.c_str(), r->pattern.c_str(),
+           r->mTime->getCount());
+}
@@ -0,0 +1,126 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utime.h"
+#include "umetrics.h"
+
+/**
+ * Function to handle a MQTT message
+ * \param topic is the full topic
+ * \param tail is the part of the topic matched by the first wildcard,
+ *        e.g. 'motv' for topic 'robobot/cmd/T0/motv' and pattern 'robobot/cmd/T0/#'
+ *        (the last level if the pattern has no wildcards).
+ * \param payload is the message
+ * \param msgTime is the time the message arrived
+ * \returns true if the message was used */
+typedef std::function<bool (const char * topic, const char * tail,
+                            const char * payload, UTime & msgTime)> UMqttHandler;
+
+/**
+ * A handler with its (timing) statistics */
+class UMqttRoute
+{
+public:
+  std::string name;
+  std::string pattern;
+  UMqttHandler handler;
+  /// number of wildcard-free levels in pattern (tail starts here)
+  int fixedLevels = 0;
+  /// handle time for this route
+  UMetricHistogram * mTime = nullptr;
+};
+
+/**
+ * One level in the topic tree */
+class UMqttRouteNode
+{
+public:
+  ~UMqttRouteNode();
+  /// children with a fixed level name (std::less<> allows lookup without a copy)
+  std::map<std::string, UMqttRouteNode *, std::less<>> child;
+  /// child for the '+' (single level) wildcard
+  UMqttRouteNode * plus = nullptr;
+  /// routes ending at this level
+  std::vector<UMqttRoute *> routes;
+  /// routes ending with '#' at this level (match the rest of the topic)
+  std::vector<UMqttRoute *> hash;
+};
+
+/**
+ * Router for incoming MQTT messages.
+ * Modules add a topic pattern (with MQTT wildcards '+' and '#') and a handler.
+ * The topic is matched one level at a time, so the time used depends
+ * on the topic depth only, not on the number of handlers.
+ * The most specific handler is tried first:
+ * exact level, then '+' then '#'. Routing stops when a handler
+ * returns true (message used). */
+class UMqttRouter
+{
+public:
+  ~UMqttRouter();
+  /**
+   * Add a route
+   * \param pattern is e.g. 'robobot/cmd/T0/#' or 'robobot/cmd/+/alive'
+   * \param name is a short name used in metrics and logs, e.g. 'teensy_fwd'
+   * \param handler is the function to call for matching topics
+   * \returns false if the pattern is invalid ('#' not last) */
+  bool add(const std::string & pattern, const char * name, UMqttHandler handler);
+  /**
+   * Find and call handler(s) for this topic
+   * \returns true if the message was used */
+  bool route(const char * topic, const char * payload, UTime & msgTime);
+  /**
+   * Print routes to console */
+  void list();
+
+private:
+  /**
+   * Match one level (recursive)
+   * \param node is the tree node for this level
+   * \param level is the start of this level in topic (or nullptr if all levels are used)
+   * \returns true if used */
+  bool match(UMqttRouteNode * node, const char * topic, const char * level,
+             const char * payload, UTime & msgTime);
+  /**
+   * Call a route handler and measure the time */
+  bool call(UMqttRoute * r, const char * topic, const char * payload, UTime & msgTime);
+  //
+  UMqttRouteNode root;
+  std::vector<UMqttRoute *> all;
+  std::shared_mutex treeLock;
+  UMetricCounter * mUnmatched = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UMqttRouter router;
+
@@ -0,0 +1,59 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string>
+
+#include "umutex.h"
+#include "umetrics.h"
+
+void UMutex::setup(const char * name, const char * labels)
+{
+  if (instrumented.load(std::memory_order_acquire))
+    return;
+  std::string lb = "lock=\"" + std::string(name) + "\"";
+  if (labels[0] != '\0')
+    lb += std::string(",") + labels;
+  mAcquired = metrics.counter("lock_acquired_total", "Times the lock was taken", lb.c_str());
+  mContended = metrics.counter("lock_contended_total", "Times the lock was held by another thread", lb.c_str());
+  mWait = metrics.histogram("lock_wait_seconds", "Time waiting for the lock when contended", lb.c_str());
+  mHold = metrics.histogram("lock_hold_seconds", "Time from lock to unlock", lb.c_str());
+  // set last, as this enables the instrumentation
+  instrumented.store(true, std::memory_order_release);
+}
+
+void UMutex::locked(int64_t waitStart)
+{
+  lockedAt = nowNs();
+  mAcquired->inc();
+  if (waitStart != 0)
+  {
+    mContended->inc();
+    mWait->observe((lockedAt - waitStart) * 1e-9);
+  }
+}
+
+void UMutex::released()
+{
+  mHold->observe((nowNs() - lockedAt) * 1e-9);
+  lockedAt = 0;
+}
@@ -0,0 +1,106 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <mutex>
+#include <atomic>
+
+class UMetricCounter;
+class UMetricHistogram;
+
+/**
+ * A mutex that measures how it is used, for locks shared between
+ * threads in the control path. Per named lock (metrics label lock="name"):
+ * - lock_acquired_total: number of times locked,
+ * - lock_contended_total: times the lock was held by another thread,
+ * - lock_wait_seconds: time waiting for the lock (when contended),
+ * - lock_hold_seconds: time from lock to unlock.
+ * An uncontended lock costs a try_lock and two clock reads.
+ * Until setup() is called, it is a plain mutex.
+ * Can be used with std::lock_guard<UMutex>. */
+class UMutex
+{
+public:
+  /**
+   * Name the lock and register metrics
+   * \param name is the lock name, e.g. 'teensy_send'
+   * \param labels is optional extra metrics labels, e.g. tn="0" */
+  void setup(const char * name, const char * labels = "");
+  inline void lock()
+  {
+    if (not instrumented.load(std::memory_order_acquire))
+    {
+      mtx.lock();
+      return;
+    }
+    int64_t waitStart = 0;
+    if (not mtx.try_lock())
+    { // another thread has the lock
+      waitStart = nowNs();
+      mtx.lock();
+    }
+    locked(waitStart);
+  }
+  inline bool try_lock()
+  {
+    bool isOK = mtx.try_lock();
+    if (isOK and instrumented.load(std::memory_order_acquire))
+      locked(0);
+    return isOK;
+  }
+  inline void unlock()
+  {
+    if (lockedAt != 0)
+      // locked while instrumented
+      released();
+    mtx.unlock();
+  }
+
+private:
+  static inline int64_t nowNs()
+  {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+  }
+  /**
+   * Lock is taken
+   * \param waitStart is when waiting started, 0 if not contended */
+  void locked(int64_t waitStart);
+  /** lock is about to be released */
+  void released();
+  std::mutex mtx;
+  /// set (release) by setup() after the metrics, so a thread that
+  /// sees it set (acquire) also sees the metrics
+  std::atomic<bool> instrumented{false};
+  /// time of lock (by the thread holding the lock)
+  int64_t lockedAt = 0;
+  UMetricCounter * mAcquired = nullptr;
+  UMetricCounter * mContended = nullptr;
+  UMetricHistogram * mWait = nullptr;
+  UMetricHistogram * mHold = nullptr;
+};
@@ -0,0 +1,99 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+/**
+ * Notification from a data producer to the threads using the data,
+ * e.g. encoder -> velocity -> motor control.
+ * The producer calls notify() for every new value, and the user thread
+ * sleeps in wait() until there is a new value, rather than polling.
+ * A notify while the user is busy is not lost, as the user keeps
+ * the count of the last seen notification (unsigned, so it may wrap).
+ * With poll = true the users poll with their own period instead
+ * (as before notification), e.g. to compare the sample to motor
+ * voltage latency. */
+class UNotify
+{
+public:
+  /**
+   * New data is available, wake all waiting threads */
+  void notify()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      cnt++;
+    }
+    cv.notify_all();
+  }
+  /**
+   * Wait for a notification newer than 'seen' (or timeout)
+   * \param seen is the count of the last seen notification, updated on return
+   * \param timeoutSec is the maximum time to wait (sec)
+   * \param pollPeriodSec is the loop period of this user when polling (poll = true),
+   *        0 is always wait for notification
+   * \returns true if there is new data, false on timeout */
+  bool wait(uint32_t & seen, float timeoutSec, float pollPeriodSec = 0)
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    bool isNew;
+    if (poll and pollPeriodSec > 0)
+    { // poll, ignore notifications
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::duration<float>(pollPeriodSec));
+      lock.lock();
+      isNew = cnt != seen;
+    }
+    else
+      isNew = cv.wait_for(lock, std::chrono::duration<float>(timeoutSec),
+                          [&]{ return cnt != seen; });
+    seen = cnt;
+    return isNew;
+  }
+  /**
+   * Monotonic time in ns, to time the data flow
+   * (also when replaying, where UTime is the logged time) */
+  static inline int64_t nowNs()
+  {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+  }
+  /// poll with the period of each user rather than wait for notification (ini [service] chain_poll)
+  static inline bool poll = false;
+
+private:
+  std::mutex mtx;
+  std::condition_variable cv;
+  /// number of notifications
+  uint32_t cnt = 0;
+};
@@ -186,19 +186,11 @@ void UPID::resetHistory()
 }
 
 
-void UPID::saveToLog(FILE* logfile, UTime t)
+void UPID::saveToLog(ULogStream * log, UTime t)
 {// log_pose
-  if (logfile != nullptr and not service.stop_logging)
+  if (log != nullptr and not service.stop_logging)
   {
-    fprintf(logfile, "%lu.%04ld %.3f %.3f %.3f %.3f %.3f %.3f %d\n",
-            t.getSec(), t.getMicrosec()/100,
-            r, m,
-            ep1,
-            up1,
-            ui1,
-            u,
-            limited
-    );
+    log->log(t, r, m, ep1, up1, ui1, u, limited);
   }
   if (toConsole)
   {
@@ -25,6 +25,7 @@
 #define UPID_H
 
 #include "utime.h"
+#include "ulogger.h"
 
 using namespace std;
 // forward declaration
@@ -57,10 +58,10 @@ public:
   void logPIDparams(FILE * logfile, bool andColumns);
   /**
    * Sage the current control values to this logfile
-   * \param logfile is a valid file handle
+   * \param log is the log stream (or nullptr)
    * \param t is the time where the values are valid
    * */
-  void saveToLog(FILE * logfile, UTime t);
+  void saveToLog(ULogStream * log, UTime t);
   /**
    * reference and measurement may be in radians
    * ensure correct folding of angles. */
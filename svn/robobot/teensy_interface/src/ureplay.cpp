@@ -0,0 +1,181 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <string.h>
+#include <chrono>
+
+#include "ureplay.h"
+#include "uservice.h"
+#include "steensy.h"
+#include "ulogger.h"
+#include "umetrics.h"
+#include "utimerqueue.h"
+
+// create value
+UReplay replay;
+
+
+bool UReplay::setup(std::string file, float replaySpeed)
+{
+  fileName = file;
+  speed = replaySpeed;
+  gz = gzopen(file.c_str(), "r");
+  if (gz == nullptr)
+  {
+    printf("# UReplay:: failed to open %s\n", file.c_str());
+    return false;
+  }
+  const int MSL = 1000;
+  char s[MSL];
+  int64_t t;
+  if (not nextRx(t, s, MSL))
+  {
+    printf("# UReplay:: no Teensy messages (Rx) in %s\n", file.c_str());
+    gzclose(gz);
+    gz = nullptr;
+    return false;
+  }
+  gzrewind(gz);
+  // run the clock from a minute before the first message,
+  // so that the time is not going back, when the replay starts
+  UTime now;
+  gettimeofday(&now.time, nullptr);
+  int64_t real = now.time.tv_sec * 1000000LL + now.time.tv_usec;
+  UTime::setClockOffset(t - 60000000 - real);
+  active = true;
+  printf("# UReplay:: replay of %s at speed %g (0 = as fast as possible)\n", file.c_str(), speed);
+  return true;
+}
+
+void UReplay::start()
+{
+  if (not active or th1 != nullptr)
+    return;
+  // no log lines are dropped, when replaying fast
+  logger.waitWhenFull = true;
+  th1 = new std::thread(runObj, this);
+}
+
+void UReplay::terminate()
+{
+  if (th1 != nullptr)
+  {
+    th1->join();
+    delete th1;
+    th1 = nullptr;
+  }
+  if (gz != nullptr)
+  {
+    gzclose(gz);
+    gz = nullptr;
+  }
+}
+
+bool UReplay::nextRx(int64_t & t, char * msg, int n)
+{ // lines are like '1740927630.1234 Rx ;34hbt 12.3 ...'
+  const int MSL = 1000;
+  char s[MSL];
+  while (gzgets(gz, s, MSL) != nullptr)
+  {
+    char * p1 = s;
+    if (not isdigit(*p1))
+      // comment or header
+      continue;
+    int64_t sec = strtoll(p1, &p1, 10);
+    int64_t usec = 0;
+    if (*p1 == '.')
+    {
+      char * p2 = p1 + 1;
+      usec = strtol(p2, &p1, 10);
+      for (int d = p1 - p2; d < 6; d++)
+        usec *= 10;
+    }
+    if (strncmp(p1, " Rx ", 4) != 0)
+      // not a received message
+      continue;
+    t = sec * 1000000 + usec;
+    strncpy(msg, p1 + 4, n);
+    msg[n - 1] = '\0';
+    return true;
+  }
+  return false;
+}
+
+void UReplay::run()
+{
+  const int MSL = 1000;
+  char s[MSL];
+  int64_t t;
+  int64_t t0 = -1;
+  int64_t last = 0;
+  int cnt = 0;
+  auto wall0 = std::chrono::steady_clock::now();
+  while (not service.stop and nextRx(t, s, MSL))
+  {
+    if (t < last)
+      // keep the clock from going back (e.g. an NTP update in the log)
+      t = last;
+    if (t0 < 0)
+      t0 = t;
+    if (speed > 0)
+    { // keep logged timing
+      std::this_thread::sleep_until(wall0 + std::chrono::microseconds((int64_t)((t - t0) / speed)));
+    }
+    UTime::setVirtualTime(t);
+    // timed commands follow the replay clock
+    timerQueue.clockChanged();
+    teensy[0].replayLine(s);
+    last = t;
+    cnt++;
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+  double logged = (last - t0) * 1e-6;
+  printf("# UReplay:: replayed %d messages (%.1f s of log) in %.3f s (%.0f messages/s, %.1f times real time)\n",
+         cnt, logged, wall, cnt / wall, logged / wall);
+  { // sample to motor voltage latency (count, mean, 50%, 99%, max in ms)
+    const int MSL = 200;
+    char s[MSL];
+    const char * names[] = {"motor_sample_delay_seconds", "motor_control_latency_seconds"};
+    for (const char * n : names)
+    {
+      // gets the existing histogram (from CMotor::setup)
+      UMetricHistogram * m = metrics.histogram(n, "", "tn=\"0\"");
+      if (m != nullptr and m->getCount() > 0)
+      {
+        m->toPayload(s, MSL);
+        printf("# UReplay:: %s (cnt mean p50 p99 max ms) %s\n", n, s);
+      }
+    }
+  }
+  if (service.logfile != nullptr)
+  {
+    fprintf(service.logfile, "%lu.%04ld Replayed %d messages from %s in %.3f s\n",
+            (unsigned long)(last / 1000000), (long)(last % 1000000) / 100, cnt, fileName.c_str(), wall);
+  }
+  // let the clock run from the last logged time
+  UTime now;
+  gettimeofday(&now.time, nullptr);
+  UTime::setClockOffset(last - (now.time.tv_sec * 1000000LL + now.time.tv_usec));
+  UTime::setVirtualTime(0);
+  service.stopNow("replay finished");
+}
@@ -0,0 +1,88 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <zlib.h>
+
+#include "utime.h"
+
+/**
+ * Replay of a Teensy io log (e.g. log_t0_teensy_io.txt, or a .gz segment).
+ * The received lines (Rx) are handled as if received from Teensy 0,
+ * i.e. decoded, used by the modules, logged and published,
+ * while the clock (UTime::now()) is set to the logged time of the message.
+ * Messages to the Teensy are logged in the io log only.
+ * The replay is with the logged timing (speed=1), faster or slower,
+ * or as fast as possible (speed=0), the app stops when the log is replayed.
+ * The logfiles from a replay have the logged time, so the logs from
+ * two versions of the software can be compared line by line.
+ * What follows the logged clock: the decode path, the data driven
+ * chain (encoder -> velocity -> motor control), command ages,
+ * trajectory segment times and timed ('@<time>') commands.
+ * Loops with a fixed period (mixer, service, logger) keep their real
+ * period, so with a speed other than 1 they run more (or fewer) times
+ * for each logged second, and their output is not deterministic.
+ * Started by the command line option '--replay <file>'. */
+class UReplay
+{
+public:
+  /**
+   * Prepare replay (from command line)
+   * \param file is the Teensy io log to replay
+   * \param replaySpeed is 1 for logged timing, 0 is as fast as possible
+   * \returns true if the file has messages to replay */
+  bool setup(std::string file, float replaySpeed);
+  /** start the replay (when all modules are set up) */
+  void start();
+  /** stop replay thread */
+  void terminate();
+  /** replay thread */
+  void run();
+  /// replay is used (no Teensy)
+  bool active = false;
+
+private:
+  static void runObj(UReplay * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * Get next received message from the log
+   * \param t is set to the logged time (microseconds since epoch)
+   * \param msg is set to the message (with CRC)
+   * \param n is the size of msg
+   * \returns false at end of file */
+  bool nextRx(int64_t & t, char * msg, int n);
+  std::string fileName;
+  gzFile gz = nullptr;
+  float speed = 1.0;
+  std::thread * th1 = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UReplay replay;
@@ -49,6 +49,22 @@
 #include "steensy.h"
 #include "umqtt.h"
 #include "umqttin.h"
+#include "umetrics.h"
+#include "umqttrouter.h"
+#include "umailbox.h"
+#include "utimerqueue.h"
+#include "utrace.h"
+#include "ushm.h"
+#include "usnapshot.h"
+#include "usse.h"
+#include "ulogger.h"
+#include "ulogstage.h"
+#include "ureplay.h"
+#include "uflightrec.h"
+#include "utimeline.h"
+#include "udiag.h"
+#include "ulooptimer.h"
+#include "unotify.h"
 #include "uservice.h"
 
 #define REV "$Id: uservice.cpp 1167 2025-03-02 15:40:30Z jcan $"
@@ -56,6 +72,8 @@
 UService service;
 // make a configuration structure
 mINI::INIStructure ini;
+// diagnostics level for this module
+static UDiagModule dg("service");
 
 void signal_callback_handler(int signum)
 { // called when pressing ctrl-C
@@ -66,6 +84,8 @@ void signal_callback_handler(int signum)
     printf("# signal_callback_handler: setting stopNowRequest to true\r\n");
     service.stopNowRequest = true;
   }
+  // get staged logs to the SD card now
+  logstage.flushRequest = true;
   // service.terminate();
   // exit(signum);
 }
@@ -102,6 +122,14 @@ bool UService::setup(int argc,char **argv)
   // rename feature
   int regbotHardware{-1};
   cli.add_option("-H,--hardware", regbotHardware, "Set robot hardware type (most likely 8) use with --interface.");
+  // replay of logged Teensy data
+  std::string replayFile;
+  cli.add_option("-r,--replay", replayFile, "Replay a Teensy io log (e.g. log_t0_teensy_io.txt) instead of using the Teensy");
+  float replaySpeed = 1.0;
+  cli.add_option("--replay-speed", replaySpeed, "Replay speed, 1 is logged timing, 0 is as fast as possible (default 1)");
+  // logging latency
+  float logBench = 0;
+  cli.add_option("--log-bench", logBench, "Time Teensy io logging, direct and using the logger, for some time (seconds), then end");
   //
   // Parse for command line options
   cli.allow_windows_style_options();
@@ -109,6 +137,10 @@ bool UService::setup(int argc,char **argv)
   CLI11_PARSE(cli, argc, argv);
   // if we get here, then command line parameters are OK to continue
   theEnd = false;
+  if (not replayFile.empty())
+  { // this sets the clock to the logged time
+    theEnd = not replay.setup(replayFile, replaySpeed);
+  }
   //
   // create an ini-file structure
   iniFile = new mINI::INIFile(iniFileName);
@@ -124,7 +156,24 @@ bool UService::setup(int argc,char **argv)
     ini["service"]["max_logging_minutes"] = "60.0";
     ini["service"]["log_service"] = "true";
   }
+  if (not ini["service"].has("cmd_max_age_ms"))
+  { // commands to Teensy with a sender timestamp (ts:<sec>) older than this are discarded
+    ini["service"]["cmd_max_age_ms"] = "500";
+  }
+  cmdMaxAge = strtof(ini["service"]["cmd_max_age_ms"].c_str(), nullptr) / 1000.0;
+  if (not ini["service"].has("chain_poll"))
+  { // false = encoder -> velocity -> motor control is event driven,
+    // true = poll as before (velocity 1 ms, motor 0.5 ms, mixer 1 ms), to compare the latency
+    ini["service"]["chain_poll"] = "false";
+  }
+  UNotify::poll = ini["service"]["chain_poll"] == "true";
   bool teensyConnect = ini["service"]["use_robot_hardware"] == "true";
+  if (teensyConnect and not replay.active and isThisProcessRunning("teensy_interfac") > 1)
+  { // only one process can use the robot hardware,
+    // more without hardware is OK (e.g. robot namespace tests)
+    printf("# ---- Teensy_interface is running already (stop with 'pkill teensy_interfac' ----\r\n");
+    theEnd = true;
+  }
   if (ini["service"].has("max_logging_minutes"))
     maxLogMinutes = strtod(ini["service"]["max_logging_minutes"].c_str(), nullptr);
   // Check for selected values
@@ -156,7 +205,6 @@ bool UService::setup(int argc,char **argv)
     printf("# NB!NB! hardware is disabled in robot.ini, no Teensy settings available\n");
     theEnd = true;
   }
-  topicMaster = ini["mqtt"]["system"] + ini["mqtt"]["function"] + "master";
   //
   //
   // for setup timing
@@ -174,6 +222,8 @@ bool UService::setup(int argc,char **argv)
     }
     std::error_code e;
     bool ok = filesystem::create_directory(logPath, e);
+    // logfiles may be written to a RAM disk, and copied to logPath later
+    logPath = logstage.path(logPath);
     if (ok)
     {
       printf("# UService:: created directory %s\n", logPath.c_str());
@@ -199,19 +249,48 @@ bool UService::setup(int argc,char **argv)
       fprintf(logfile, "%% 1 \tTime (sec)\n");
       fprintf(logfile, "%% 2 \tMessage\n");
     }
-    // mqtt
+    // mqtt (also sets the topic root for this robot)
     mqtt.setup();
+    topicMaster.setup(mqtt.root + ini["mqtt"]["function"] + "master");
+    topicShutdown.setup(mqtt.root + "cmd/shutdown", 1);
+    // routes for incoming commands (before any message may arrive)
+    setupMqttRoutes();
+    // commands to be done at a specific time
+    timerQueue.setup();
     mqttin.setup();
+    // counters, gauges and timing histograms (exported on MQTT and HTTP)
+    metrics.setup();
+    // diagnostics levels for each module (console and log)
+    diag.setup();
+    // period and execution time of loops (published and logged)
+    looptiming.setup();
+    // command latency tracing (commands with a 'tr:<id>')
+    tracer.setup();
+    // data logs are written by a separate thread
+    logger.setup();
+    // staged logfiles are copied to the SD card by a separate thread
+    logstage.setup();
+    // newest events in RAM, saved on faults
+    flightrec.setup();
+    // thread activity timeline (Chrome trace)
+    timeline.setup();
+    // newest state for local clients (shared memory)
+    shm.setup();
+    // get latest state on request (Unix socket and MQTT)
+    snapshot.setup();
+    // telemetry for browsers (server-sent events)
+    sse.setup();
     lastMqttMessage.now();
     // teensy interface
-    if (teensyConnect)
+    if (teensyConnect or replay.active)
     { // open the main data source
       for (int tn = 0; tn < NUM_TEENSY_MAX; tn++)
       { // these primary interfaces are related to a Teensy
         teensy[tn].setup(tn);
       }
       setupTeensyConnection();
-      gpio.setup();
+      if (not replay.active)
+        gpio.setup();
     }
     else
     {
@@ -231,7 +310,7 @@ bool UService::setup(int argc,char **argv)
     //
   }
   // Regbot (Teensy) need to accept settings before continue
-  if (not theEnd and teensyConnect)
+  if (not theEnd and teensyConnect and not replay.active)
   { // wait for all settings to be accepted
     for (int tn = 0; tn < NUM_TEENSY_MAX; tn++)
     {
@@ -269,6 +348,11 @@ bool UService::setup(int argc,char **argv)
       }
     }
   }
+  if (logBench > 0 and not theEnd)
+  { // logging benchmark only (robot hardware can be disabled in robot.ini)
+    logger.benchmark(logBench);
+    theEnd = true;
+  }
   // running from main loop
   if (not theEnd)
   { // start listen to the keyboard
@@ -292,6 +376,9 @@ bool UService::setup(int argc,char **argv)
     }
     theEnd = true;
   }
+  if (not theEnd)
+    // logged Teensy messages (if replay)
+    replay.start();
   return theEnd;
 }
 
@@ -332,125 +419,235 @@ void UService::setupTeensyConnection()
   }
 }
 
-bool UService::mqttDecode(const char* topic, const char * payload, UTime& msgTime)
-{ // message received from MQTT channel
-  bool used = true;
-  const int MSL = 100;
-  char s[MSL];
-  if (strncmp(topic, "robobot/cmd/T0/", 15) == 0)
-  { // message to the Teensy , pass on
-    const char * p1 = &topic[15];
-    std::snprintf(s, MSL, "%s %s\n", p1, payload);
-    bool ok = teensy[0].send(s);
-    if (not ok or true)
+void UService::setupMqttRoutes()
+{ // commands handled by the service itself
+  // other modules add their own routes in their setup()
+  const std::string cmd = mqtt.root + "cmd/";
+  mCmdExpired = metrics.counter("teensy_cmd_expired_total", "Commands to Teensy discarded as too old (sender timestamp)");
+  mBatchRejected = metrics.counter("teensy_batch_rejected_total", "Batch commands rejected (invalid)");
+  router.add(cmd + "T0/batch", "teensy_batch",
+    [this](const char * topic, const char *, const char * payload, UTime & msgTime)
+    { return mqttBatch(topic, payload, msgTime); });
+  router.add(cmd + "T0/#", "teensy_fwd",
+    [this](const char * topic, const char * tail, const char * payload, UTime & msgTime)
+    { return mqttToTeensy(topic, tail, payload, msgTime); });
+  router.add(cmd + "shutdown", "shutdown",
+    [this](const char * topic, const char *, const char * payload, UTime & msgTime)
     {
-      printf("# UService::mqttDecode: got '%s' '%s', send (queued) to T0 as '%s'", topic, payload, s);
-    }
+      if (logfile != nullptr)
+        fprintf(logfile, "%lu.%04ld Shutdown: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+      printf(" Uservice::mqttDecode %lu.%04ld Shutdown: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+      power_off_request(false, payload);
+      return true;
+    });
+  router.add(cmd + "ti/log", "log",
+    [this](const char * topic, const char *, const char * payload, UTime & msgTime)
+    { return mqttLog(topic, payload, msgTime); });
+  router.add(cmd + "ti/alive", "alive",
+    [this](const char *, const char *, const char * payload, UTime & msgTime)
+    { return mqttAlive(payload, msgTime); });
+}
+
+bool UService::mqttToTeensy(const char * topic, const char * tail, const char * payload, UTime & msgTime)
+{ // message to the Teensy, pass on
+  if (*tail == '\0')
+    // no command
+    return false;
+  // optional sender timestamp
+  UTime cmdTime = msgTime;
+  const char * params = getSenderTime(payload, cmdTime);
+  if (cmdMaxAge > 0 and cmdTime.getTimePassed() > cmdMaxAge)
+  { // too old, the robot should not act on old orders
+    mCmdExpired->inc();
+    if (logfile != nullptr)
+      fprintf(logfile, "%lu.%04ld Discarded %.3fs old command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100,
+              cmdTime.getTimePassed(), topic, payload);
+    return true;
   }
-  else if (strncmp(topic, "robobot/cmd/shutdown", 19) == 0)
+  const int MSL = 400;
+  char s[MSL];
+  std::snprintf(s, MSL, "%s %s\n", tail, params);
+  bool ok = teensy[0].send(s);
+  if (not ok)
   {
+    printf("# UService::mqttToTeensy: got '%s' '%s', failed to send to T0 as '%s'", topic, payload, s);
     if (logfile != nullptr)
-      fprintf(logfile, "%lu.%04ld Shutdown: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
-    printf(" Uservice::mqttDecode %lu.%04ld Shutdown: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
-    power_off_request(false, payload);
-  }
-  else if (strncmp(topic, "robobot/cmd/ti/", 15) == 0)
-  { // message to this teensy_interface
-    const char * p1 = &topic[15];
-    bool used = true;
-    // if (logfile != nullptr)
-    //   fprintf(logfile, "%lu.%04ld Interface command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
-    // printf("# pre  %lu.%04ld Interface command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
-    // decode message to this interface
-    if (mixer.decode(p1, payload, msgTime))
+      fprintf(logfile, "%lu.%04ld Failed to send to Teensy: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+  }
+  return true;
+}
+
+bool UService::mqttBatch(const char * topic, const char * payload, UTime & msgTime)
+{ // more Teensy commands separated by ';', e.g. 'servo 1 200 200; leds 16 0 0 100'
+  UTime cmdTime = msgTime;
+  const char * p1 = getSenderTime(payload, cmdTime);
+  if (cmdMaxAge > 0 and cmdTime.getTimePassed() > cmdMaxAge)
+  { // too old
+    mCmdExpired->inc();
+    return true;
+  }
+  // split and validate all before sending any
+  const int MAX_BATCH_CMDS = 20;
+  // Teensy receive buffer is 200 characters, including CRC
+  const int MAX_CMD_LENGTH = 190;
+  const int MAX_BATCH_LENGTH = 1000;
+  std::vector<std::string> cmds;
+  const char * err = nullptr;
+  int total = 0;
+  while (*p1 != '\0' and err == nullptr)
+  {
+    while (isspace(*p1))
+      p1++;
+    const char * e = strchrnul(p1, ';');
+    const char * q = e;
+    while (q > p1 and isspace(q[-1]))
+      q--;
+    int n = q - p1;
+    if (n > 0)
     {
-      if (logfile != nullptr)
-        fprintf(logfile, "%lu.%04ld Mixer order: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
-    }
-    else if (strncmp(p1, "log", 3) == 0)
-    { // start or stop logging
-      int v = strtol(payload, nullptr, 10);
-      stop_logging = v == 0;
-      if (stop_logging)
-      { // tell keyboard function to flush
-        UTime t("now");
-        flushLog = true;
-      }
-      else
-      {
-        printf("# Started logging\n");
-        startedLogging.now();
-      }
-      if (logfile != nullptr)
-        fprintf(logfile, "%lu.%04ld Log command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+      if (not isalpha(*p1))
+        err = "command must start with a letter";
+      else if (n > MAX_CMD_LENGTH)
+        err = "command too long";
+      else if ((int)cmds.size() >= MAX_BATCH_CMDS)
+        err = "too many commands";
+      for (int i = 0; i < n and err == nullptr; i++)
+        if (p1[i] < ' ' or p1[i] > '~')
+          err = "illegal character";
+      total += n + 4;
+      if (total > MAX_BATCH_LENGTH)
+        err = "batch too long";
+      if (err == nullptr)
+        cmds.emplace_back(p1, n);
     }
-    else if (strncmp(p1, "alive", 3) == 0)
-    {
-      int n = strlen(payload);
-      if (n > MID)
-        n = MID - 1;
-      if (masterAliveCnt == 0)
-      {
-        masterAliveCnt += 1;
-        strncpy(masterAliveID, payload, n);
-        masterAliveTime.now();
-        printf("# MQTT decode:: (err=%d) new master '%s'\n",
-               masterAliveErr, masterAliveID);
-        if (logfile != nullptr)
-          fprintf(logfile, "%lu.%04ld new Master: (%d) %s\n",
-                  msgTime.getSec(), msgTime.getMicrosec()/100,
-                  masterAliveErr, masterAliveID);
+    p1 = e;
+    if (*p1 == ';')
+      p1++;
+  }
+  if (err == nullptr and cmds.empty())
+    err = "no commands";
+  if (err != nullptr)
+  { // all or nothing
+    mBatchRejected->inc();
+    printf("# UService::mqttBatch: rejected (%s): '%s'\n", err, payload);
+    if (logfile != nullptr)
+      fprintf(logfile, "%lu.%04ld Batch rejected (%s): %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, err, topic, payload);
+    return true;
+  }
+  if (not teensy[0].sendBatch(cmds))
+  {
+    printf("# UService::mqttBatch: failed to send to T0 '%s'\n", payload);
+    if (logfile != nullptr)
+      fprintf(logfile, "%lu.%04ld Failed to send batch to Teensy: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+  }
+  return true;
+}
 
-      }
-      else
-      {
-        if (strncmp(payload, masterAliveID, n) == 0)
-        {
-          masterAliveTime.now();
-          if (masterAliveErr > 0)
-            masterAliveErr--;
-          // printf("# MQTT decode:: (err=%d) same master '%s'=='%s'\n",
-          //        masterAliveErr, payload, masterAliveID);
-        }
-        else
-        {
-          if (masterAliveErr == 0)
-            masterAliveErr = 10;
-          masterAliveErr++;
-          printf("# MQTT decode:: (err=%d) master overload '%s' != '%s'\n",
-                 masterAliveErr, payload, masterAliveID);
-          if (logfile != nullptr)
-            fprintf(logfile, "%lu.%04ld Master overload: (%d) %s != %s\n",
-                    msgTime.getSec(), msgTime.getMicrosec()/100,
-                    masterAliveErr, payload, masterAliveID);
-        }
-        // inform about who is master
-        if (ini["mqtt"]["use"] == "true")
-        { // send master ID back to master and to false newcomers
-          mqtt.publish(topicMaster.c_str(), masterAliveID, msgTime);
-        }
-      }
+bool UService::mqttLog(const char * topic, const char * payload, UTime & msgTime)
+{ // start or stop logging
+  int v = strtol(payload, nullptr, 10);
+  stop_logging = v == 0;
+  if (stop_logging)
+  { // tell keyboard function to flush
+    flushLog = true;
+  }
+  else
+  {
+    printf("# Started logging\n");
+    startedLogging.now();
+  }
+  if (logfile != nullptr)
+    fprintf(logfile, "%lu.%04ld Log command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+  return true;
+}
 
+bool UService::mqttAlive(const char * payload, UTime & msgTime)
+{ // master (client) alive message
+  int n = strlen(payload);
+  if (n > MID)
+    n = MID - 1;
+  if (masterAliveCnt == 0)
+  {
+    masterAliveCnt += 1;
+    strncpy(masterAliveID, payload, n);
+    masterAliveTime.now();
+    printf("# MQTT decode:: (err=%d) new master '%s'\n",
+            masterAliveErr, masterAliveID);
+    if (logfile != nullptr)
+      fprintf(logfile, "%lu.%04ld new Master: (%d) %s\n",
+              msgTime.getSec(), msgTime.getMicrosec()/100,
+              masterAliveErr, masterAliveID);
+
+  }
+  else
+  {
+    if (strncmp(payload, masterAliveID, n) == 0)
+    {
+      masterAliveTime.now();
+      if (masterAliveErr > 0)
+        masterAliveErr--;
+      // printf("# MQTT decode:: (err=%d) same master '%s'=='%s'\n",
+      //        masterAliveErr, payload, masterAliveID);
     }
     else
-      used = false;
-    // printf("# post %lu.%04ld Interface command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
-    if (not used)
     {
-      printf("# UService::mqttDecode: got '%s' '%s', but left unused (as %s)\n", topic, payload, p1);
+      if (masterAliveErr == 0)
+        masterAliveErr = 10;
+      masterAliveErr++;
+      printf("# MQTT decode:: (err=%d) master overload '%s' != '%s'\n",
+              masterAliveErr, payload, masterAliveID);
       if (logfile != nullptr)
-        fprintf(logfile, "%lu.%04ld Unused command: %s %s\n", msgTime.getSec(), msgTime.getMicrosec()/100, topic, payload);
+        fprintf(logfile, "%lu.%04ld Master overload: (%d) %s != %s\n",
+                msgTime.getSec(), msgTime.getMicrosec()/100,
+                masterAliveErr, payload, masterAliveID);
     }
+    // inform about who is master
+    // send master ID back to master and to false newcomers
+    mqtt.publish(topicMaster, masterAliveID, msgTime);
   }
-  else
-  {
-    printf("# UService MQTT messages not handled yet (%s %s)\n", topic, payload);
-    used = false;
+  return true;
+}
+
+bool UService::mqttDecode(const char* topic, const char * payload, UTime& msgTime)
+{ // message received from MQTT channel
+  bool used;
+  UTime at;
+  flightrec.add(UFlightRec::MQTT, "mqtt", topic, payload, msgTime);
+  const char * params = UTimerQueue::getApplyTime(payload, at);
+  if (params != nullptr)
+  { // '@<time>' prefix, do at that time
+    std::string tp = topic;
+    std::string pl = params;
+    used = timerQueue.applyAt(at, topic, [this, tp, pl]()
+      {
+        UTime t("now");
+        routeCommand(tp.c_str(), pl.c_str(), t);
+      });
   }
+  else
+    used = routeCommand(topic, payload, msgTime);
   lastMqttMessage.now();
   return used;
 }
 
+bool UService::routeCommand(const char* topic, const char * payload, UTime& msgTime)
+{ // find the handler for this topic
+  bool used;
+  const std::string & fr = mqtt.fleetRoot;
+  if (mqtt.fleet and strncmp(topic, fr.c_str(), fr.size()) == 0)
+  { // command to all robots, e.g. robobot/fleet/cmd/shutdown
+    // handled as if it was to this robot only
+    std::string local = mqtt.root + &topic[fr.size()];
+    used = router.route(local.c_str(), payload, msgTime);
+  }
+  else
+    used = router.route(topic, payload, msgTime);
+  if (not used)
+    // printed and/or logged as set by diag level
+    DIAG(dg, UDiag::WARN, "# UService::mqttDecode: got '%s' '%s', but left unused\n", topic, payload);
+  return used;
+}
+
 
 bool UService::decode(const char* msg, UTime& msgTime, int tn)
 { // decode messages from Teensy
@@ -464,6 +661,7 @@ bool UService::decode(const char* msg, UTime& msgTime, int tn)
   else if (current[tn].decode(msg, msgTime)) {}
   else if (distforce[tn].decode(msg, msgTime)) {}
   else if (edge[tn].decode(msg, msgTime)) {}
+  else if (tracer.decode(msg, msgTime)) {}
   //
   // add other Teensy data users here
   //
@@ -496,6 +694,14 @@ void UService::terminate()
   stop = true; // stop all threads, when finished current activity
   // wait 100ms to allow most threads to stop
   usleep(100000);
+  // no more timed commands
+  timerQueue.terminate();
+  replay.terminate();
+  flightrec.terminate();
+  timeline.terminate();
+  looptiming.terminate();
+  // write remaining log records, before modules close their logfiles
+  logger.terminate();
   joy.terminate();
   joyLogi.terminate();
   gpio.terminate();
@@ -514,6 +720,11 @@ void UService::terminate()
     // terminate sensors before Teensy
     teensy[tn].terminate();
   }
+  snapshot.terminate();
+  sse.terminate();
+  tracer.terminate();
+  shm.terminate();
+  metrics.terminate(); // uses mqtt
   mqtt.terminate(); // outgoing to MQTT server
   mqttin.terminate(); // from MQTT server
   // service must be the last to close
@@ -536,6 +747,8 @@ void UService::terminate()
     fprintf(logfile, "%lu.%04ld All terminated; closing logfile\n", t.getSec(), t.getMicrosec()/100);
     fclose(logfile);
   }
+  // all logfiles are closed, copy the rest to the SD card
+  logstage.terminate();
 }
 
 std::string UService::getVersionString()
@@ -569,6 +782,8 @@ void UService::run()
 { // 
   UTime t("now");
   UTime t2("now");
+  ULoopTimer loopTimer;
+  loopTimer.setup("service", 0.1);
   if (not asDaemon)
   { // set keyboard to non-blocking
     printf("# Type quit to stop, or 'h' for help\r\n>>");
@@ -625,6 +840,10 @@ void UService::run()
             printf("# Logging already started\n");
         }
       }
+      else if (strncmp(p1, "routes", 6) == 0)
+      {
+        router.list();
+      }
       else if (*p1 == 'h')
       {
         printf("# Available commands:\n");
@@ -633,6 +852,7 @@ void UService::run()
         printf("#     sub xx i \tSubscribe to additional data from Teensy.\n");
         printf("#              \txx is subject (see rsewiki).\n");
         printf("#              \ti is interval in ms (i=0 stops subscription).\n");
+        printf("#     routes \tList MQTT command routes and call count.\n");
         printf("#     help \tThis help message.\n");
       }
       if (not stopNowRequest)
@@ -646,6 +866,10 @@ void UService::run()
         printf("# no line, idx=%d, took %.3f sec (flush=%d) appTime=%.3f\r\n", keyLineIdx, t2.getTimePassed(), flushLog, app_time);
       }
     }
+    // report rate limited diagnostics
+    diag.flushSuppressed();
+    // publish and log loop timing (when it is time)
+    looptiming.tick();
     if (flushLog)
     {
       flushLog = false;
@@ -671,6 +895,7 @@ void UService::run()
              masterAliveID, masterAliveTime.getTimePassed());
       masterAliveCnt = 0;
       masterAliveErr = 0;
+      flightrec.trigger("master_lost");
       // stop the robot
       printf("# UService:: should probably stop the robot, but ignored for now.\n");
       // mixer.setVelocity(0, 0);
@@ -680,8 +905,9 @@ void UService::run()
                 t.getSec(), t.getMicrosec()/100,
                 masterAliveID);
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    app_time += 0.1; // rough estimate of app time without using system time
+    loopTimer.wait();
+    // app time without using system time (fixed rate loop, skipped periods included)
+    app_time += loopTimer.period * (1 + loopTimer.missed);
     //
     if (startedLogging.getTimePassed()/60 > maxLogMinutes and not service.stop_logging)
     {
@@ -727,7 +953,7 @@ void UService::power_off_request(bool fromTeensy, const char * who)
   mixer.setVelocity(0, 0);
   if (fromTeensy)
   {
-    mqtt.publish("robobot/cmd/shutdown", who, t, 1);
+    mqtt.publish(topicShutdown, who, t);
   }
   else
   {  // tell Teensy to cut power in 40 seconds
@@ -27,6 +27,8 @@
 #include <thread>
 #include "utime.h"
 #include "uini.h"
+#include "umqtt.h"
+#include "umetrics.h"
 
 
 class UService
@@ -126,6 +128,30 @@ private:
     bool cliAction = false;
     bool flushLog = false;
     bool GetLineFromCin();
+    /**
+     * Find and call the handler for a MQTT command
+     * (topics for the fleet are handled as topics for this robot)
+     * \returns true if used */
+    bool routeCommand(const char* topic, const char * payload, UTime& msgTime);
+    /**
+     * Add MQTT command routes handled by the service */
+    void setupMqttRoutes();
+    /**
+     * Forward a command to the Teensy, e.g. topic robobot/cmd/T0/leds
+     * \param tail is the Teensy command (e.g. 'leds')
+     * \returns true (used) */
+    bool mqttToTeensy(const char * topic, const char * tail, const char * payload, UTime & msgTime);
+    /**
+     * Send more Teensy commands (separated by ';') in one write.
+     * All commands are validated first, if one fails none is send.
+     * \returns true (used) */
+    bool mqttBatch(const char * topic, const char * payload, UTime & msgTime);
+    /**
+     * Start (payload "1") or stop (payload "0") logging */
+    bool mqttLog(const char * topic, const char * payload, UTime & msgTime);
+    /**
+     * Alive message from the master (mission) app */
+    bool mqttAlive(const char * payload, UTime & msgTime);
     static const int MKL = 100;
     char keyLine[MKL];
     int keyLineIdx = 0;
@@ -137,7 +163,12 @@ private:
     UTime masterAliveTime;
     int masterAliveErr = 0;
     //
-    std::string topicMaster;
+    UMqttTopic topicMaster;
+    UMqttTopic topicShutdown;
+    /// max age of a command to the Teensy (sec), if it has a sender timestamp
+    float cmdMaxAge = 0.5;
+    UMetricCounter * mCmdExpired = nullptr;
+    UMetricCounter * mBatchRejected = nullptr;
 };
 
 extern UService service;
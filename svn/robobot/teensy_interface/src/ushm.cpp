@@ -0,0 +1,173 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ushm.h"
+#include "uservice.h"
+
+// create value
+UShm shm;
+
+const char * UShm::recordName[USHM_RECORDS] =
+    {"pose", "vel", "enc", "acc", "gyro", "edge", "edgen", "current", "dist"};
+
+
+void UShm::setup()
+{ // ensure default values
+  if (not ini.has("shm"))
+  { // no data yet, so generate some default values
+    ini["shm"]["use"] = "true";
+    ini["shm"]["name"] = USHM_NAME;
+  }
+  if (table != nullptr)
+    return;
+  name = ini["shm"]["name"];
+  if (ini["shm"]["use"] == "true")
+    table = openShared();
+  if (table == nullptr)
+  { // the table is still used internally (e.g. by the snapshot query)
+    table = new ushm_table;
+    shared = false;
+  }
+  // start from scratch - readers check magic and version
+  memset((void *)table, 0, sizeof(ushm_table));
+  table->version = USHM_VERSION;
+  table->records = USHM_RECORDS;
+  table->recordSize = sizeof(ushm_record);
+  table->pid = getpid();
+  table->alive = 1;
+  UTime t("now");
+  table->startTime = t.getSec() + t.getMicrosec() * 1e-6;
+  __atomic_store_n(&table->magic, USHM_MAGIC, __ATOMIC_RELEASE);
+  if (shared)
+    printf("# UShm::setup: state table in shared memory '%s' (%d bytes)\n", name.c_str(), (int)sizeof(ushm_table));
+}
+
+ushm_table * UShm::openShared()
+{
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+  {
+    printf("# UShm::setup: failed to open shared memory '%s'\n", name.c_str());
+    return nullptr;
+  }
+  if (ftruncate(fd, sizeof(ushm_table)) != 0)
+  {
+    printf("# UShm::setup: failed to set size of shared memory '%s'\n", name.c_str());
+    close(fd);
+    return nullptr;
+  }
+  void * p = mmap(nullptr, sizeof(ushm_table), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+  {
+    printf("# UShm::setup: failed to map shared memory '%s'\n", name.c_str());
+    return nullptr;
+  }
+  shared = true;
+  return (ushm_table *)p;
+}
+
+void UShm::terminate()
+{
+  if (table != nullptr and shared)
+  { // readers keep the mapping, but should see that data gets no newer
+    table->alive = 0;
+    munmap((void *)table, sizeof(ushm_table));
+    shm_unlink(name.c_str());
+  }
+  else if (table != nullptr)
+    delete table;
+  table = nullptr;
+}
+
+bool UShm::read(int id, ushm_record & r)
+{
+  if (table == nullptr or id < 0 or id >= USHM_RECORDS)
+    return false;
+  return ushm_read(table, id, &r);
+}
+
+int UShm::recordId(const char * name)
+{
+  for (int i = 0; i < USHM_RECORDS; i++)
+  {
+    if (strcmp(name, recordName[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+ushm_record * UShm::begin(int id, int tn, UTime & t, int n)
+{
+  if (table == nullptr or tn != 0 or id < 0 or id >= USHM_RECORDS)
+    return nullptr;
+  ushm_record * r = &table->record[id];
+  // odd count while writing
+  uint32_t s = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&r->seq, s + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  r->time = t.getSec() + t.getMicrosec() * 1e-6;
+  r->n = std::min(n, USHM_MAX_VALUES);
+  r->cnt++;
+  return r;
+}
+
+void UShm::end(ushm_record * r)
+{
+  __atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+}
+
+void UShm::update(int id, int tn, UTime & t, const float * values, int n)
+{
+  ushm_record * r = begin(id, tn, t, n);
+  if (r == nullptr)
+    return;
+  for (int i = 0; i < r->n; i++)
+    r->value[i] = values[i];
+  end(r);
+}
+
+void UShm::update(int id, int tn, UTime & t, const int64_t * values, int n)
+{
+  ushm_record * r = begin(id, tn, t, n);
+  if (r == nullptr)
+    return;
+  for (int i = 0; i < r->n; i++)
+    r->value[i] = values[i];
+  end(r);
+}
+
+void UShm::update(int id, int tn, UTime & t, const int * values, int n)
+{
+  ushm_record * r = begin(id, tn, t, n);
+  if (r == nullptr)
+    return;
+  for (int i = 0; i < r->n; i++)
+    r->value[i] = values[i];
+  end(r);
+}
@@ -0,0 +1,88 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <string>
+
+#include "utime.h"
+#include "ushmstate.h"
+
+/**
+ * Writes the newest robot state to a POSIX shared memory table,
+ * so local clients can read it without MQTT.
+ * With [shm] use=false the table is in private memory,
+ * where it is still used by the snapshot query.
+ * The layout and the reader functions are in ushmstate.h. */
+class UShm
+{
+public:
+  /** setup and create the shared memory segment */
+  void setup();
+  /**
+   * Mark the table as not alive and remove the segment name */
+  void terminate();
+  /**
+   * Get a consistent copy of a record
+   * \param id is the record, e.g. USHM_POSE
+   * \returns false if not available */
+  bool read(int id, ushm_record & r);
+  /**
+   * Find record from its name
+   * \param name is e.g. 'pose' (see recordName)
+   * \returns record ID or -1 if not found */
+  static int recordId(const char * name);
+  /// short names of records, e.g. 'pose' for USHM_POSE
+  static const char * recordName[USHM_RECORDS];
+  /**
+   * Write one record (seqlock protected)
+   * \param id is the record, e.g. USHM_POSE
+   * \param tn is the Teensy number, only Teensy 0 is in the table
+   * \param t is the data time
+   * \param values is the data
+   * \param n is the number of values */
+  void update(int id, int tn, UTime & t, const float * values, int n);
+  /**
+   * Write one record with integer values (e.g. encoder ticks) */
+  void update(int id, int tn, UTime & t, const int64_t * values, int n);
+  /**
+   * Write one record with int values (e.g. AD values) */
+  void update(int id, int tn, UTime & t, const int * values, int n);
+
+private:
+  /// get the record to write, or nullptr if not used
+  ushm_record * begin(int id, int tn, UTime & t, int n);
+  /// finish the write
+  void end(ushm_record * r);
+  /// create and map the shared memory segment
+  ushm_table * openShared();
+  ushm_table * table = nullptr;
+  /// table is in shared memory (else private)
+  bool shared = false;
+  std::string name;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UShm shm;
+
@@ -0,0 +1,159 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+/**
+ * Layout of the shared memory state table written by teensy_interface.
+ * Plain C, so it can be used by C and C++ programs
+ * (and mirrored by mqtt_python/sshm.py).
+ *
+ * Each record is protected by a sequence count (seqlock):
+ * the count is odd while the record is written,
+ * so a reader copies the record and retries if the count
+ * was odd or changed during the copy.
+ *
+ * Reader example:
+ *   ushm_table * tab = ushm_open(USHM_NAME);
+ *   ushm_record pose;
+ *   if (tab != NULL && ushm_read(tab, USHM_POSE, &pose))
+ *     printf("x=%g y=%g h=%g\n", pose.value[0], pose.value[1], pose.value[2]);
+ * */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/// default name of the shared memory segment (in /dev/shm)
+#define USHM_NAME "/robobot_state"
+/// identifies the table
+#define USHM_MAGIC 0x52425354
+/// increased when the layout changes
+#define USHM_VERSION 1
+/// max values in one record
+#define USHM_MAX_VALUES 16
+
+/// records in the table (data from Teensy 0)
+enum ushm_record_id
+{
+  USHM_POSE = 0, ///< x (m), y (m), h (rad), tilt (rad)
+  USHM_VEL,      ///< motor velocity left, right (m/s)
+  USHM_ENC,      ///< encoder ticks left, right
+  USHM_ACC,      ///< IMU acceleration x, y, z (m/s^2)
+  USHM_GYRO,     ///< IMU gyro x, y, z (deg/s)
+  USHM_EDGE,     ///< line sensor raw AD values (8)
+  USHM_EDGEN,    ///< line sensor normalized values (8)
+  USHM_CURRENT,  ///< motor currents (4), system current, supply current (A)
+  USHM_DIST,     ///< IR distance sensors 1, 2 (m)
+  USHM_RECORDS
+};
+
+/**
+ * One record, one cache line (or more) each */
+typedef struct
+{
+  /// seqlock count, odd while being written
+  uint32_t seq;
+  /// number of updates
+  uint32_t cnt;
+  /// time of data (seconds since 1 jan 1970)
+  double time;
+  /// number of valid values
+  int32_t n;
+  int32_t spare;
+  double value[USHM_MAX_VALUES];
+  char pad[64 - (24 + 8 * USHM_MAX_VALUES) % 64];
+} __attribute__((aligned(64))) ushm_record;
+
+/**
+ * The shared table */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t records;
+  uint32_t recordSize;
+  /// process ID of writer
+  int32_t pid;
+  /// 1 while the writer is running
+  int32_t alive;
+  /// time when the writer started
+  double startTime;
+  ushm_record record[USHM_RECORDS];
+} __attribute__((aligned(64))) ushm_table;
+
+/**
+ * Map the state table (read only).
+ * \param name is the segment name, e.g. USHM_NAME
+ * \returns pointer to the table or NULL if not available (or wrong version) */
+static inline ushm_table * ushm_open(const char * name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+  void * p = mmap(NULL, sizeof(ushm_table), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return NULL;
+  ushm_table * tab = (ushm_table *)p;
+  if (tab->magic != USHM_MAGIC || tab->version != USHM_VERSION ||
+      tab->recordSize != sizeof(ushm_record))
+  {
+    munmap(p, sizeof(ushm_table));
+    return NULL;
+  }
+  return tab;
+}
+
+/**
+ * Release the mapping from ushm_open() */
+static inline void ushm_close(ushm_table * tab)
+{
+  if (tab != NULL)
+    munmap((void *)tab, sizeof(ushm_table));
+}
+
+/**
+ * Get a consistent copy of one record.
+ * \param tab is the table from ushm_open()
+ * \param id is the record (e.g. USHM_POSE)
+ * \param dst is where the copy goes
+ * \returns true (1) if a consistent copy was made, 0 if the writer is too busy */
+static inline int ushm_read(const ushm_table * tab, int id, ushm_record * dst)
+{
+  const ushm_record * src = &tab->record[id];
+  for (int i = 0; i < 1000; i++)
+  {
+    uint32_t s1 = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+    if (s1 & 1)
+      continue; // being written
+    memcpy(dst, (const void *)src, sizeof(ushm_record));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint32_t s2 = __atomic_load_n(&src->seq, __ATOMIC_RELAXED);
+    if (s1 == s2)
+      return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,255 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "usnapshot.h"
+#include "ushm.h"
+#include "umqtt.h"
+#include "umqttrouter.h"
+#include "uservice.h"
+
+// create value
+USnapshot snapshot;
+
+
+void USnapshot::setup()
+{ // ensure default values
+  if (not ini.has("snapshot"))
+  { // no data yet, so generate some default values
+    ini["snapshot"]["use"] = "true";
+    ini["snapshot"]["socket"] = "/tmp/teensy_interface.sock";
+  }
+  if (ini["snapshot"]["use"] != "true")
+    return;
+  mSocketRequests = metrics.counter("snapshot_requests_total", "Snapshot queries", "via=\"socket\"");
+  mMqttRequests = metrics.counter("snapshot_requests_total", "Snapshot queries", "via=\"mqtt\"");
+  topicReply = mqtt.root + ini["mqtt"]["function"] + "snapshot/";
+  router.add(mqtt.root + "cmd/ti/snapshot", "snapshot",
+    [this](const char *, const char *, const char * payload, UTime & msgTime)
+    { return mqttQuery(payload, msgTime); });
+  for (int i = 0; i < MAX_CLIENTS; i++)
+    client[i] = -1;
+  socketName = ini["snapshot"]["socket"];
+  if (openSocket() and th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void USnapshot::terminate()
+{
+  if (th1 != nullptr)
+    th1->join();
+  th1 = nullptr;
+  for (int i = 0; i < MAX_CLIENTS; i++)
+  {
+    if (client[i] >= 0)
+      close(client[i]);
+    client[i] = -1;
+  }
+  if (listenSocket >= 0)
+  {
+    close(listenSocket);
+    unlink(socketName.c_str());
+    listenSocket = -1;
+  }
+}
+
+void USnapshot::addRecord(std::string & reply, int id)
+{
+  ushm_record r;
+  const int MSL = 100;
+  char s[MSL];
+  if (not shm.read(id, r))
+  {
+    snprintf(s, MSL, "err %s busy\n", UShm::recordName[id]);
+    reply += s;
+    return;
+  }
+  snprintf(s, MSL, "%s %.4f %u", UShm::recordName[id], r.time, r.cnt);
+  reply += s;
+  for (int i = 0; i < r.n; i++)
+  {
+    snprintf(s, MSL, " %g", r.value[i]);
+    reply += s;
+  }
+  reply += "\n";
+}
+
+std::string USnapshot::query(const char * names)
+{
+  std::string reply;
+  const char * p1 = names;
+  bool any = false;
+  while (*p1 != '\0')
+  { // get next name
+    while (isspace(*p1))
+      p1++;
+    const char * p2 = p1;
+    while (*p2 > ' ')
+      p2++;
+    if (p2 == p1)
+      break;
+    std::string name(p1, p2 - p1);
+    p1 = p2;
+    any = true;
+    if (name == "all")
+    {
+      for (int i = 0; i < USHM_RECORDS; i++)
+        addRecord(reply, i);
+    }
+    else
+    {
+      int id = UShm::recordId(name.c_str());
+      if (id >= 0)
+        addRecord(reply, id);
+      else
+        reply += "err " + name + " unknown\n";
+    }
+  }
+  if (not any)
+  { // no names is all
+    for (int i = 0; i < USHM_RECORDS; i++)
+      addRecord(reply, i);
+  }
+  reply += "end\n";
+  return reply;
+}
+
+bool USnapshot::mqttQuery(const char * payload, UTime & msgTime)
+{ // payload: <id> <names>
+  const char * p1 = payload;
+  while (isspace(*p1))
+    p1++;
+  const char * p2 = p1;
+  while (*p2 > ' ' and *p2 != '/' and *p2 != '+' and *p2 != '#')
+    p2++;
+  if (p2 == p1)
+    // an ID is needed for the reply topic
+    return false;
+  std::string topic = topicReply + std::string(p1, p2 - p1);
+  std::string reply = query(p2);
+  mqtt.publish(topic.c_str(), reply.c_str(), msgTime);
+  mMqttRequests->inc();
+  return true;
+}
+
+bool USnapshot::openSocket()
+{
+  listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenSocket < 0)
+  {
+    printf("# USnapshot:: failed to create socket\n");
+    return false;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socketName.c_str(), sizeof(addr.sun_path) - 1);
+  // remove socket left by an earlier run
+  unlink(socketName.c_str());
+  bool isOK = bind(listenSocket, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+  if (isOK)
+    isOK = listen(listenSocket, 4) == 0;
+  if (not isOK)
+  {
+    printf("# USnapshot:: failed to open socket %s (%s)\n", socketName.c_str(), strerror(errno));
+    close(listenSocket);
+    listenSocket = -1;
+  }
+  else
+    printf("# USnapshot:: serving snapshot queries on %s\n", socketName.c_str());
+  return isOK;
+}
+
+bool USnapshot::serveClient(int idx)
+{
+  const int MRL = 500;
+  char buf[MRL];
+  ssize_t n = recv(client[idx], buf, MRL, 0);
+  if (n <= 0)
+    return false;
+  clientBuf[idx].append(buf, n);
+  size_t e = clientBuf[idx].find('\n');
+  while (e != std::string::npos)
+  { // one request per line
+    std::string reply = query(clientBuf[idx].substr(0, e).c_str());
+    clientBuf[idx].erase(0, e + 1);
+    mSocketRequests->inc();
+    size_t sent = 0;
+    while (sent < reply.size())
+    {
+      ssize_t m = send(client[idx], reply.c_str() + sent, reply.size() - sent, MSG_NOSIGNAL);
+      if (m <= 0)
+        return false;
+      sent += m;
+    }
+    e = clientBuf[idx].find('\n');
+  }
+  // a request line should not be that long
+  return clientBuf[idx].size() < 1000;
+}
+
+void USnapshot::run()
+{
+  struct pollfd pfd[MAX_CLIENTS + 1];
+  while (not service.stop)
+  { // wait for a request, but no longer than 50ms
+    pfd[0] = {listenSocket, POLLIN, 0};
+    for (int i = 0; i < MAX_CLIENTS; i++)
+      pfd[i + 1] = {client[i], POLLIN, 0};
+    if (poll(pfd, MAX_CLIENTS + 1, 50) <= 0)
+      continue;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+      if (client[i] >= 0 and pfd[i + 1].revents != 0)
+      {
+        if (not serveClient(i))
+        { // client has closed (or misbehaves)
+          close(client[i]);
+          client[i] = -1;
+          clientBuf[i].clear();
+        }
+      }
+    }
+    if (pfd[0].revents & POLLIN)
+    { // new client
+      int fd = accept(listenSocket, nullptr, nullptr);
+      if (fd >= 0)
+      {
+        int i = 0;
+        while (i < MAX_CLIENTS and client[i] >= 0)
+          i++;
+        if (i < MAX_CLIENTS)
+          client[i] = fd;
+        else
+          // too many clients
+          close(fd);
+      }
+    }
+  }
+}
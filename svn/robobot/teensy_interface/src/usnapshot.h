@@ -0,0 +1,96 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include "utime.h"
+#include "umetrics.h"
+
+/**
+ * Get the latest state now (request/response), so a client
+ * need not subscribe and wait for the next periodic message.
+ *
+ * A request is a list of record names, e.g. 'pose vel' or 'all'
+ * (names as in UShm::recordName).
+ * The reply has one line for each record:
+ *   <name> <time (sec)> <update count> <values ...>
+ * or 'err <name> unknown', and the reply ends with the line 'end'.
+ *
+ * Requests are served on a Unix domain socket (one request per line)
+ * and on MQTT, topic <root>cmd/ti/snapshot with payload '<id> <names>',
+ * where the reply is published on <root>drive/snapshot/<id>. */
+class USnapshot
+{
+public:
+  /** setup and start socket server */
+  void setup();
+  /**
+   * terminate */
+  void terminate();
+  /**
+   * socket server thread */
+  void run();
+  /**
+   * Make the reply for these records
+   * \param names is space separated record names, or 'all' (or empty)
+   * \returns the reply text */
+  std::string query(const char * names);
+
+private:
+  static void runObj(USnapshot * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * Request from MQTT: '<id> <names>' */
+  bool mqttQuery(const char * payload, UTime & msgTime);
+  /**
+   * Add one record to the reply */
+  void addRecord(std::string & reply, int id);
+  /**
+   * Unix domain socket */
+  bool openSocket();
+  /**
+   * Read and answer requests from a client
+   * \returns false if the client has closed */
+  bool serveClient(int idx);
+  //
+  static const int MAX_CLIENTS = 8;
+  int client[MAX_CLIENTS];
+  std::string clientBuf[MAX_CLIENTS];
+  int listenSocket = -1;
+  std::string socketName;
+  std::string topicReply;
+  std::thread * th1 = nullptr;
+  UMetricCounter * mSocketRequests = nullptr;
+  UMetricCounter * mMqttRequests = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern USnapshot snapshot;
+
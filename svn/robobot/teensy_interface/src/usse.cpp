@@ -0,0 +1,342 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <cmath>
+
+#include "usse.h"
+#include "ushm.h"
+#include "uservice.h"
+
+// create value
+USse sse;
+
+
+void USse::setup()
+{ // ensure default values
+  if (not ini.has("sse"))
+  { // no data yet, so generate some default values
+    ini["sse"]["use"] = "true";
+    ini["sse"]["port"] = "8080";
+    ini["sse"]["bind"] = "127.0.0.1"; // loopback only, 0.0.0.0 for LAN
+    ini["sse"]["interval_ms"] = "100"; // default min time between events
+    ini["sse"]["records"] = "pose,vel,edgen,dist";
+  }
+  if (ini["sse"]["use"] != "true")
+    return;
+  port = strtol(ini["sse"]["port"].c_str(), nullptr, 10);
+  defaultInterval = strtof(ini["sse"]["interval_ms"].c_str(), nullptr) / 1000.0;
+  defaultRecords = ini["sse"]["records"];
+  mClients = metrics.gauge("sse_clients", "Connected telemetry (SSE) clients");
+  mDropped = metrics.counter("sse_dropped_total", "Telemetry events dropped for slow clients");
+  if (openSocket() and th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void USse::terminate()
+{
+  if (th1 != nullptr)
+    th1->join();
+  th1 = nullptr;
+  for (int i = 0; i < MAX_CLIENTS; i++)
+    closeClient(client[i]);
+  if (listenSocket >= 0)
+    close(listenSocket);
+  listenSocket = -1;
+}
+
+bool USse::openSocket()
+{
+  listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenSocket < 0)
+  {
+    printf("# USse:: failed to create socket\n");
+    return false;
+  }
+  int on = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, ini["sse"]["bind"].c_str(), &addr.sin_addr) != 1)
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bool isOK = bind(listenSocket, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+  if (isOK)
+    isOK = listen(listenSocket, 4) == 0;
+  if (not isOK)
+  {
+    printf("# USse:: failed to open port %d (%s)\n", port, strerror(errno));
+    close(listenSocket);
+    listenSocket = -1;
+  }
+  else
+    printf("# USse:: serving telemetry on http://%s:%d/events\n",
+           ini["sse"]["bind"].c_str(), port);
+  return isOK;
+}
+
+void USse::accept()
+{
+  int fd = ::accept(listenSocket, nullptr, nullptr);
+  if (fd < 0)
+    return;
+  int i = 0;
+  while (i < MAX_CLIENTS and client[i].fd >= 0)
+    i++;
+  if (i == MAX_CLIENTS)
+  { // too many clients
+    close(fd);
+    return;
+  }
+  // never wait for a client
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  client[i] = USseClient();
+  client[i].fd = fd;
+  mClients->set(mClients->get() + 1);
+}
+
+void USse::closeClient(USseClient & c)
+{
+  if (c.fd >= 0)
+  {
+    close(c.fd);
+    mClients->set(mClients->get() - 1);
+  }
+  c = USseClient();
+}
+
+bool USse::receive(USseClient & c)
+{
+  const int MRL = 1000;
+  char buf[MRL];
+  ssize_t n = recv(c.fd, buf, MRL, 0);
+  if (n <= 0)
+    return n < 0 and (errno == EAGAIN or errno == EWOULDBLOCK);
+  if (c.stream or not c.out.empty())
+    // ignore anything after the request
+    return true;
+  c.request.append(buf, n);
+  if (c.request.find("\r\n\r\n") != std::string::npos or
+      c.request.find("\n\n") != std::string::npos)
+    decodeRequest(c);
+  // a request header should not be that long
+  return c.request.size() < 4000;
+}
+
+std::string USse::toJson(ushm_record & r)
+{
+  const int MSL = 100;
+  char s[MSL];
+  snprintf(s, MSL, "{\"time\":%.4f,\"cnt\":%u,\"values\":[", r.time, r.cnt);
+  std::string js = s;
+  for (int i = 0; i < r.n; i++)
+  {
+    if (std::isfinite(r.value[i]))
+      snprintf(s, MSL, "%s%g", i > 0 ? "," : "", r.value[i]);
+    else
+      // JSON has no NaN or inf
+      snprintf(s, MSL, "%snull", i > 0 ? "," : "");
+    js += s;
+  }
+  js += "]}";
+  return js;
+}
+
+void USse::decodeRequest(USseClient & c)
+{ // e.g. 'GET /events?records=pose,vel&rate=5 HTTP/1.1'
+  const char * p1 = c.request.c_str();
+  bool isGet = strncmp(p1, "GET ", 4) == 0;
+  std::string path;
+  if (isGet)
+  {
+    p1 += 4;
+    const char * p2 = p1;
+    while (*p2 > ' ')
+      p2++;
+    path = std::string(p1, p2 - p1);
+  }
+  c.request.clear();
+  // query parameters
+  std::string records = defaultRecords;
+  c.interval = defaultInterval;
+  size_t q = path.find('?');
+  if (q != std::string::npos)
+  {
+    std::string query = path.substr(q + 1);
+    path.erase(q);
+    size_t a = 0;
+    while (a < query.size())
+    {
+      size_t e = query.find('&', a);
+      if (e == std::string::npos)
+        e = query.size();
+      std::string par = query.substr(a, e - a);
+      if (par.compare(0, 8, "records=") == 0)
+        records = par.substr(8);
+      else if (par.compare(0, 5, "rate=") == 0)
+      {
+        float rate = strtof(par.c_str() + 5, nullptr);
+        if (rate > 0)
+          c.interval = 1.0 / rate;
+      }
+      a = e + 1;
+    }
+  }
+  // selected records
+  size_t a = 0;
+  while (a < records.size())
+  {
+    size_t e = records.find(',', a);
+    if (e == std::string::npos)
+      e = records.size();
+    std::string name = records.substr(a, e - a);
+    if (name == "all")
+    {
+      for (int i = 0; i < USHM_RECORDS; i++)
+        c.use[i] = true;
+    }
+    else
+    {
+      int id = UShm::recordId(name.c_str());
+      if (id >= 0)
+        c.use[id] = true;
+    }
+    a = e + 1;
+  }
+  if (isGet and path == "/events")
+  {
+    c.stream = true;
+    c.out = "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/event-stream\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Connection: keep-alive\r\n\r\n";
+    // send first events now
+    c.sendTime.clear();
+  }
+  else if (isGet and path == "/snapshot")
+  {
+    std::string body = "{";
+    for (int i = 0; i < USHM_RECORDS; i++)
+    {
+      ushm_record r;
+      if (c.use[i] and shm.read(i, r))
+      {
+        if (body.size() > 1)
+          body += ",";
+        body += "\"" + std::string(UShm::recordName[i]) + "\":" + toJson(r);
+      }
+    }
+    body += "}\n";
+    c.out = "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + body;
+  }
+  else
+    c.out = "HTTP/1.1 404 Not Found\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n\r\n";
+}
+
+void USse::addEvents(USseClient & c)
+{
+  if (c.sendTime.valid and c.sendTime.getTimePassed() < c.interval)
+    return;
+  bool added = false;
+  for (int i = 0; i < USHM_RECORDS; i++)
+  {
+    ushm_record r;
+    if (c.use[i] and shm.read(i, r) and r.cnt != c.cnt[i])
+    {
+      if (c.out.size() > MAX_OUT)
+      { // client is not reading, skip
+        mDropped->inc();
+        continue;
+      }
+      c.out += "event: " + std::string(UShm::recordName[i]) + "\ndata: " + toJson(r) + "\n\n";
+      c.cnt[i] = r.cnt;
+      added = true;
+    }
+  }
+  if (added or not c.sendTime.valid)
+    c.sendTime.now();
+}
+
+bool USse::sendOut(USseClient & c)
+{
+  if (c.out.empty())
+    return true;
+  ssize_t n = send(c.fd, c.out.c_str(), c.out.size(), MSG_NOSIGNAL);
+  if (n < 0)
+    return errno == EAGAIN or errno == EWOULDBLOCK;
+  c.out.erase(0, n);
+  // snapshot and errors close after the reply
+  return c.stream or not c.out.empty();
+}
+
+void USse::run()
+{
+  struct pollfd pfd[MAX_CLIENTS + 1];
+  while (not service.stop)
+  {
+    pfd[0] = {listenSocket, POLLIN, 0};
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    { // wait for data to send too, if any
+      short ev = POLLIN;
+      if (not client[i].out.empty())
+        ev |= POLLOUT;
+      pfd[i + 1] = {client[i].fd, ev, 0};
+    }
+    // wake up every 10ms to check for new data
+    poll(pfd, MAX_CLIENTS + 1, 10);
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+      USseClient & c = client[i];
+      if (c.fd < 0)
+        continue;
+      bool isOK = true;
+      if (pfd[i + 1].revents & (POLLERR | POLLHUP))
+        isOK = false;
+      else if (pfd[i + 1].revents & POLLIN)
+        isOK = receive(c);
+      if (isOK and c.stream)
+        addEvents(c);
+      if (isOK and not c.out.empty())
+        isOK = sendOut(c);
+      if (not isOK)
+        closeClient(c);
+    }
+    if (pfd[0].revents & POLLIN)
+      accept();
+  }
+}
@@ -0,0 +1,112 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include "utime.h"
+#include "umetrics.h"
+#include "ushmstate.h"
+
+/**
+ * Telemetry for a browser: a small HTTP server with
+ *   /events   - server-sent events, one event per updated record,
+ *               e.g. /events?records=pose,vel&rate=5 (max 5 updates/sec)
+ *   /snapshot - JSON object with the newest value of the records,
+ *               e.g. /snapshot?records=pose
+ * Record names are as in UShm::recordName, a record is sent as
+ *   {"time":<sec>,"cnt":<updates>,"values":[...]}
+ * Sockets are non-blocking and each client has its own send buffer,
+ * a client that does not keep up gets events dropped, so it can
+ * not stall the other clients. */
+class USse
+{
+public:
+  /** setup and start server thread */
+  void setup();
+  /**
+   * terminate */
+  void terminate();
+  /**
+   * server thread */
+  void run();
+
+private:
+  static void runObj(USse * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  /**
+   * A connected browser (or other HTTP client) */
+  class USseClient
+  {
+  public:
+    int fd = -1;
+    /// request (until header is complete)
+    std::string request;
+    /// data waiting to be send
+    std::string out;
+    /// is an event stream (else close when sent)
+    bool stream = false;
+    /// records to send
+    bool use[USHM_RECORDS] = {false};
+    /// last send update count
+    uint32_t cnt[USHM_RECORDS] = {0};
+    /// min time between updates (sec)
+    float interval = 0.1;
+    UTime sendTime;
+  };
+  bool openSocket();
+  void accept();
+  /** read request, returns false if client is to be closed */
+  bool receive(USseClient & c);
+  /** decode request line */
+  void decodeRequest(USseClient & c);
+  /** queue new events for stream clients */
+  void addEvents(USseClient & c);
+  /** send from the out buffer, returns false if client is to be closed */
+  bool sendOut(USseClient & c);
+  void closeClient(USseClient & c);
+  /** record as JSON (NaN and inf values as null) */
+  std::string toJson(ushm_record & r);
+  //
+  static const int MAX_CLIENTS = 8;
+  /// max bytes queued for a client before events are dropped
+  static const int MAX_OUT = 32000;
+  USseClient client[MAX_CLIENTS];
+  int listenSocket = -1;
+  int port = 0;
+  float defaultInterval = 0.1;
+  std::string defaultRecords;
+  std::thread * th1 = nullptr;
+  UMetricGauge * mClients = nullptr;
+  UMetricCounter * mDropped = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern USse sse;
+
@@ -26,6 +26,8 @@
 #define UTIME_H
 
 #include <sys/time.h>
+#include <stdint.h>
+#include <atomic>
 
 
 /**
@@ -72,9 +74,39 @@ public:
   Get time past since this time in seconds */
   float getTimePassed();
   /**
-  Set time value to system time now using gettimeofday() */
+  Set time value to system time now using gettimeofday(),
+  or to the replay clock, if replaying (see setVirtualTime()) */
   inline void now()
-  { gettimeofday(&time, nullptr); valid = true; }
+  {
+    int64_t v = virtualTime.load(std::memory_order_relaxed);
+    if (v != 0)
+    { // replaying logged data
+      time.tv_sec = v / 1000000;
+      time.tv_usec = v % 1000000;
+    }
+    else
+    {
+      gettimeofday(&time, nullptr);
+      int64_t offset = clockOffset.load(std::memory_order_relaxed);
+      if (offset != 0)
+      {
+        int64_t t = time.tv_sec * 1000000LL + time.tv_usec + offset;
+        time.tv_sec = t / 1000000;
+        time.tv_usec = t % 1000000;
+      }
+    }
+    valid = true;
+  }
+  /**
+   * Set the replay clock, now() will return this time
+   * \param usec is time in microseconds since epoch, 0 is the system clock (+ offset) */
+  static inline void setVirtualTime(int64_t usec)
+  { virtualTime.store(usec, std::memory_order_relaxed); }
+  /**
+   * Make now() run with the system clock, but with an offset,
+   * \param usec is the offset in microseconds (0 is system clock) */
+  static inline void setClockOffset(int64_t usec)
+  { clockOffset.store(usec, std::memory_order_relaxed); }
   /**
   Set time from a timeval structure */
   void setTime(timeval iTime);
@@ -240,6 +272,11 @@ public:
   /**
   A valid flag, that are used when setting the time */
   bool valid;
+private:
+  /// replay clock (microseconds since epoch), 0 if not used
+  inline static std::atomic<int64_t> virtualTime{0};
+  /// offset to system clock (microseconds)
+  inline static std::atomic<int64_t> clockOffset{0};
 };
 
 
@@ -0,0 +1,209 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "utimeline.h"
+#include "uservice.h"
+#include "umqttrouter.h"
+
+// create value
+UTimeline timeline;
+
+/// buffer and name of this thread
+static thread_local UTimelineBuffer * threadBuffer = nullptr;
+static thread_local const char * threadBufferName = nullptr;
+
+void UTimeline::setup()
+{ // ensure default values
+  if (not ini.has("timeline"))
+  { // no data yet, so generate some default values
+    ini["timeline"]["enabled"] = "false";
+    // events kept for each thread (32 bytes each)
+    ini["timeline"]["events"] = "65536";
+  }
+  bufferEvents = strtoull(ini["timeline"]["events"].c_str(), nullptr, 10);
+  if (bufferEvents < 1000)
+    bufferEvents = 1000;
+  router.add(mqtt.root + "cmd/ti/timeline", "timeline",
+    [this](const char *, const char *, const char * payload, UTime &)
+    {
+      if (payload[0] == '1')
+        start();
+      else if (payload[0] == '0')
+        stop(true);
+      else if (strncmp(payload, "save", 4) == 0)
+        stop(true, true);
+      return true;
+    });
+  if (ini["timeline"]["enabled"] == "true")
+  {
+    saveAtEnd = true;
+    start();
+  }
+}
+
+void UTimeline::terminate()
+{
+  if (on)
+    stop(saveAtEnd);
+}
+
+void UTimeline::start()
+{
+  on = false;
+  {
+    std::lock_guard<std::mutex> lock(bufLock);
+    for (auto b : buffers)
+      // the thread may be adding an event, so head is not reset
+      b->first.store(b->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+  startNs = nowNs();
+  on = true;
+  printf("# UTimeline:: recording\n");
+}
+
+void UTimeline::stop(bool saveIt, bool restart)
+{
+  on = false;
+  if (saveIt)
+  { // let threads finish the current event
+    usleep(2000);
+    UTime t("now");
+    save(service.logPath + "timeline_" + t.getForFilename() + ".json");
+  }
+  if (restart)
+    start();
+}
+
+void UTimeline::threadName(const char * name)
+{
+  if (threadBufferName == name)
+    return;
+  threadBufferName = name;
+  if (threadBuffer != nullptr)
+  {
+    std::lock_guard<std::mutex> lock(bufLock);
+    threadBuffer->name = name;
+  }
+}
+
+UTimelineBuffer * UTimeline::buffer()
+{ // first event in this thread
+  UTimelineBuffer * b = new UTimelineBuffer();
+  b->tid = syscall(SYS_gettid);
+  if (threadBufferName != nullptr)
+    b->name = threadBufferName;
+  else
+    b->name = "thread " + std::to_string(b->tid);
+  b->size = bufferEvents;
+  b->ev = new UTimelineEvent[b->size];
+  std::lock_guard<std::mutex> lock(bufLock);
+  buffers.push_back(b);
+  return b;
+}
+
+UTimelineEvent * UTimeline::add(char ph, const char * name, int64_t ns)
+{
+  if (threadBuffer == nullptr)
+    threadBuffer = buffer();
+  UTimelineBuffer * b = threadBuffer;
+  UTimelineEvent * e = &b->ev[b->head.load(std::memory_order_relaxed) % b->size];
+  e->ph = ph;
+  e->name = name;
+  e->ns = ns;
+  return e;
+}
+
+void UTimeline::added()
+{
+  UTimelineBuffer * b = threadBuffer;
+  if (b != nullptr)
+    b->head.store(b->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void UTimeline::save(std::string fileName)
+{
+  FILE * f = fopen(fileName.c_str(), "w");
+  if (f == nullptr)
+  {
+    printf("# UTimeline:: failed to create %s\n", fileName.c_str());
+    return;
+  }
+  int pid = getpid();
+  int cnt = 0;
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"teensy_interface\"}}", pid);
+  std::lock_guard<std::mutex> lock(bufLock);
+  for (auto b : buffers)
+  {
+    uint64_t h = b->head.load(std::memory_order_acquire);
+    uint64_t n0 = b->first.load(std::memory_order_relaxed);
+    if (h <= n0)
+      continue;
+    fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            pid, b->tid, b->name.c_str());
+    if (h - n0 > b->size)
+      n0 = h - b->size;
+    for (uint64_t n = n0; n < h; n++)
+    {
+      UTimelineEvent & e = b->ev[n % b->size];
+      // time in us from start of recording
+      double ts = (e.ns - startNs) * 1e-3;
+      fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+              e.name, e.ph, ts, pid, b->tid);
+      switch (e.ph)
+      {
+        case 'X':
+          fprintf(f, ",\"dur\":%.3f}", e.dur * 1e-3);
+          break;
+        case 'C':
+          if (std::isfinite(e.value))
+            fprintf(f, ",\"args\":{\"value\":%g}}", e.value);
+          else
+            // JSON has no nan or inf
+            fprintf(f, ",\"args\":{\"value\":null}}");
+          break;
+        case 'i':
+          fprintf(f, ",\"s\":\"t\"}");
+          break;
+        case 'f':
+          // binds to the enclosing activity
+          fprintf(f, ",\"cat\":\"%s\",\"id\":%lu,\"bp\":\"e\"}", e.name, (unsigned long)e.id);
+          break;
+        default:
+          fprintf(f, ",\"cat\":\"%s\",\"id\":%lu}", e.name, (unsigned long)e.id);
+          break;
+      }
+      cnt++;
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  printf("# UTimeline:: saved %d events from %d threads to %s\n", cnt, (int)buffers.size(), fileName.c_str());
+}
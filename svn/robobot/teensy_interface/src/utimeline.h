@@ -0,0 +1,203 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+/**
+ * One timeline event (32 bytes) */
+class UTimelineEvent
+{
+public:
+  /// time (ns, monotonic clock)
+  int64_t ns;
+  union
+  {
+    /// duration of a complete event (ns)
+    int64_t dur;
+    /// counter value
+    double value;
+    /// flow ID
+    uint64_t id;
+  };
+  /// name (must be a static string)
+  const char * name;
+  /// Chrome trace phase: 'X' complete, 'C' counter, 'i' instant, 's', 't', 'f' flow
+  char ph;
+};
+
+/**
+ * Events from one thread */
+class UTimelineBuffer
+{
+public:
+  int tid;
+  std::string name;
+  UTimelineEvent * ev;
+  uint64_t size;
+  /// events added (the newest 'size' are kept), written by the own thread only
+  std::atomic<uint64_t> head{0};
+  /// head when recording was started (set by start())
+  std::atomic<uint64_t> first{0};
+};
+
+/**
+ * Timeline of thread activity, saved as a Chrome trace file (JSON),
+ * viewable in https://ui.perfetto.dev or chrome://tracing.
+ * Each thread records into its own buffer (no locking), the newest
+ * 'events' are kept for each thread.
+ * Recording is off by default, and then an event costs one test only.
+ * Start and stop:
+ * - ini [timeline] enabled=true records from start, saved when terminating,
+ * - MQTT 'robobot/cmd/ti/timeline' payload '1' (start), '0' (stop and save)
+ *   or 'save' (save and continue).
+ * Files are saved in the log directory as timeline_<time>.json. */
+class UTimeline
+{
+public:
+  void setup();
+  void terminate();
+  /** clear buffers and start recording */
+  void start();
+  /**
+   * Stop recording and save
+   * \param save the events to a file
+   * \param restart recording after save */
+  void stop(bool save, bool restart = false);
+  /** time now (ns, monotonic clock) */
+  static inline int64_t nowNs()
+  {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+  }
+  /**
+   * Name this thread in the timeline (call at start of thread) */
+  void threadName(const char * name);
+  /**
+   * Activity from startNs until now (see UTimelineScope)
+   * \param name is a static string */
+  inline void complete(const char * name, int64_t startNs)
+  {
+    if (on.load(std::memory_order_relaxed))
+    {
+      UTimelineEvent * e = add('X', name, startNs);
+      if (e != nullptr)
+        e->dur = nowNs() - startNs;
+      added();
+    }
+  }
+  /**
+   * Counter value (a graph in the timeline) */
+  inline void counter(const char * name, double value)
+  {
+    if (on.load(std::memory_order_relaxed))
+    {
+      UTimelineEvent * e = add('C', name, nowNs());
+      if (e != nullptr)
+        e->value = value;
+      added();
+    }
+  }
+  /**
+   * Instant event (a mark in this thread) */
+  inline void instant(const char * name)
+  {
+    if (on.load(std::memory_order_relaxed))
+    {
+      add('i', name, nowNs());
+      added();
+    }
+  }
+  /**
+   * Flow (an arrow from one activity to another, also across threads),
+   * call inside the activity (scope).
+   * \param name is the flow type, e.g. "enc"
+   * \param id is the flow ID (e.g. an update count)
+   * \param ph is 's' (start), 't' (step) or 'f' (end) */
+  inline void flow(const char * name, uint64_t id, char ph)
+  {
+    if (on.load(std::memory_order_relaxed))
+    {
+      UTimelineEvent * e = add(ph, name, nowNs());
+      if (e != nullptr)
+        e->id = id;
+      added();
+    }
+  }
+  /// recording
+  std::atomic<bool> on{false};
+
+private:
+  /** get event for this thread (not yet visible) */
+  UTimelineEvent * add(char ph, const char * name, int64_t ns);
+  /** make last event visible */
+  void added();
+  /** buffer for this thread */
+  UTimelineBuffer * buffer();
+  /** write all buffers as Chrome trace */
+  void save(std::string fileName);
+  std::vector<UTimelineBuffer *> buffers;
+  std::mutex bufLock;
+  /// events in each thread buffer
+  uint64_t bufferEvents = 65536;
+  bool saveAtEnd = false;
+  int64_t startNs = 0;
+};
+
+/**
+ * Record the time of a scope (from construction to destruction),
+ * e.g. { UTimelineScope ts("mixer"); ... } */
+class UTimelineScope
+{
+public:
+  UTimelineScope(const char * scopeName);
+  ~UTimelineScope();
+private:
+  const char * name;
+  int64_t start = 0;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UTimeline timeline;
+
+inline UTimelineScope::UTimelineScope(const char * scopeName)
+{
+  name = scopeName;
+  if (timeline.on.load(std::memory_order_relaxed))
+    start = UTimeline::nowNs();
+}
+
+inline UTimelineScope::~UTimelineScope()
+{
+  if (start != 0)
+    timeline.complete(name, start);
+}
@@ -0,0 +1,203 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+
+#include "utimerqueue.h"
+#include "uservice.h"
+
+// create value
+UTimerQueue timerQueue;
+
+void UTimerQueue::setup()
+{ // ensure default values
+  if (not ini.has("timer"))
+  { // no data yet, so generate some default values
+    ini["timer"]["; commands with '@<time>' prefix are done at that time (sec since 1970)"] = "";
+    ini["timer"]["late_tolerance_ms"] = "20";
+    ini["timer"]["; late_policy: 'apply' (do now) or 'reject'"] = "";
+    ini["timer"]["late_policy"] = "reject";
+    ini["timer"]["log"] = "true";
+  }
+  lateTolerance = strtof(ini["timer"]["late_tolerance_ms"].c_str(), nullptr) / 1000.0;
+  lateApply = ini["timer"]["late_policy"] == "apply";
+  if (ini["timer"]["log"] == "true" and logfile == nullptr)
+  { // open logfile
+    std::string fn = service.logPath + "log_timer.txt";
+    logfile = fopen(fn.c_str(), "w");
+    fprintf(logfile, "%% Timed (apply at) commands\n");
+    fprintf(logfile, "%% late tolerance %.3f sec, late policy %s\n", lateTolerance, ini["timer"]["late_policy"].c_str());
+    fprintf(logfile, "%% 1 \tTime (sec)\n");
+    fprintf(logfile, "%% 2 \tAction: queued, done, late (done), rejected\n");
+    fprintf(logfile, "%% 3 \tRequested time (sec)\n");
+    fprintf(logfile, "%% 4 \tError (sec), time passed since requested time\n");
+    fprintf(logfile, "%% 5 \tTopic\n");
+  }
+  mError = metrics.histogram("timer_apply_error_seconds", "Actual minus requested time for timed commands");
+  mLate = metrics.counter("timer_late_total", "Timed commands arriving after their time");
+  mRejected = metrics.counter("timer_rejected_total", "Timed commands rejected (late or queue full)");
+  mSize = metrics.gauge("timer_queue_size", "Timed commands waiting");
+  if (th1 == nullptr)
+    th1 = new std::thread(runObj, this);
+}
+
+void UTimerQueue::terminate()
+{
+  newItem.notify_all();
+  if (th1 != nullptr)
+    th1->join();
+  if (logfile != nullptr)
+  {
+    fclose(logfile);
+    logfile = nullptr;
+  }
+}
+
+const char * UTimerQueue::getApplyTime(const char * payload, UTime & at)
+{
+  const char * p1 = payload;
+  while (*p1 == ' ')
+    p1++;
+  if (*p1 != '@')
+    return nullptr;
+  char * p2;
+  double t = strtod(p1 + 1, &p2);
+  if (p2 == p1 + 1 or t <= 0)
+    return nullptr;
+  long sec = long(t);
+  at.setTime(sec, long((t - sec) * 1e6));
+  while (*p2 == ' ')
+    p2++;
+  return p2;
+}
+
+bool UTimerQueue::applyAt(UTime & at, const char * name, std::function<void ()> action)
+{
+  UTimerItem item;
+  item.at = at;
+  item.name = name;
+  float late = at.getTimePassed();
+  if (late <= 0)
+  { // in the future
+    if (add(at, name, action))
+    {
+      toLog("queued", item, late);
+      return true;
+    }
+    mRejected->inc();
+    toLog("full", item, late);
+    return false;
+  }
+  if (late > lateTolerance)
+  {
+    mLate->inc();
+    if (not lateApply)
+    {
+      mRejected->inc();
+      toLog("rejected", item, late);
+      return false;
+    }
+    toLog("late", item, late);
+  }
+  action();
+  mError->observe(late);
+  return true;
+}
+
+bool UTimerQueue::add(UTime& at, const char* name, std::function<void ()> action)
+{
+  std::lock_guard<std::mutex> lock(queueLock);
+  if (queue.size() >= MAX_ITEMS)
+    return false;
+  UTimerItem item;
+  item.at = at;
+  item.name = name;
+  item.action = action;
+  queue.emplace(at.getDDecSec(), item);
+  mSize->set(queue.size());
+  newItem.notify_one();
+  return true;
+}
+
+int UTimerQueue::size()
+{
+  std::lock_guard<std::mutex> lock(queueLock);
+  return queue.size();
+}
+
+void UTimerQueue::clockChanged()
+{
+  std::lock_guard<std::mutex> lock(queueLock);
+  if (queue.empty())
+    return;
+  UTime t("now");
+  if (queue.begin()->first <= t.getDDecSec())
+    newItem.notify_one();
+}
+
+void UTimerQueue::run()
+{
+  std::unique_lock<std::mutex> lock(queueLock);
+  while (not service.stop)
+  {
+    if (queue.empty())
+      newItem.wait_for(lock, std::chrono::milliseconds(50));
+    else
+    { // wait until first item is due (or a new earlier item).
+      // The time is UTime, that may have an offset to the system clock
+      // (or be the replay clock), so wait for the difference,
+      // but no more than 50ms, in case UTime runs faster (replay)
+      UTime t("now");
+      double dt = queue.begin()->first - t.getDDecSec();
+      if (dt > 0)
+        newItem.wait_for(lock, std::chrono::duration<double>(std::min(dt, 0.05)));
+    }
+    UTime t("now");
+    double now = t.getDDecSec();
+    while (not queue.empty() and queue.begin()->first <= now)
+    {
+      UTimerItem item = queue.begin()->second;
+      queue.erase(queue.begin());
+      mSize->set(queue.size());
+      // do the action without the lock
+      lock.unlock();
+      item.action();
+      float err = item.at.getTimePassed();
+      mError->observe(err);
+      toLog("done", item, err);
+      lock.lock();
+    }
+  }
+}
+
+void UTimerQueue::toLog(const char * what, UTimerItem & item, float err)
+{
+  if (logfile != nullptr and not service.stop_logging)
+  {
+    UTime t("now");
+    fprintf(logfile, "%lu.%04ld %s %lu.%06lu %.6f %s\n", t.getSec(), t.getMicrosec()/100,
+            what, item.at.getSec(), item.at.getMicrosec(), err, item.name.c_str());
+  }
+}
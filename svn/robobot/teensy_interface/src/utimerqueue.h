@@ -0,0 +1,123 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "utime.h"
+#include "umetrics.h"
+
+/**
+ * An action to be done at a specific time */
+class UTimerItem
+{
+public:
+  /// requested time
+  UTime at;
+  /// e.g. the MQTT topic (for log)
+  std::string name;
+  std::function<void ()> action;
+};
+
+/**
+ * Host side timer queue.
+ * Actions (e.g. MQTT commands with an '@<time>' prefix) are held
+ * until their time, and then done by the timer thread.
+ * This makes the time of actuation independent of the network delay. */
+class UTimerQueue
+{
+public:
+  /** setup and start timer thread */
+  void setup();
+  /**
+   * terminate */
+  void terminate();
+  /**
+   * Timer thread */
+  void run();
+  /**
+   * Add an action to be done at a specific time.
+   * \param at is the (absolute) time
+   * \param name is used in log (e.g. the topic)
+   * \param action is the function to call at that time
+   * \returns false if the queue is full */
+  bool add(UTime & at, const char * name, std::function<void ()> action);
+  /**
+   * Get the execution time from the start of a payload, e.g.
+   * '@1739885000.250 0.2 0.5'.
+   * \param payload is the message
+   * \param at is set to the requested time (if there is one)
+   * \returns pointer to the rest of the payload, or nullptr if no time */
+  static const char * getApplyTime(const char * payload, UTime & at);
+  /**
+   * Handle a message with an apply-at time.
+   * If the time is in the future, the action is queued,
+   * if the time has passed, the late-policy is used.
+   * \param at is the requested time
+   * \param name is the topic (for log)
+   * \param action is what to do
+   * \returns true if queued or done, false if rejected */
+  bool applyAt(UTime & at, const char * name, std::function<void ()> action);
+  /**
+   * Number of actions waiting */
+  int size();
+  /**
+   * The replay clock has moved (UTime::setVirtualTime()),
+   * wake the timer thread if the first action is due */
+  void clockChanged();
+
+private:
+  static void runObj(UTimerQueue * obj)
+  { // called, when thread is started
+    // transfer to the class run() function.
+    obj->run();
+  }
+  std::thread * th1 = nullptr;
+  std::mutex queueLock;
+  std::condition_variable newItem;
+  /// waiting items sorted by time
+  std::multimap<double, UTimerItem> queue;
+  static const int MAX_ITEMS = 200;
+  /// a command this late (sec) is still done without being counted as late
+  float lateTolerance = 0.02;
+  /// should late commands be done (else rejected)
+  bool lateApply = false;
+  FILE * logfile = nullptr;
+  void toLog(const char * what, UTimerItem & item, float err);
+  // metrics
+  UMetricHistogram * mError = nullptr;
+  UMetricCounter * mLate = nullptr;
+  UMetricCounter * mRejected = nullptr;
+  UMetricGauge * mSize = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UTimerQueue timerQueue;
+
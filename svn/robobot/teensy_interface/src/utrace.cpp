@@ -0,0 +1,174 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utrace.h"
+#include "uservice.h"
+#include "utimeline.h"
+
+// create value
+UTrace tracer;
+
+const char * getTraceId(const char * payload, int & id)
+{
+  const char * p1 = payload;
+  id = 0;
+  while (*p1 == ' ')
+    p1++;
+  if (strncmp(p1, "tr:", 3) == 0)
+  {
+    char * p2;
+    id = strtol(p1 + 3, &p2, 10);
+    p1 = p2;
+    if (id < 0)
+      // trace IDs are positive (index in trace table)
+      id = 0;
+  }
+  return p1;
+}
+
+void UTrace::setup()
+{ // ensure default values
+  if (not ini.has("trace"))
+  { // no data yet, so generate some default values
+    ini["trace"]["log"] = "true";
+  }
+  const char * stageName[STAGE_CNT] = {"sender", "mqtt_rx", "routed", "mixer", "motor", "teensy"};
+  for (int i = 1; i < STAGE_CNT; i++)
+  { // time from previous stage
+    std::string lb = "stage=\"" + std::string(stageName[i]) + "\"";
+    mStage[i] = metrics.histogram("trace_stage_seconds", "Traced command time from previous stage", lb.c_str());
+  }
+  mTotal = metrics.histogram("trace_total_seconds", "Traced command time from first stamp to Teensy echo");
+  traceLock.setup("trace");
+  topicTrace.setup(mqtt.root + ini["mqtt"]["function"] + "trace");
+  if (ini["trace"]["log"] == "true" and logfile == nullptr)
+  { // open logfile
+    std::string fn = service.logPath + "log_trace.txt";
+    logfile = fopen(fn.c_str(), "w");
+    fprintf(logfile, "%% Latency trace of commands with a trace ID (tr:<id>)\n");
+    fprintf(logfile, "%% 1 \tTime (sec) of Teensy echo\n");
+    fprintf(logfile, "%% 2 \tTrace ID\n");
+    fprintf(logfile, "%% 3 \tSender to MQTT received (ms) (-1 if no sender time)\n");
+    fprintf(logfile, "%% 4 \tMQTT received to routed (ms)\n");
+    fprintf(logfile, "%% 5 \tRouted to used by mixer (ms)\n");
+    fprintf(logfile, "%% 6 \tMixer to motor voltage send (ms)\n");
+    fprintf(logfile, "%% 7 \tMotor voltage send to Teensy echo received (ms)\n");
+    fprintf(logfile, "%% 8 \tTotal (ms)\n");
+    fprintf(logfile, "%% 9 \tTeensy time at echo (sec)\n");
+  }
+}
+
+void UTrace::terminate()
+{
+  if (logfile != nullptr)
+  {
+    fclose(logfile);
+    logfile = nullptr;
+  }
+}
+
+void UTrace::stamp(int id, Stage stage, UTime & t)
+{
+  if (id <= 0)
+    return;
+  std::lock_guard<UMutex> lock(traceLock);
+  UTraceItem & item = trace[id % MAX_TRACES];
+  if (item.id != id)
+  { // new trace (replaces any unfinished)
+    item = UTraceItem();
+    item.id = id;
+  }
+  item.t[stage] = t;
+  if (stage >= MQTT_RX)
+    // arrow in the timeline (from MQTT to motor)
+    timeline.flow("rc", id, stage == MQTT_RX ? 's' : 't');
+}
+
+bool UTrace::decode(const char * msg, UTime & msgTime)
+{ // echo from Teensy: 'trace <id> <teensy time>'
+  if (strncmp(msg, "trace ", 6) != 0)
+    return false;
+  const char * p1 = &msg[6];
+  int id = strtol(p1, (char**)&p1, 10);
+  float tt = strtof(p1, (char**)&p1);
+  if (id <= 0)
+    // not a valid trace ID
+    return true;
+  UTraceItem item;
+  {
+    std::lock_guard<UMutex> lock(traceLock);
+    UTraceItem & ti = trace[id % MAX_TRACES];
+    if (ti.id != id)
+      // unknown trace
+      return true;
+    ti.t[TEENSY] = msgTime;
+    timeline.flow("rc", id, 'f');
+    ti.teensyTime = tt;
+    item = ti;
+    ti.id = 0;
+  }
+  finished(item);
+  return true;
+}
+
+void UTrace::finished(UTraceItem & item)
+{
+  float dt[STAGE_CNT] = {0};
+  int first = -1;
+  for (int i = 0; i < STAGE_CNT; i++)
+  {
+    if (not item.t[i].valid)
+    {
+      dt[i] = -1;
+      continue;
+    }
+    if (first < 0)
+      first = i;
+    // time from previous valid stage
+    int j = i - 1;
+    while (j >= 0 and not item.t[j].valid)
+      j--;
+    if (j >= 0)
+    {
+      dt[i] = item.t[i] - item.t[j];
+      mStage[i]->observe(dt[i]);
+    }
+    else
+      dt[i] = -1;
+  }
+  float total = item.t[TEENSY] - item.t[first];
+  mTotal->observe(total);
+  const int MSL = 200;
+  char s[MSL];
+  snprintf(s, MSL, "%d %.3f %.3f %.3f %.3f %.3f %.3f %.4f", item.id,
+           dt[MQTT_RX] * 1000, dt[ROUTED] * 1000, dt[MIXER] * 1000,
+           dt[MOTOR] * 1000, dt[TEENSY] * 1000, total * 1000, item.teensyTime);
+  mqtt.publish(topicTrace, s, item.t[TEENSY]);
+  if (logfile != nullptr and not service.stop_logging)
+  {
+    fprintf(logfile, "%lu.%04ld %s\n", item.t[TEENSY].getSec(), item.t[TEENSY].getMicrosec()/100, s);
+  }
+}
@@ -0,0 +1,92 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+#pragma once
+
+#include <mutex>
+
+#include "utime.h"
+#include "umqtt.h"
+#include "umetrics.h"
+#include "umutex.h"
+
+/**
+ * Get an optional trace ID from the start of a command payload,
+ * written as 'tr:<id>', e.g. 'tr:17 0.2 0.5' for a rc command.
+ * \param payload is the (rest of the) command payload
+ * \param id is set to the trace ID, or 0 if none (or not positive)
+ * \returns pointer to the rest of the payload */
+const char * getTraceId(const char * payload, int & id);
+
+/**
+ * Latency tracing of (rc) commands from MQTT to motor voltage.
+ * A command with a trace ID is timestamped at each stage,
+ * and when the Teensy echoes the ID (after a 'motv' with that ID)
+ * the time between stages is added to histograms, logged and published. */
+class UTrace
+{
+public:
+  /// stages in the command path
+  enum Stage {SENDER = 0, MQTT_RX, ROUTED, MIXER, MOTOR, TEENSY, STAGE_CNT};
+  /** setup */
+  void setup();
+  /**
+   * terminate */
+  void terminate();
+  /**
+   * Timestamp a stage for this trace ID
+   * \param id is the trace ID (0 = not traced, ignored)
+   * \param stage is the stage reached
+   * \param t is the time the stage was reached */
+  void stamp(int id, Stage stage, UTime & t);
+  /**
+   * Decode the Teensy echo 'trace <id> <teensy time>'
+   * \returns true if used */
+  bool decode(const char * msg, UTime & msgTime);
+
+private:
+  /**
+   * A trace in progress */
+  class UTraceItem
+  {
+  public:
+    int id = 0;
+    UTime t[STAGE_CNT];
+    float teensyTime = 0;
+  };
+  /**
+   * Add the stage times to histograms, log and MQTT */
+  void finished(UTraceItem & item);
+  static const int MAX_TRACES = 32;
+  UTraceItem trace[MAX_TRACES];
+  UMutex traceLock;
+  UMetricHistogram * mStage[STAGE_CNT] = {nullptr};
+  UMetricHistogram * mTotal = nullptr;
+  UMqttTopic topicTrace;
+  FILE * logfile = nullptr;
+};
+
+/**
+ * Make this visible to the rest of the software */
+extern UTrace tracer;
+
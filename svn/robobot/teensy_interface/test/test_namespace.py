@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+#
+# The MIT License (MIT)  https://mit-license.org/
+#
+# Two robots (teensy_interface with robot namespace rA and rB) on one broker.
+# Both must stay connected (unique MQTT client IDs), publish in their
+# own namespace only, and use commands for their own namespace only.
+#
+# usage: test_namespace.py <teensy_interface binary>
+
+import os
+import sys
+import time
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import tiftest
+
+def main(binary):
+  tiftest.skipIfMissing()
+  test = tiftest.Test("namespace")
+  broker = tiftest.Broker(test.dir)
+  listen = tiftest.Listener(broker.port)
+  fast = {"metrics": {"interval_ms": "200"}}
+  robots = ["rA", "rB"]
+  daemon = {}
+  for r in robots:
+    daemon[r] = tiftest.Daemon(binary, os.path.join(test.dir, r), broker.port, r, fast)
+  try:
+    for r in robots:
+      test.check(listen.waitFor("robobot/" + r + "/metrics/", 10),
+                 r + " publishes metrics in its namespace")
+    # a connect with an ID in use closes the other session,
+    # so both must keep publishing
+    t0 = time.time()
+    time.sleep(3)
+    for r in robots:
+      t = [m[0] for m in listen.messages("robobot/" + r + "/metrics/", t0)]
+      gaps = [b - a for a, b in zip([t0] + t, t + [time.time()])]
+      test.check(len(t) > 0 and max(gaps) < 1.0,
+                 "%s published metrics for 3 s (%d messages, max gap %.2f s)" %
+                 (r, len(t), max(gaps)))
+    other = [m[1] for m in listen.messages() if m[1].split("/")[1] not in robots]
+    test.check(len(other) == 0, "no topics outside the namespaces %s" % other[:3])
+    # a trajectory for rA only
+    t0 = time.time()
+    listen.publish("robobot/rA/cmd/ti/traj", "id=7; v=0 t=0.2")
+    test.check(listen.waitFor("robobot/rA/drive/traj", 3, t0), "rA runs its trajectory")
+    time.sleep(0.5)
+    test.check(len(listen.messages("robobot/rB/drive/traj", t0)) == 0,
+               "rB ignores the trajectory for rA")
+  finally:
+    listen.stop()
+    for r in robots:
+      daemon[r].stop()
+      out = daemon[r].output()
+      test.check("Connection lost" not in out, r + " kept its MQTT connection")
+    broker.stop()
+  return test.finish()
+
+if __name__ == "__main__":
+  if len(sys.argv) < 2:
+    print("usage: %s <teensy_interface binary>" % sys.argv[0])
+    sys.exit(1)
+  sys.exit(main(sys.argv[1]))
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+#
+# The MIT License (MIT)  https://mit-license.org/
+#
+# Timed commands ('@<time>' prefix): the trajectory must start at the
+# requested time (error and jitter), and the timer thread must sleep
+# while a command is waiting, also when replaying a log, where the
+# clock (UTime) is the logged time (here 4 times faster than real time).
+#
+# usage: test_timer.py <teensy_interface binary>
+
+import os
+import sys
+import time
+import math
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import tiftest
+
+replayLog = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                         "..", "..", "doc", "matlab", "log_20250131_145940.242",
+                         "log_t0_teensy_io.txt")
+
+def trajStart(listen, root, id, since):
+  """ daemon time of the start of trajectory 'id', or None """
+  for m in listen.messages(root + "drive/traj", since):
+    p = m[2].split()
+    if len(p) > 2 and p[1] == str(id) and p[2] == "start":
+      return float(p[0])
+  return None
+
+def cpuLoad(daemon, sec):
+  """ CPU use (part of one core) over 'sec' seconds """
+  c0 = daemon.cpuSec()
+  time.sleep(sec)
+  return (daemon.cpuSec() - c0) / sec
+
+def daemonTime(listen, root, speed = 1):
+  """ the daemon clock, from the time stamp of the newest message """
+  m = listen.messages(root)
+  return float(m[-1][2].split()[0]) + (time.time() - m[-1][0]) * speed
+
+def testTiming(test, binary, port, listen):
+  root = "robobot/tA/"
+  fast = {"metrics": {"interval_ms": "200"}}
+  daemon = tiftest.Daemon(binary, os.path.join(test.dir, "tA"), port, "tA", fast)
+  try:
+    test.check(listen.waitFor(root + "metrics/", 10), "daemon is running")
+    t0 = time.time()
+    listen.publish(root + "cmd/ti/traj", "@%.4f id=100; v=0 t=0.05" % (t0 + 3))
+    load = cpuLoad(daemon, 2)
+    test.check(load < 0.3, "CPU load %.0f%% with a command waiting" % (load * 100))
+    # a command every 50ms
+    n = 20
+    at = time.time() + 1.0
+    for i in range(n):
+      listen.publish(root + "cmd/ti/traj", "@%.4f id=%d; v=0 t=0.02" % (at + i * 0.05, i))
+    time.sleep(n * 0.05 + 1.5)
+    err = []
+    for i in range(n):
+      t = trajStart(listen, root, i, t0)
+      if t is not None:
+        err.append(t - (at + i * 0.05))
+    test.check(len(err) == n, "all %d timed trajectories started (%d)" % (n, len(err)))
+    if len(err) > 0:
+      mean = sum(err) / len(err)
+      sd = math.sqrt(sum((e - mean)**2 for e in err) / len(err))
+      print("# start error mean %.2f ms, sd %.2f ms, min %.2f ms, max %.2f ms" %
+            (mean * 1000, sd * 1000, min(err) * 1000, max(err) * 1000))
+      test.check(min(err) >= 0 and max(err) < 0.02, "started on time (0..20 ms)")
+      test.check(sd < 0.005, "jitter below 5 ms")
+  finally:
+    daemon.stop()
+
+def testReplay(test, binary, port, listen):
+  if not os.path.exists(replayLog):
+    print("# no replay log (%s), replay part skipped" % replayLog)
+    return
+  root = "robobot/tR/"
+  fast = {"metrics": {"interval_ms": "200"}}
+  daemon = tiftest.Daemon(binary, os.path.join(test.dir, "tR"), port, "tR", fast,
+                          ["--replay", replayLog, "--replay-speed", "4"])
+  try:
+    test.check(listen.waitFor(root + "metrics/", 10), "replay is running")
+    # the clock is the logged time now, and it stops where the log has
+    # no data (until 1738332012.4 and 1738332035.7), so use the last part
+    end = time.time() + 15
+    while daemonTime(listen, root, 0) < 1738332036 and time.time() < end:
+      time.sleep(0.05)
+    t0 = time.time()
+    at = daemonTime(listen, root, 4) + 8
+    listen.publish(root + "cmd/ti/traj", "@%.4f id=200; v=0 t=0.05" % at)
+    load = cpuLoad(daemon, 1.5)
+    test.check(load < 0.3, "replay: CPU load %.0f%% with a command waiting" % (load * 100))
+    test.check(listen.waitFor(root + "drive/traj", 5, t0), "replay: timed trajectory started")
+    t = trajStart(listen, root, 200, t0)
+    if t is not None:
+      test.check(abs(t - at) < 0.03, "replay: start error %.1f ms (logged clock)" % ((t - at) * 1000))
+  finally:
+    daemon.stop()
+
+def main(binary):
+  tiftest.skipIfMissing()
+  test = tiftest.Test("timer")
+  broker = tiftest.Broker(test.dir)
+  listen = tiftest.Listener(broker.port)
+  try:
+    testTiming(test, binary, broker.port, listen)
+    testReplay(test, binary, broker.port, listen)
+  finally:
+    listen.stop()
+    broker.stop()
+  return test.finish()
+
+if __name__ == "__main__":
+  if len(sys.argv) < 2:
+    print("usage: %s <teensy_interface binary>" % sys.argv[0])
+    sys.exit(1)
+  sys.exit(main(sys.argv[1]))
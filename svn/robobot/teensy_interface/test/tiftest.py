@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+#
+# The MIT License (MIT)  https://mit-license.org/
+#
+# Helpers for the teensy_interface tests.
+# The daemons run without robot hardware (use_robot_hardware = false)
+# against a local mosquitto on a free port, each in its own directory
+# with a robot.ini made from the sample robot.ini.
+#
+# A test returns 0 if passed, 1 if failed and 77 if skipped
+# (no mosquitto or no paho-mqtt for Python).
+
+import os
+import sys
+import time
+import shutil
+import signal
+import socket
+import tempfile
+import threading
+import subprocess
+
+SKIP = 77
+
+try:
+  from paho.mqtt import client as mqtt_client
+except ImportError:
+  mqtt_client = None
+
+def skipIfMissing():
+  if mqtt_client is None:
+    print("# skipped: paho-mqtt for Python is not installed")
+    sys.exit(SKIP)
+  if shutil.which("mosquitto") is None:
+    print("# skipped: mosquitto is not installed")
+    sys.exit(SKIP)
+
+def freePort():
+  s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+  s.bind(("127.0.0.1", 0))
+  port = s.getsockname()[1]
+  s.close()
+  return port
+
+def waitForPort(port, timeout = 5.0):
+  end = time.time() + timeout
+  while time.time() < end:
+    try:
+      socket.create_connection(("127.0.0.1", port), 0.2).close()
+      return True
+    except OSError:
+      time.sleep(0.05)
+  return False
+
+class Broker:
+  """ mosquitto on a free port """
+  def __init__(self, dir):
+    self.port = freePort()
+    self.log = open(os.path.join(dir, "mosquitto.txt"), "w")
+    self.proc = subprocess.Popen(["mosquitto", "-p", str(self.port)],
+                                 stdout = self.log, stderr = subprocess.STDOUT)
+    if not waitForPort(self.port):
+      raise RuntimeError("mosquitto did not start")
+
+  def stop(self):
+    self.proc.terminate()
+    self.proc.wait(5)
+    self.log.close()
+
+def setKeys(lines, section, keys):
+  """ set keys in a section of an ini file (list of lines),
+      the section must exist, as the daemon adds no defaults to a section that exists """
+  start = lines.index("[" + section + "]")
+  end = start + 1
+  while end < len(lines) and not lines[end].startswith("["):
+    end += 1
+  for key, value in keys.items():
+    for i in range(start + 1, end):
+      if lines[i].split("=")[0].strip() == key:
+        lines[i] = key + " = " + value
+        break
+    else:
+      lines.insert(end, key + " = " + value)
+      end += 1
+
+class Daemon:
+  """ teensy_interface without robot hardware in its own directory """
+  def __init__(self, binary, dir, port, robot = "", keys = {}, args = []):
+    self.dir = dir
+    os.makedirs(dir, exist_ok = True)
+    sample = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "robot.ini")
+    lines = open(sample).read().splitlines()
+    broker = "tcp://localhost:" + str(port)
+    # nothing that is shared between daemons on the same computer
+    setKeys(lines, "service", {"use_robot_hardware": "false", "logpath": "log/"})
+    setKeys(lines, "mqtt", {"broker": broker, "robot": robot})
+    setKeys(lines, "mqttin", {"broker": broker})
+    setKeys(lines, "metrics", {"http_port": "0"})
+    setKeys(lines, "logger", {"stage": "false"})
+    setKeys(lines, "shm", {"use": "false"})
+    setKeys(lines, "snapshot", {"use": "false"})
+    setKeys(lines, "sse", {"use": "false"})
+    for section, k in keys.items():
+      setKeys(lines, section, k)
+    open(os.path.join(dir, "robot.ini"), "w").write("\n".join(lines) + "\n")
+    self.out = open(os.path.join(dir, "out.txt"), "w")
+    self.proc = subprocess.Popen([os.path.abspath(binary)] + args, cwd = dir,
+                                 stdin = subprocess.DEVNULL,
+                                 stdout = self.out, stderr = subprocess.STDOUT)
+
+  def stop(self):
+    if self.proc.poll() is None:
+      self.proc.send_signal(signal.SIGINT)
+      try:
+        self.proc.wait(10)
+      except subprocess.TimeoutExpired:
+        self.proc.kill()
+        self.proc.wait()
+    self.out.close()
+    return self.proc.returncode
+
+  def cpuSec(self):
+    """ user + system CPU time (sec) used by the daemon so far """
+    f = open("/proc/%d/stat" % self.proc.pid).read()
+    # fields after the name (in parentheses), utime and stime are field 14 and 15
+    f = f[f.rindex(")") + 2:].split()
+    return (int(f[11]) + int(f[12])) / os.sysconf("SC_CLK_TCK")
+
+  def output(self):
+    if not self.out.closed:
+      self.out.flush()
+    return open(os.path.join(self.dir, "out.txt")).read()
+
+class Listener:
+  """ MQTT client that keeps all received messages as (time, topic, payload) """
+  def __init__(self, port, topic = "robobot/#", clientId = "tiftest"):
+    self.msg = []
+    self.lock = threading.Lock()
+    if hasattr(mqtt_client, "CallbackAPIVersion"):
+      self.client = mqtt_client.Client(mqtt_client.CallbackAPIVersion.VERSION1, clientId)
+    else:
+      self.client = mqtt_client.Client(clientId)
+    self.client.on_message = self.onMessage
+    self.client.connect("localhost", port)
+    self.client.subscribe(topic)
+    self.client.loop_start()
+
+  def onMessage(self, client, userdata, m):
+    with self.lock:
+      self.msg.append((time.time(), m.topic, m.payload.decode(errors = "replace")))
+
+  def messages(self, prefix = "", since = 0):
+    with self.lock:
+      return [m for m in self.msg if m[1].startswith(prefix) and m[0] >= since]
+
+  def waitFor(self, prefix, timeout, since = 0, count = 1):
+    end = time.time() + timeout
+    while time.time() < end:
+      if len(self.messages(prefix, since)) >= count:
+        return True
+      time.sleep(0.02)
+    return False
+
+  def publish(self, topic, payload):
+    self.client.publish(topic, payload)
+
+  def stop(self):
+    self.client.loop_stop()
+    self.client.disconnect()
+
+class Test:
+  """ count checks and print the result """
+  def __init__(self, name):
+    self.name = name
+    self.failed = 0
+    self.dir = tempfile.mkdtemp(prefix = "tif_" + name + "_")
+
+  def check(self, ok, what):
+    print("# %s: %s" % ("ok  " if ok else "FAIL", what))
+    if not ok:
+      self.failed += 1
+    return ok
+
+  def finish(self):
+    if self.failed == 0:
+      shutil.rmtree(self.dir, ignore_errors = True)
+      print("# %s passed" % self.name)
+      return 0
+    print("# %s failed %d checks (files in %s)" % (self.name, self.failed, self.dir))
+    return 1
@@ -0,0 +1,198 @@
+/*  
+ * 
+ * Copyright © 2025 DTU, Christian Andersen jcan@dtu.dk
+ * 
+ * The MIT License (MIT)  https://mit-license.org/
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, 
+ * sublicense, and/or sell copies of the Software, and to permit persons to whom the Software 
+ * is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies 
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, 
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR 
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE 
+ * FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, 
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN 
+ * THE SOFTWARE. */
+
+
+// Tool for columnar logs (.ulc) from teensy_interface
+//   log_columns info <file.ulc>
+//   log_columns dump <file.ulc> [t0 t1] [columns, e.g. 0,2,3]
+//   log_columns convert <log.txt> [file.ulc]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ucolumnlog.h"
+
+void help()
+{
+  printf("Usage:\n");
+  printf("  log_columns info <file.ulc>                  Columns, chunks and time range\n");
+  printf("  log_columns dump <file.ulc> [t0 t1] [cols]   Print as text, e.g. 'dump log_t0_imu.ulc 0 0 0,2,3'\n");
+  printf("                                               (t0, t1 in sec since epoch, 0 is from start/to end)\n");
+  printf("  log_columns convert <log.txt> [file.ulc]     Convert text log to columnar log\n");
+}
+
+int info(const char * fn)
+{
+  UColumnLogReader log;
+  if (not log.open(fn))
+  {
+    printf("# %s is not a columnar log\n", fn);
+    return 1;
+  }
+  uint64_t rows = 0;
+  for (auto & ci : log.index)
+    rows += ci.rows;
+  printf("%s", log.header.c_str());
+  printf("# %s: %d columns, %lu rows in %d chunks (index %s)\n", fn, (int)log.name.size(),
+         (unsigned long)rows, (int)log.index.size(), log.hadIndex ? "in file" : "from chunks");
+  if (not log.index.empty())
+    printf("# time %.4f to %.4f (%.3f s)\n", log.index.front().tmin, log.index.back().tmax,
+           log.index.back().tmax - log.index.front().tmin);
+  for (int c = 0; c < (int)log.name.size(); c++)
+    printf("# column %d %s (%s)\n", c, log.name[c].c_str(), log.type[c] == UColumnLog::TYPE_INT ? "int" : "double");
+  return 0;
+}
+
+int dump(const char * fn, double t0, double t1, const char * cols)
+{
+  UColumnLogReader log;
+  if (not log.open(fn))
+  {
+    printf("# %s is not a columnar log\n", fn);
+    return 1;
+  }
+  std::vector<int> cl;
+  const char * p1 = cols;
+  while (p1 != nullptr and *p1 != '\0')
+  {
+    char * p2;
+    cl.push_back(strtol(p1, &p2, 10));
+    p1 = p2;
+    if (*p1 == ',')
+      p1++;
+    else
+      break;
+  }
+  std::vector<std::vector<double>> data;
+  int n = log.read(t0, t1, cl, data);
+  if (cl.empty())
+  {
+    for (int c = 0; c < (int)log.name.size(); c++)
+      cl.push_back(c);
+  }
+  for (int r = 0; r < n; r++)
+  {
+    for (int k = 0; k < (int)cl.size(); k++)
+    {
+      if (cl[k] == 0)
+        printf("%.4f", data[k][r]);
+      else if (log.type[cl[k]] == UColumnLog::TYPE_INT)
+        printf(" %.0f", data[k][r]);
+      else
+        printf(" %g", data[k][r]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
+
+int convert(const char * fn, std::string to)
+{
+  FILE * f = fopen(fn, "r");
+  if (f == nullptr)
+  {
+    printf("# failed to open %s\n", fn);
+    return 1;
+  }
+  if (to.empty())
+  {
+    to = fn;
+    size_t m = to.rfind(".txt");
+    if (m != std::string::npos)
+      to.erase(m);
+    to += ".ulc";
+  }
+  std::string header;
+  UColumnLog log;
+  const int MSL = 10000;
+  char s[MSL];
+  int cnt = 0;
+  std::vector<UColumnValue> v;
+  std::vector<uint8_t> types;
+  while (fgets(s, MSL, f) != nullptr)
+  {
+    if (s[0] == '%')
+    {
+      if (not log.isOpen())
+        header += s;
+      continue;
+    }
+    // split into time and values
+    std::vector<char *> tok;
+    char * save;
+    for (char * p1 = strtok_r(s, " \t\r\n", &save); p1 != nullptr; p1 = strtok_r(nullptr, " \t\r\n", &save))
+      tok.push_back(p1);
+    if (tok.size() < 2)
+      continue;
+    if (not log.isOpen())
+    { // value types from first line
+      for (int k = 1; k < (int)tok.size(); k++)
+        types.push_back(strpbrk(tok[k], ".eEna") != nullptr ? UColumnLog::TYPE_DOUBLE : UColumnLog::TYPE_INT);
+      auto names = UColumnLog::namesFromHeader(header, types.size());
+      if (not log.open(to, header, types, names))
+      {
+        printf("# failed to create %s\n", to.c_str());
+        fclose(f);
+        return 1;
+      }
+      v.resize(types.size());
+    }
+    for (int k = 0; k < (int)types.size(); k++)
+    {
+      const char * t = k + 1 < (int)tok.size() ? tok[k + 1] : "0";
+      if (types[k] == UColumnLog::TYPE_INT)
+        v[k].i = strtoll(t, nullptr, 10);
+      else
+        v[k].d = strtod(t, nullptr);
+    }
+    log.add(strtod(tok[0], nullptr), v.data(), v.size());
+    cnt++;
+  }
+  fclose(f);
+  log.close();
+  printf("# converted %d lines from %s to %s\n", cnt, fn, to.c_str());
+  return 0;
+}
+
+int main(int argc, char ** argv)
+{
+  if (argc < 3)
+  {
+    help();
+    return 1;
+  }
+  if (strcmp(argv[1], "info") == 0)
+    return info(argv[2]);
+  else if (strcmp(argv[1], "dump") == 0)
+  {
+    double t0 = argc > 3 ? strtod(argv[3], nullptr) : 0;
+    double t1 = argc > 4 ? strtod(argv[4], nullptr) : 0;
+    return dump(argv[2], t0, t1, argc > 5 ? argv[5] : nullptr);
+  }
+  else if (strcmp(argv[1], "convert") == 0)
+    return convert(argv[2], argc > 3 ? argv[3] : "");
+  help();
+  return 1;
+}